@@ -0,0 +1,188 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Incremental attack map check, makes and takes back random trees of moves from reference positions and compares
+// attacker counts of every square with ones counted from scratch after every push and pop.
+// usage: attack_test [trees_per_position]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../kgchess.h"
+
+#define DEFAULT_TREES 20
+#define TREE_DEPTH 6
+#define TREE_BRANCHES 3
+#define NULL_MOVE_ONE_IN 8 // chance of a null move instead of a move, where there's no check
+
+typedef struct {
+    const char *name;
+    const char *fen;
+} reference_position_t;
+
+// perft positions, they have castling, en passant and promotions close to the root
+static const reference_position_t REFERENCE_POSITIONS[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1" },
+    { "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1" },
+    { "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" },
+    { "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8" },
+    { "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" },
+};
+
+typedef struct {
+    kgchess_t *chess;
+    kgchess_t *scratch; // position of chess set up from its FEN
+    uint64_t random_state;
+    uint64_t nodes;
+    bool ok;
+} tree_walk_t;
+
+static void walk_tree(tree_walk_t *walk, int depth);
+static bool check_attacks(tree_walk_t *walk);
+static int count_attackers(const kgchess_t *chess, int x, int y, kgchess_player_t player);
+static bool is_piece_at(const kgchess_t *chess, int x, int y, kgchess_player_t player, kgchess_piece_type_t type);
+static uint64_t next_random(uint64_t *state);
+
+int main(int argc, char *argv[]) {
+    int trees = argc > 1 ? atoi(argv[1]) : DEFAULT_TREES;
+    bool all_ok = true;
+    for (size_t i = 0; i < sizeof(REFERENCE_POSITIONS) / sizeof(REFERENCE_POSITIONS[0]); i++) {
+        const reference_position_t *position = &REFERENCE_POSITIONS[i];
+        tree_walk_t walk;
+        walk.chess = kgchess_make_from_fen(position->fen);
+        walk.scratch = kgchess_make();
+        walk.random_state = 0x9e3779b97f4a7c15ull + i;
+        walk.nodes = 0;
+        walk.ok = walk.chess != NULL && walk.scratch != NULL;
+        for (int tree = 0; walk.ok && tree < trees; tree++) {
+            walk_tree(&walk, TREE_DEPTH);
+        }
+        all_ok = all_ok && walk.ok;
+        printf("%-16s %10llu nodes %s\n", position->name, (unsigned long long)walk.nodes, walk.ok ? "ok" : "FAILED");
+        kgchess_destroy(walk.chess);
+        kgchess_destroy(walk.scratch);
+    }
+    printf("%s\n", all_ok ? "all ok" : "FAILED");
+    return all_ok ? 0 : 1;
+}
+
+// Checks the position, then pushes a few random moves, walks the trees under them and checks again after every pop.
+static void walk_tree(tree_walk_t *walk, int depth) {
+    if (!check_attacks(walk) || depth == 0) {
+        return;
+    }
+    kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_all_packed_moves(walk->chess, moves, KGCHESS_MAX_MOVES);
+    for (int i = 0; walk->ok && moves_count > 0 && i < TREE_BRANCHES; i++) {
+        bool pushed = false;
+        if (!kgchess_is_in_check(walk->chess) && next_random(&walk->random_state) % NULL_MOVE_ONE_IN == 0) {
+            pushed = kgchess_push_null_move(walk->chess);
+        } else {
+            kgchess_packed_move_t move = moves[next_random(&walk->random_state) % (uint64_t)moves_count];
+            pushed = kgchess_push_packed_move(walk->chess, move);
+        }
+        if (!pushed) {
+            printf("pushing a move failed\n");
+            walk->ok = false;
+            return;
+        }
+        walk_tree(walk, depth - 1);
+        kgchess_pop_move(walk->chess);
+        check_attacks(walk);
+    }
+}
+
+// Counts kept by the board have to match counts from rays walked here and ones of the same position set up from FEN.
+static bool check_attacks(tree_walk_t *walk) {
+    walk->nodes++;
+    char fen[KGCHESS_MAX_FEN_LENGTH];
+    if (kgchess_get_fen(walk->chess, fen, KGCHESS_MAX_FEN_LENGTH) == 0 || !kgchess_set_fen(walk->scratch, fen)) {
+        printf("setting up the position from fen failed\n");
+        walk->ok = false;
+        return false;
+    }
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                int count = kgchess_get_attackers_count(walk->chess, x, y, player);
+                int expected = count_attackers(walk->chess, x, y, player);
+                int from_fen = kgchess_get_attackers_count(walk->scratch, x, y, player);
+                if (count != expected || from_fen != expected) {
+                    printf("%s: square %c%d, player %d, %d attackers (%d from fen, expected %d)\n",
+                           fen, 'a' + x, y + 1, player, count, from_fen, expected);
+                    walk->ok = false;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static int count_attackers(const kgchess_t *chess, int x, int y, kgchess_player_t player) {
+    static const int KNIGHT_STEPS[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+    static const int DIRECTIONS[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    int count = 0;
+    int pawn_dy = player == KGCHESS_PLAYER_WHITE ? -1 : 1; // pawns attacking x, y stand a rank behind it
+    count += is_piece_at(chess, x - 1, y + pawn_dy, player, KGCHESS_PIECE_PAWN);
+    count += is_piece_at(chess, x + 1, y + pawn_dy, player, KGCHESS_PIECE_PAWN);
+    for (int i = 0; i < 8; i++) {
+        count += is_piece_at(chess, x + KNIGHT_STEPS[i][0], y + KNIGHT_STEPS[i][1], player, KGCHESS_PIECE_KNIGHT);
+        count += is_piece_at(chess, x + DIRECTIONS[i][0], y + DIRECTIONS[i][1], player, KGCHESS_PIECE_KING);
+    }
+    for (int i = 0; i < 8; i++) {
+        bool is_straight = i < 4;
+        int ray_x = x + DIRECTIONS[i][0];
+        int ray_y = y + DIRECTIONS[i][1];
+        while (ray_x >= 0 && ray_x < 8 && ray_y >= 0 && ray_y < 8) {
+            kgchess_piece_t piece = kgchess_get_piece_at(chess, ray_x, ray_y);
+            if (piece.type != KGCHESS_PIECE_NONE) {
+                bool is_slider = piece.type == KGCHESS_PIECE_QUEEN
+                    || piece.type == (is_straight ? KGCHESS_PIECE_ROOK : KGCHESS_PIECE_BISHOP);
+                count += piece.player == player && is_slider;
+                break;
+            }
+            ray_x += DIRECTIONS[i][0];
+            ray_y += DIRECTIONS[i][1];
+        }
+    }
+    return count;
+}
+
+static bool is_piece_at(const kgchess_t *chess, int x, int y, kgchess_player_t player, kgchess_piece_type_t type) {
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) {
+        return false;
+    }
+    kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
+    return piece.player == player && piece.type == type;
+}
+
+// xorshift64*, fixed seeds make failures reproducible
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dull;
+}
@@ -0,0 +1,156 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Compares kgchess_batch_compute with the per-position API on positions from random games.
+// usage: batch_bench [positions]
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../kgchess.h"
+#include "../kgchess_batch.h"
+
+#define DEFAULT_POSITIONS_COUNT 4096
+#define MIN_COMPUTED_COUNT 10000000
+
+static bool is_same_as_position(const kgchess_batch_t *batch, int index, const kgchess_t *position);
+static uint64_t get_attacked_bb(const kgchess_t *position, kgchess_player_t player);
+static double get_time_ms(void);
+
+int main(int argc, char *argv[]) {
+    int positions_count = argc > 1 ? atoi(argv[1]) : DEFAULT_POSITIONS_COUNT;
+    if (positions_count <= 0) {
+        fprintf(stderr, "usage: batch_bench [positions]\n");
+        return 1;
+    }
+
+    // Boards are kept in one block, so the per-position loop isn't slowed down by scattered allocations.
+    char *boards = malloc((size_t)positions_count * kgchess_sizeof());
+    kgchess_batch_t *batch = kgchess_batch_make(positions_count);
+    if (!boards || !batch) {
+        fprintf(stderr, "Allocation failed.\n");
+        return 1;
+    }
+    kgchess_t *chess = kgchess_make();
+    unsigned int seed = 1;
+    for (int i = 0; i < positions_count; i++) {
+        if (kgchess_get_state(chess) != KGCHESS_STATE_MOVE) {
+            kgchess_destroy(chess);
+            chess = kgchess_make();
+        }
+        kgchess_t *board = kgchess_init_at(boards + (size_t)i * kgchess_sizeof());
+        kgchess_copy_to(board, chess);
+        kgchess_batch_add(batch, chess);
+        kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+        int moves_count = kgchess_get_all_packed_moves(chess, moves, KGCHESS_MAX_MOVES);
+        seed = seed * 1103515245 + 12345;
+        kgchess_move_packed(chess, moves[(seed >> 16) % moves_count]);
+    }
+    kgchess_destroy(chess);
+
+    int repeats = MIN_COMPUTED_COUNT / positions_count + 1;
+    double computed_count = (double)repeats * positions_count;
+
+    // Per-position API only counts moves and checks, without attack sets, so it does less work than the batch.
+    long long checksum = 0;
+    double start_ms = get_time_ms();
+    for (int r = 0; r < repeats; r++) {
+        for (int i = 0; i < positions_count; i++) {
+            const kgchess_t *position = (const kgchess_t*)(boards + (size_t)i * kgchess_sizeof());
+            checksum += kgchess_count_all_moves(position) + kgchess_is_in_check(position);
+        }
+    }
+    double single_ms = get_time_ms() - start_ms;
+
+    start_ms = get_time_ms();
+    for (int r = 0; r < repeats; r++) {
+        kgchess_batch_compute(batch);
+    }
+    double batch_ms = get_time_ms() - start_ms;
+
+    // checksum only keeps the per-position loop from being optimized away, results are compared position by position
+    int different_count = 0;
+    for (int i = 0; i < positions_count; i++) {
+        const kgchess_t *position = (const kgchess_t*)(boards + (size_t)i * kgchess_sizeof());
+        if (!is_same_as_position(batch, i, position)) {
+            if (different_count == 0) {
+                char fen[KGCHESS_MAX_FEN_LENGTH];
+                kgchess_get_fen(position, fen, KGCHESS_MAX_FEN_LENGTH);
+                printf("different: %s\n", fen);
+            }
+            different_count++;
+        }
+    }
+
+    printf("positions:     %d\n", positions_count);
+    printf("per position:  %.0f positions/s (%.1f ns each)\n", computed_count * 1000.0 / single_ms, single_ms * 1e6 / computed_count);
+    printf("batch (%s): %.0f positions/s (%.1f ns each), %.1fx\n", kgchess_batch_get_simd_name(),
+           computed_count * 1000.0 / batch_ms, batch_ms * 1e6 / computed_count, single_ms / batch_ms);
+    printf("checksum:      %lld\n", checksum);
+    if (different_count == 0) {
+        printf("results:       same\n");
+    } else {
+        printf("results:       DIFFERENT in %d positions\n", different_count);
+    }
+
+    kgchess_batch_destroy(batch);
+    free(boards);
+    return different_count == 0 ? 0 : 1;
+}
+
+// Squares occupied by a player's own pieces are left out of attack sets, kgchess_is_square_attacked_by_player
+// only counts pawns defending them while attacked_bbs has every defender.
+static bool is_same_as_position(const kgchess_batch_t *batch, int index, const kgchess_t *position) {
+    if (batch->moves_count[index] != kgchess_count_all_moves(position)
+        || batch->in_check[index] != kgchess_is_in_check(position)) {
+        return false;
+    }
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        uint64_t own_bb = kgchess_get_bitboard(position, player, KGCHESS_PIECE_NONE);
+        if ((batch->attacked_bbs[player][index] & ~own_bb) != (get_attacked_bb(position, player) & ~own_bb)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t get_attacked_bb(const kgchess_t *position, kgchess_player_t player) {
+    uint64_t attacked = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (kgchess_is_square_attacked_by_player(position, sq % 8, sq / 8, player)) {
+            attacked |= 1ULL << sq;
+        }
+    }
+    return attacked;
+}
+
+static double get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
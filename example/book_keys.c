@@ -0,0 +1,108 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Checks Polyglot keys against the reference values from the Polyglot book format description.
+// usage: book_keys
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../kgchess.h"
+#include "../kgchess_book.h"
+
+typedef struct {
+    const char *moves; // played from the start position
+    uint64_t key;
+} reference_key_t;
+
+static const reference_key_t REFERENCE_KEYS[] = {
+    { "", 0x463b96181691fc9cULL },
+    { "e2e4", 0x823c9b50fd114196ULL },
+    { "e2e4 d7d5", 0x0756b94461c50fb0ULL },
+    { "e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL },
+    // en passant on f6 is possible
+    { "e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL },
+    { "e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL },
+    { "e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL },
+    // en passant on c3 is possible
+    { "a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL },
+    { "a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL },
+};
+
+static bool play_moves(kgchess_t *chess, const char *moves);
+
+int main() {
+    bool all_ok = true;
+    for (size_t i = 0; i < sizeof(REFERENCE_KEYS) / sizeof(REFERENCE_KEYS[0]); i++) {
+        const reference_key_t *reference = &REFERENCE_KEYS[i];
+        kgchess_t *chess = kgchess_make();
+        if (!chess || !play_moves(chess, reference->moves)) {
+            printf("\"%s\" invalid moves\n", reference->moves);
+            all_ok = false;
+            kgchess_destroy(chess);
+            continue;
+        }
+        uint64_t key = kgchess_book_get_key(chess);
+        bool ok = key == reference->key;
+        all_ok = all_ok && ok;
+        printf("%-36s %016llx %s", reference->moves[0] ? reference->moves : "start", (unsigned long long)key,
+               ok ? "ok" : "FAILED");
+        if (!ok) {
+            printf(" (expected %016llx)", (unsigned long long)reference->key);
+        }
+        printf("\n");
+        kgchess_destroy(chess);
+    }
+    printf("%s\n", all_ok ? "all ok" : "FAILED");
+    return all_ok ? 0 : 1;
+}
+
+// Moves are in coordinate notation separated by spaces, e.g. "e2e4 e7e5 g8f6".
+static bool play_moves(kgchess_t *chess, const char *moves) {
+    const char *it = moves;
+    while (*it) {
+        if (*it == ' ') {
+            it++;
+            continue;
+        }
+        if (strlen(it) < 4) {
+            return false;
+        }
+        int from_x = it[0] - 'a', from_y = it[1] - '1', to_x = it[2] - 'a', to_y = it[3] - '1';
+        it += 4;
+        kgchess_move_t legal_moves[KGCHESS_MAX_MOVES];
+        int legal_moves_count = kgchess_get_all_moves(chess, legal_moves, KGCHESS_MAX_MOVES);
+        bool found = false;
+        for (int i = 0; i < legal_moves_count; i++) {
+            kgchess_move_t move = legal_moves[i];
+            if (move.from.x == from_x && move.from.y == from_y && move.to.x == to_x && move.to.y == to_y) {
+                kgchess_move(chess, move);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
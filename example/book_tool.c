@@ -0,0 +1,109 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Builds a Polyglot opening book from a PGN file or prints book moves for a position.
+// usage: book_tool build <pgn file> <book file> [max plies] [min games]
+//        book_tool probe <book file> [fen]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../kgchess.h"
+#include "../kgchess_pgn.h"
+#include "../kgchess_book.h"
+
+static int build(const char *pgn_path, const char *book_path, int max_plies, int min_games);
+static int probe(const char *book_path, const char *fen);
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "build") == 0) {
+        int max_plies = argc > 4 ? atoi(argv[4]) : 20;
+        int min_games = argc > 5 ? atoi(argv[5]) : 1;
+        return build(argv[2], argv[3], max_plies, min_games);
+    } else if (argc >= 3 && strcmp(argv[1], "probe") == 0) {
+        return probe(argv[2], argc > 3 ? argv[3] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    }
+    fprintf(stderr, "usage: book_tool build <pgn file> <book file> [max plies] [min games]\n");
+    fprintf(stderr, "       book_tool probe <book file> [fen]\n");
+    return 1;
+}
+
+static int build(const char *pgn_path, const char *book_path, int max_plies, int min_games) {
+    kgchess_pgn_file_t *file = kgchess_pgn_file_open(pgn_path);
+    if (!file) {
+        fprintf(stderr, "Opening %s failed.\n", pgn_path);
+        return 1;
+    }
+    kgchess_book_builder_t *builder = kgchess_book_builder_make(max_plies);
+    if (!builder) {
+        fprintf(stderr, "Allocating book builder failed.\n");
+        kgchess_pgn_file_close(file);
+        return 1;
+    }
+    int games_count = kgchess_book_builder_add_pgn(builder, kgchess_pgn_file_get_data(file), kgchess_pgn_file_get_size(file));
+    printf("games: %d, entries: %d\n", games_count, kgchess_book_builder_get_entries_count(builder));
+    bool ok = kgchess_book_builder_write(builder, book_path, min_games);
+    if (!ok) {
+        fprintf(stderr, "Writing %s failed.\n", book_path);
+    }
+    kgchess_book_builder_destroy(builder);
+    kgchess_pgn_file_close(file);
+    return ok ? 0 : 1;
+}
+
+static int probe(const char *book_path, const char *fen) {
+    kgchess_book_t *book = kgchess_book_open(book_path);
+    if (!book) {
+        fprintf(stderr, "Opening %s failed.\n", book_path);
+        return 1;
+    }
+    kgchess_t *chess = kgchess_make_from_fen(fen);
+    if (!chess) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        kgchess_book_close(book);
+        return 1;
+    }
+    printf("entries: %d\n", kgchess_book_get_entries_count(book));
+    printf("key: %016" PRIx64 "\n", kgchess_book_get_key(chess));
+
+    kgchess_book_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_book_get_moves(book, chess, moves, KGCHESS_MAX_MOVES);
+    int total_weight = 0;
+    for (int i = 0; i < moves_count; i++) {
+        total_weight += moves[i].weight;
+    }
+    for (int i = 0; i < moves_count; i++) {
+        char san[KGCHESS_MAX_SAN_LENGTH];
+        kgchess_move_to_san(chess, moves[i].move, moves[i].promotion, san, sizeof(san));
+        double share = total_weight > 0 ? 100.0 * moves[i].weight / total_weight : 0.0;
+        printf("%-8s weight %5d (%5.1f%%)\n", san, moves[i].weight, share);
+    }
+    if (moves_count == 0) {
+        printf("position not in book\n");
+    }
+
+    kgchess_destroy(chess);
+    kgchess_book_close(book);
+    return 0;
+}
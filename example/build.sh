@@ -1,9 +1,37 @@
 #!/bin/bash
 
 if [[ "$OSTYPE" == "linux-gnu"* ]]; then
-    gcc sdl_game.c ../kgchess.c -o sdl_game `sdl2-config --cflags --libs` -lSDL2_image
+    gcc sdl_game.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o sdl_game `sdl2-config --cflags --libs` -lSDL2_image -lpthread
+    gcc -O2 smp_bench.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o smp_bench -lpthread
+    gcc -O2 search_bench.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o search_bench -lpthread
+    gcc -O2 kgchess_uci.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o kgchess_uci -lpthread
+    gcc -O2 kgchess_selfplay.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o kgchess_selfplay -lpthread -lm
+    gcc -O2 tb_probe.c ../kgchess.c ../kgchess_tb.c -o tb_probe -lpthread
+    gcc -O2 tb_test.c ../kgchess.c -o tb_test -lpthread
+    gcc -O2 perft.c ../kgchess.c -o perft
+    gcc -O2 state_test.c ../kgchess.c -o state_test
+    gcc -O2 attack_test.c ../kgchess.c -o attack_test
+    gcc -O2 fen_bench.c ../kgchess.c -o fen_bench
+    gcc -O2 pgn_bench.c ../kgchess.c ../kgchess_pgn.c -o pgn_bench -lpthread
+    gcc -O2 book_tool.c ../kgchess.c ../kgchess_pgn.c ../kgchess_book.c -o book_tool
+    gcc -O2 book_keys.c ../kgchess.c ../kgchess_pgn.c ../kgchess_book.c -o book_keys
+    gcc -O2 -march=native batch_bench.c ../kgchess.c ../kgchess_batch.c -o batch_bench
 elif [[ "$OSTYPE" == "darwin"* ]]; then
-    gcc sdl_game.c ../kgchess.c -o sdl_game -F/Library/Frameworks -framework SDL2 -framework SDL2_image
+    gcc sdl_game.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o sdl_game -F/Library/Frameworks -framework SDL2 -framework SDL2_image -lpthread
+    gcc -O2 smp_bench.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o smp_bench -lpthread
+    gcc -O2 search_bench.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o search_bench -lpthread
+    gcc -O2 kgchess_uci.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o kgchess_uci -lpthread
+    gcc -O2 kgchess_selfplay.c ../kgchess.c ../kgchess_tt.c ../kgchess_ordering.c ../kgchess_tb.c ../kgchess_search.c -o kgchess_selfplay -lpthread -lm
+    gcc -O2 tb_probe.c ../kgchess.c ../kgchess_tb.c -o tb_probe -lpthread
+    gcc -O2 tb_test.c ../kgchess.c -o tb_test -lpthread
+    gcc -O2 perft.c ../kgchess.c -o perft
+    gcc -O2 state_test.c ../kgchess.c -o state_test
+    gcc -O2 attack_test.c ../kgchess.c -o attack_test
+    gcc -O2 fen_bench.c ../kgchess.c -o fen_bench
+    gcc -O2 pgn_bench.c ../kgchess.c ../kgchess_pgn.c -o pgn_bench -lpthread
+    gcc -O2 book_tool.c ../kgchess.c ../kgchess_pgn.c ../kgchess_book.c -o book_tool
+    gcc -O2 book_keys.c ../kgchess.c ../kgchess_pgn.c ../kgchess_book.c -o book_keys
+    gcc -O2 batch_bench.c ../kgchess.c ../kgchess_batch.c -o batch_bench
 else
     echo "System not supported"
     exit 1
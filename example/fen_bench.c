@@ -0,0 +1,172 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Measures how fast positions are parsed from and written to FEN.
+// usage: fen_bench [file]   file has one FEN or EPD position per line, random game positions are used without it
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../kgchess.h"
+
+#define GENERATED_POSITIONS_COUNT 100000
+#define MIN_PARSED_COUNT 10000000
+
+static char* read_file(const char *path, size_t *out_size);
+static char* generate_positions(int count, size_t *out_size);
+static double get_time_ms(void);
+
+int main(int argc, char *argv[]) {
+    size_t size = 0;
+    char *data = argc > 1 ? read_file(argv[1], &size) : generate_positions(GENERATED_POSITIONS_COUNT, &size);
+    if (!data) {
+        fprintf(stderr, "Reading positions failed.\n");
+        return 1;
+    }
+
+    // Lines are split once up front so only parsing is measured.
+    int lines_count = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') {
+            lines_count++;
+        }
+    }
+    const char **lines = malloc((lines_count + 1) * sizeof(char*));
+    lines_count = 0;
+    char *line = data;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            data[i] = '\0';
+            if (*line) {
+                lines[lines_count++] = line;
+            }
+            line = data + i + 1;
+        }
+    }
+    if (*line) {
+        lines[lines_count++] = line;
+    }
+    if (lines_count == 0) {
+        fprintf(stderr, "No positions.\n");
+        return 1;
+    }
+
+    kgchess_t *chess = kgchess_make();
+    int repeats = MIN_PARSED_COUNT / lines_count + 1;
+    int invalid_count = 0;
+    uint64_t checksum = 0;
+    double start_ms = get_time_ms();
+    for (int r = 0; r < repeats; r++) {
+        for (int i = 0; i < lines_count; i++) {
+            if (kgchess_set_fen(chess, lines[i])) {
+                checksum ^= kgchess_get_hash(chess);
+            } else if (r == 0) {
+                invalid_count++;
+            }
+        }
+    }
+    double parse_ms = get_time_ms() - start_ms;
+    double parsed_count = (double)repeats * lines_count;
+
+    char fen[KGCHESS_MAX_FEN_LENGTH];
+    size_t written_size = 0;
+    start_ms = get_time_ms();
+    for (int r = 0; r < repeats; r++) {
+        for (int i = 0; i < lines_count; i++) {
+            kgchess_set_fen(chess, lines[i]);
+            written_size += kgchess_get_fen(chess, fen, sizeof(fen));
+        }
+    }
+    double parse_and_write_ms = get_time_ms() - start_ms;
+
+    printf("positions:    %d (%d invalid)\n", lines_count, invalid_count);
+    printf("parse:        %.0f positions/s (%.1f ns each)\n", parsed_count * 1000.0 / parse_ms, parse_ms * 1e6 / parsed_count);
+    printf("parse+write:  %.0f positions/s (%.1f ns each)\n", parsed_count * 1000.0 / parse_and_write_ms,
+           parse_and_write_ms * 1e6 / parsed_count);
+    printf("checksum:     %016llx (%zu bytes written)\n", (unsigned long long)checksum, written_size);
+
+    kgchess_destroy(chess);
+    free(lines);
+    free(data);
+    return 0;
+}
+
+static char* read_file(const char *path, size_t *out_size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size + 1);
+    if (!data || fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    data[size] = '\0';
+    *out_size = size;
+    return data;
+}
+
+// Positions from random games, one FEN per line.
+static char* generate_positions(int count, size_t *out_size) {
+    char *data = malloc((size_t)count * KGCHESS_MAX_FEN_LENGTH);
+    if (!data) {
+        return NULL;
+    }
+    size_t size = 0;
+    unsigned int seed = 1;
+    kgchess_t *chess = kgchess_make();
+    for (int i = 0; i < count; i++) {
+        if (kgchess_get_state(chess) != KGCHESS_STATE_MOVE) {
+            kgchess_destroy(chess);
+            chess = kgchess_make();
+        }
+        kgchess_move_t moves[KGCHESS_MAX_MOVES];
+        int moves_count = kgchess_get_all_moves(chess, moves, KGCHESS_MAX_MOVES);
+        seed = seed * 1103515245 + 12345;
+        kgchess_move(chess, moves[(seed >> 16) % moves_count]);
+        if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+            kgchess_promote(chess, KGCHESS_PIECE_QUEEN);
+        }
+        size += kgchess_get_fen(chess, data + size, KGCHESS_MAX_FEN_LENGTH);
+        data[size++] = '\n';
+    }
+    kgchess_destroy(chess);
+    *out_size = size;
+    return data;
+}
+
+static double get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
@@ -0,0 +1,461 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Plays games between two search configurations on all cores and reports the Elo difference with an SPRT verdict.
+// Every opening is played twice with colours swapped, so neither side profits from a lucky opening.
+// usage: kgchess_selfplay [-games n] [-threads n] [-openings file.epd] [-a config] [-b config]
+//                         [-sprt elo0 elo1] [-draw ply plies cp]
+// configs are comma separated limits, e.g. "depth=6" or "nodes=20000,hash=16" (time in ms)
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime, sysconf
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../kgchess.h"
+#include "../kgchess_tt.h"
+#include "../kgchess_search.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define MAX_THREADS 256
+#define MAX_PLIES 600 // games still going on are drawn
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+
+typedef struct config {
+    int depth;
+    uint64_t nodes;
+    int time_ms;
+    int hash_mb;
+} config_t;
+
+// Games are drawn once both sides scored within cp of 0 for plies plies in a row, starting at ply.
+typedef struct draw_adjudication {
+    int ply;
+    int plies;
+    int cp;
+} draw_adjudication_t;
+
+typedef enum {
+    SPRT_CONTINUE = 0,
+    SPRT_H0, // elo0 accepted, b isn't better
+    SPRT_H1, // elo1 accepted, b is better
+} sprt_verdict_t;
+
+typedef struct tournament {
+    config_t configs[2]; // a, b
+    draw_adjudication_t draw;
+    double elo0;
+    double elo1;
+    char **openings;
+    int openings_count;
+    int games_count;
+
+    pthread_mutex_t mutex;
+    int next_game;  // taken by workers
+    int played_count;
+    int b_wins;
+    int b_losses;
+    int draws;
+    int adjudicated_count;
+    sprt_verdict_t verdict;
+} tournament_t;
+
+typedef struct worker {
+    pthread_t thread;
+    tournament_t *tournament;
+    kgchess_t *chess;
+    kgchess_tt_t *tts[2];
+    kgchess_ordering_t *orderings[2];
+} worker_t;
+
+static bool parse_config(const char *str, config_t *config);
+static bool load_openings(tournament_t *tournament, const char *path);
+static void* worker_thread(void *data);
+static int play_game(worker_t *worker, const char *fen, int b_side, bool *is_adjudicated);
+static void record_result(tournament_t *tournament, int b_score, bool is_adjudicated);
+static void get_elo(const tournament_t *tournament, double *elo, double *error);
+static double get_llr(const tournament_t *tournament);
+static void get_score_stats(const tournament_t *tournament, double *n, double *score, double *variance);
+static double score_to_elo(double score);
+static double elo_to_score(double elo);
+static void print_report(const tournament_t *tournament, double elapsed_s);
+static double get_time_s(void);
+
+int main(int argc, char *argv[]) {
+    tournament_t tournament;
+    memset(&tournament, 0, sizeof(tournament_t));
+    tournament.games_count = 1000;
+    tournament.configs[0].depth = 5;
+    tournament.configs[1].depth = 5;
+    tournament.configs[0].hash_mb = 16;
+    tournament.configs[1].hash_mb = 16;
+    tournament.draw.ply = 80;
+    tournament.draw.plies = 12;
+    tournament.draw.cp = 10;
+    tournament.elo0 = 0;
+    tournament.elo1 = 5;
+    long cores_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads_count = cores_count > 0 ? (int)cores_count : 1;
+    const char *openings_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "-games") == 0 && has_value) {
+            tournament.games_count = atoi(argv[++i]);
+        } else if (strcmp(arg, "-threads") == 0 && has_value) {
+            threads_count = atoi(argv[++i]);
+        } else if (strcmp(arg, "-openings") == 0 && has_value) {
+            openings_path = argv[++i];
+        } else if ((strcmp(arg, "-a") == 0 || strcmp(arg, "-b") == 0) && has_value) {
+            if (!parse_config(argv[++i], &tournament.configs[arg[1] == 'a' ? 0 : 1])) {
+                fprintf(stderr, "Invalid config: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "-sprt") == 0 && i + 2 < argc) {
+            tournament.elo0 = atof(argv[++i]);
+            tournament.elo1 = atof(argv[++i]);
+        } else if (strcmp(arg, "-draw") == 0 && i + 3 < argc) {
+            tournament.draw.ply = atoi(argv[++i]);
+            tournament.draw.plies = atoi(argv[++i]);
+            tournament.draw.cp = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: kgchess_selfplay [-games n] [-threads n] [-openings file.epd] [-a config] [-b config]\n"
+                            "                        [-sprt elo0 elo1] [-draw ply plies cp]\n");
+            return 1;
+        }
+    }
+    threads_count = threads_count < 1 ? 1 : (threads_count > MAX_THREADS ? MAX_THREADS : threads_count);
+    if (tournament.elo1 <= tournament.elo0) {
+        fprintf(stderr, "elo1 must be greater than elo0.\n");
+        return 1;
+    }
+    if (!load_openings(&tournament, openings_path)) {
+        return 1;
+    }
+    pthread_mutex_init(&tournament.mutex, NULL);
+
+    printf("%d games, %d openings, %d threads\n", tournament.games_count, tournament.openings_count, threads_count);
+    double start_s = get_time_s();
+    worker_t *workers = calloc((size_t)threads_count, sizeof(worker_t));
+    int started_count = 0;
+    for (int i = 0; workers && i < threads_count; i++) {
+        worker_t *worker = &workers[i];
+        worker->tournament = &tournament;
+        worker->chess = kgchess_make();
+        worker->tts[0] = kgchess_tt_make((size_t)tournament.configs[0].hash_mb);
+        worker->tts[1] = kgchess_tt_make((size_t)tournament.configs[1].hash_mb);
+        worker->orderings[0] = kgchess_ordering_make();
+        worker->orderings[1] = kgchess_ordering_make();
+        if (!worker->chess || !worker->tts[0] || !worker->tts[1] || !worker->orderings[0] || !worker->orderings[1]
+            || pthread_create(&worker->thread, NULL, worker_thread, worker) != 0) {
+            kgchess_destroy(worker->chess);
+            kgchess_tt_destroy(worker->tts[0]);
+            kgchess_tt_destroy(worker->tts[1]);
+            kgchess_ordering_destroy(worker->orderings[0]);
+            kgchess_ordering_destroy(worker->orderings[1]);
+            break;
+        }
+        started_count++;
+    }
+    if (started_count == 0) {
+        fprintf(stderr, "Starting workers failed.\n");
+        return 1;
+    }
+    for (int i = 0; i < started_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        kgchess_destroy(workers[i].chess);
+        kgchess_tt_destroy(workers[i].tts[0]);
+        kgchess_tt_destroy(workers[i].tts[1]);
+        kgchess_ordering_destroy(workers[i].orderings[0]);
+        kgchess_ordering_destroy(workers[i].orderings[1]);
+    }
+    print_report(&tournament, get_time_s() - start_s);
+
+    free(workers);
+    for (int i = 0; i < tournament.openings_count; i++) {
+        free(tournament.openings[i]);
+    }
+    free(tournament.openings);
+    pthread_mutex_destroy(&tournament.mutex);
+    return 0;
+}
+
+static bool parse_config(const char *str, config_t *config) {
+    memset(config, 0, sizeof(config_t));
+    config->hash_mb = 16;
+    const char *it = str;
+    while (*it) {
+        const char *value = strchr(it, '=');
+        if (!value) {
+            return false;
+        }
+        size_t name_length = (size_t)(value - it);
+        value++;
+        if (name_length == 5 && strncmp(it, "depth", 5) == 0) {
+            config->depth = atoi(value);
+        } else if (name_length == 5 && strncmp(it, "nodes", 5) == 0) {
+            config->nodes = strtoull(value, NULL, 10);
+        } else if (name_length == 4 && strncmp(it, "time", 4) == 0) {
+            config->time_ms = atoi(value);
+        } else if (name_length == 4 && strncmp(it, "hash", 4) == 0) {
+            config->hash_mb = atoi(value);
+        } else {
+            return false;
+        }
+        const char *next = strchr(value, ',');
+        it = next ? next + 1 : value + strlen(value);
+    }
+    return config->hash_mb > 0 && (config->depth > 0 || config->nodes > 0 || config->time_ms > 0);
+}
+
+// One FEN or EPD position per line, the starting position if there's no file.
+static bool load_openings(tournament_t *tournament, const char *path) {
+    if (!path) {
+        tournament->openings = malloc(sizeof(char*));
+        tournament->openings[0] = strdup(START_FEN);
+        tournament->openings_count = 1;
+        return true;
+    }
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Opening %s failed.\n", path);
+        return false;
+    }
+    kgchess_t *chess = kgchess_make();
+    int capacity = 0;
+    char line[1024];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (!kgchess_set_fen(chess, line)) {
+            fprintf(stderr, "Skipping invalid position at line %d.\n", line_number);
+            continue;
+        }
+        if (tournament->openings_count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            tournament->openings = realloc(tournament->openings, (size_t)capacity * sizeof(char*));
+        }
+        tournament->openings[tournament->openings_count++] = strdup(line);
+    }
+    fclose(fp);
+    kgchess_destroy(chess);
+    if (tournament->openings_count == 0) {
+        fprintf(stderr, "No positions in %s.\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Games 2n and 2n + 1 use the same opening with colours swapped.
+static void* worker_thread(void *data) {
+    worker_t *worker = data;
+    tournament_t *tournament = worker->tournament;
+    while (true) {
+        pthread_mutex_lock(&tournament->mutex);
+        int game = tournament->next_game;
+        bool is_done = game >= tournament->games_count || tournament->verdict != SPRT_CONTINUE;
+        if (!is_done) {
+            tournament->next_game++;
+        }
+        pthread_mutex_unlock(&tournament->mutex);
+        if (is_done) {
+            break;
+        }
+        const char *fen = tournament->openings[(game / 2) % tournament->openings_count];
+        int b_side = game % 2;
+        bool is_adjudicated = false;
+        int b_score = play_game(worker, fen, b_side, &is_adjudicated);
+        record_result(tournament, b_score, is_adjudicated);
+    }
+    return NULL;
+}
+
+// Returns b's score: 1 for a win, 0 for a draw and -1 for a loss. b_side is 0 if b plays white.
+static int play_game(worker_t *worker, const char *fen, int b_side, bool *is_adjudicated) {
+    tournament_t *tournament = worker->tournament;
+    kgchess_t *chess = worker->chess;
+    kgchess_set_fen(chess, fen);
+    kgchess_tt_clear(worker->tts[0]);
+    kgchess_tt_clear(worker->tts[1]);
+    kgchess_ordering_clear(worker->orderings[0]);
+    kgchess_ordering_clear(worker->orderings[1]);
+    kgchess_player_t b_player = b_side == 0 ? KGCHESS_PLAYER_WHITE : KGCHESS_PLAYER_BLACK;
+    int drawish_plies = 0;
+
+    for (int ply = 0; kgchess_get_state(chess) != KGCHESS_STATE_ENDED; ply++) {
+        if (ply >= MAX_PLIES) {
+            *is_adjudicated = true;
+            return 0;
+        }
+        int engine = kgchess_get_current_player(chess) == b_player ? 1 : 0;
+        const config_t *config = &tournament->configs[engine];
+        kgchess_search_limits_t limits = kgchess_search_limits_make_empty();
+        limits.depth = config->depth;
+        limits.nodes = config->nodes;
+        limits.time_ms = config->time_ms;
+        limits.tt = worker->tts[engine];
+        limits.orderings = &worker->orderings[engine];
+        kgchess_search_result_t result;
+        if (!kgchess_search(chess, limits, &result) || result.pv_length == 0) {
+            break;
+        }
+        kgchess_move(chess, result.best_move);
+        if (result.best_move_promotion != KGCHESS_PIECE_NONE) {
+            kgchess_promote(chess, result.best_move_promotion);
+        }
+
+        drawish_plies = abs(result.score) <= tournament->draw.cp ? drawish_plies + 1 : 0;
+        if (tournament->draw.plies > 0 && ply >= tournament->draw.ply && drawish_plies >= tournament->draw.plies) {
+            *is_adjudicated = true;
+            return 0;
+        }
+    }
+
+    kgchess_player_t winner = kgchess_get_winner(chess);
+    if (winner == KGCHESS_PLAYER_NONE) {
+        return 0;
+    }
+    return winner == b_player ? 1 : -1;
+}
+
+static void record_result(tournament_t *tournament, int b_score, bool is_adjudicated) {
+    pthread_mutex_lock(&tournament->mutex);
+    tournament->played_count++;
+    if (b_score > 0) {
+        tournament->b_wins++;
+    } else if (b_score < 0) {
+        tournament->b_losses++;
+    } else {
+        tournament->draws++;
+    }
+    if (is_adjudicated) {
+        tournament->adjudicated_count++;
+    }
+    if (tournament->verdict == SPRT_CONTINUE) {
+        double llr = get_llr(tournament);
+        if (llr >= log((1 - SPRT_BETA) / SPRT_ALPHA)) {
+            tournament->verdict = SPRT_H1;
+        } else if (llr <= log(SPRT_BETA / (1 - SPRT_ALPHA))) {
+            tournament->verdict = SPRT_H0;
+        }
+    }
+    if (tournament->played_count % 100 == 0) {
+        double elo = 0, error = 0;
+        get_elo(tournament, &elo, &error);
+        printf("%6d games  +%d -%d =%d  elo %+.1f +- %.1f  llr %.2f\n", tournament->played_count,
+               tournament->b_wins, tournament->b_losses, tournament->draws, elo, error, get_llr(tournament));
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&tournament->mutex);
+}
+
+// Elo of b relative to a with the half width of its 95% confidence interval.
+static void get_elo(const tournament_t *tournament, double *elo, double *error) {
+    double n = 0, score = 0, variance = 0;
+    get_score_stats(tournament, &n, &score, &variance);
+    if (n == 0) {
+        *elo = 0;
+        *error = 0;
+        return;
+    }
+    double deviation = sqrt(variance / n);
+    *elo = score_to_elo(score);
+    *error = (score_to_elo(score + 1.96 * deviation) - score_to_elo(score - 1.96 * deviation)) / 2;
+}
+
+// Log-likelihood ratio of elo1 against elo0, with game scores approximated by a normal distribution.
+static double get_llr(const tournament_t *tournament) {
+    double n = 0, score = 0, variance = 0;
+    get_score_stats(tournament, &n, &score, &variance);
+    if (n == 0 || variance <= 0) {
+        return 0;
+    }
+    double score0 = elo_to_score(tournament->elo0);
+    double score1 = elo_to_score(tournament->elo1);
+    return (score1 - score0) * (2 * score - score0 - score1) * n / (2 * variance);
+}
+
+// Mean and variance of b's game scores (1, 0.5 or 0). Half a game is added to results that didn't happen yet,
+// otherwise one-sided results would have no variance at all.
+static void get_score_stats(const tournament_t *tournament, double *n, double *score, double *variance) {
+    double wins = tournament->b_wins;
+    double draws = tournament->draws;
+    double losses = tournament->b_losses;
+    *n = wins + draws + losses;
+    *score = 0;
+    *variance = 0;
+    if (*n == 0) {
+        return;
+    }
+    if (wins == 0 || draws == 0 || losses == 0) {
+        wins += 0.5;
+        draws += 0.5;
+        losses += 0.5;
+    }
+    double total = wins + draws + losses;
+    double w = wins / total;
+    double d = draws / total;
+    double l = losses / total;
+    double s = w + d / 2;
+    *score = s;
+    *variance = w * (1 - s) * (1 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+}
+
+static double score_to_elo(double score) {
+    score = score < 1e-6 ? 1e-6 : (score > 1 - 1e-6 ? 1 - 1e-6 : score);
+    return -400 * log10(1 / score - 1);
+}
+
+static double elo_to_score(double elo) {
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+static void print_report(const tournament_t *tournament, double elapsed_s) {
+    double elo = 0, error = 0;
+    get_elo(tournament, &elo, &error);
+    double llr = get_llr(tournament);
+    static const char *VERDICTS[] = { "continue", "H0 accepted", "H1 accepted" };
+    printf("games: %d (%d adjudicated) in %.1f s\n", tournament->played_count, tournament->adjudicated_count, elapsed_s);
+    printf("b against a: +%d -%d =%d\n", tournament->b_wins, tournament->b_losses, tournament->draws);
+    printf("elo: %+.1f +- %.1f (95%%)\n", elo, error);
+    printf("sprt [%.1f, %.1f]: llr %.2f (%.2f, %.2f) %s\n", tournament->elo0, tournament->elo1, llr,
+           log(SPRT_BETA / (1 - SPRT_ALPHA)), log((1 - SPRT_BETA) / SPRT_ALPHA), VERDICTS[tournament->verdict]);
+}
+
+static double get_time_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,590 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// UCI engine reading commands from stdin and answering on stdout, for use with chess GUIs and match runners.
+// Searches run on a background thread, so stop, ponderhit and isready are handled while they run.
+// usage: kgchess_uci
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime, getline, strtok_r
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../kgchess.h"
+#include "../kgchess_tt.h"
+#include "../kgchess_tb.h"
+#include "../kgchess_search.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define DEFAULT_HASH_MB 64
+#define MAX_HASH_MB 65536
+#define MAX_THREADS 256
+#define DEFAULT_MOVE_OVERHEAD_MS 30
+#define DEFAULT_MOVES_TO_GO 30 // assumed for sudden death time controls
+#define MAX_MOVES_TO_GO 50
+
+typedef struct engine {
+    kgchess_t *chess;        // position set with the position command
+    kgchess_t *search_chess; // copy being searched
+    kgchess_tt_t *tt;
+    kgchess_tb_t *tb;
+    kgchess_ordering_t *orderings[MAX_THREADS]; // move ordering tables of every thread, kept between searches
+    int threads;
+    int move_overhead_ms;
+
+    pthread_t search_thread;
+    pthread_t timer_thread;
+    bool is_searching; // only used by the main thread
+
+    // Shared with the search and timer threads, guarded by mutex.
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    _Atomic bool stop;     // read by the search without taking the mutex
+    bool is_pondering;     // ponder or infinite, bestmove waits for stop or ponderhit
+    bool is_search_done;
+    uint64_t start_time_ms; // of the search, or of ponderhit
+    int optimum_time_ms;    // 0 for no time limit
+    int maximum_time_ms;
+    kgchess_search_limits_t limits;
+} engine_t;
+
+typedef struct go_params {
+    int time_ms[2]; // white, black
+    int inc_ms[2];
+    int moves_to_go;
+    int move_time_ms;
+    int depth;
+    uint64_t nodes;
+    bool is_infinite;
+    bool is_ponder;
+} go_params_t;
+
+static pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void send_line(const char *format, ...);
+static void engine_init(engine_t *engine);
+static void engine_deinit(engine_t *engine);
+static void engine_stop_search(engine_t *engine);
+static void engine_set_threads(engine_t *engine, int threads);
+static void engine_clear(engine_t *engine);
+static void handle_uci(void);
+static void handle_setoption(engine_t *engine, char *args);
+static void handle_position(engine_t *engine, char *args);
+static void handle_go(engine_t *engine, char *args);
+static void handle_ponderhit(engine_t *engine);
+static bool play_uci_move(kgchess_t *chess, const char *str);
+static void allocate_time(const engine_t *engine, const go_params_t *params, kgchess_player_t player,
+                          int *optimum_ms, int *maximum_ms);
+static void* search_thread(void *data);
+static void* timer_thread(void *data);
+static void on_iteration(const kgchess_search_result_t *result, void *data);
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out);
+static uint64_t get_time_ms(void);
+
+int main(void) {
+    engine_t engine;
+    engine_init(&engine);
+    if (!engine.chess || !engine.tt || !engine.orderings[0]) {
+        fprintf(stderr, "Allocating engine failed.\n");
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    while (getline(&line, &line_capacity, stdin) >= 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *args = line + strspn(line, " \t");
+        size_t command_length = strcspn(args, " \t");
+        char *command = args;
+        args += command_length;
+        if (*args) {
+            *args++ = '\0';
+        }
+
+        if (strcmp(command, "uci") == 0) {
+            handle_uci();
+        } else if (strcmp(command, "isready") == 0) {
+            send_line("readyok");
+        } else if (strcmp(command, "setoption") == 0) {
+            engine_stop_search(&engine);
+            handle_setoption(&engine, args);
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            engine_stop_search(&engine);
+            engine_clear(&engine);
+        } else if (strcmp(command, "position") == 0) {
+            engine_stop_search(&engine);
+            handle_position(&engine, args);
+        } else if (strcmp(command, "go") == 0) {
+            engine_stop_search(&engine);
+            handle_go(&engine, args);
+        } else if (strcmp(command, "stop") == 0) {
+            engine_stop_search(&engine);
+        } else if (strcmp(command, "ponderhit") == 0) {
+            handle_ponderhit(&engine);
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        } else if (*command) {
+            send_line("info string unknown command %s", command);
+        }
+    }
+
+    engine_stop_search(&engine);
+    free(line);
+    engine_deinit(&engine);
+    return 0;
+}
+
+static void send_line(const char *format, ...) {
+    pthread_mutex_lock(&output_mutex);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+    pthread_mutex_unlock(&output_mutex);
+}
+
+static void engine_init(engine_t *engine) {
+    memset(engine, 0, sizeof(engine_t));
+    engine->chess = kgchess_make_from_fen(START_FEN);
+    engine->search_chess = kgchess_make();
+    engine->tt = kgchess_tt_make(DEFAULT_HASH_MB);
+    engine->orderings[0] = kgchess_ordering_make();
+    engine->threads = 1;
+    engine->move_overhead_ms = DEFAULT_MOVE_OVERHEAD_MS;
+    pthread_mutex_init(&engine->mutex, NULL);
+    pthread_cond_init(&engine->cond, NULL);
+}
+
+static void engine_deinit(engine_t *engine) {
+    kgchess_destroy(engine->chess);
+    kgchess_destroy(engine->search_chess);
+    kgchess_tt_destroy(engine->tt);
+    kgchess_tb_destroy(engine->tb);
+    for (int i = 0; i < MAX_THREADS; i++) {
+        kgchess_ordering_destroy(engine->orderings[i]);
+    }
+    pthread_mutex_destroy(&engine->mutex);
+    pthread_cond_destroy(&engine->cond);
+}
+
+// Makes a running search send its bestmove and waits for it.
+static void engine_stop_search(engine_t *engine) {
+    if (!engine->is_searching) {
+        return;
+    }
+    pthread_mutex_lock(&engine->mutex);
+    engine->stop = true;
+    engine->is_pondering = false;
+    pthread_cond_broadcast(&engine->cond);
+    pthread_mutex_unlock(&engine->mutex);
+    pthread_join(engine->search_thread, NULL);
+    engine->is_searching = false;
+}
+
+// Every thread needs its own ordering, if some can't be allocated fewer threads are used.
+static void engine_set_threads(engine_t *engine, int threads) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (i < threads && !engine->orderings[i]) {
+            engine->orderings[i] = kgchess_ordering_make();
+            if (!engine->orderings[i]) {
+                send_line("info string allocating tables for %d threads failed", threads);
+                threads = i;
+            }
+        } else if (i >= threads && engine->orderings[i]) {
+            kgchess_ordering_destroy(engine->orderings[i]);
+            engine->orderings[i] = NULL;
+        }
+    }
+    engine->threads = threads;
+}
+
+// Forgets what was learned in the previous game.
+static void engine_clear(engine_t *engine) {
+    kgchess_tt_clear(engine->tt);
+    for (int i = 0; i < engine->threads; i++) {
+        kgchess_ordering_clear(engine->orderings[i]);
+    }
+}
+
+static void handle_uci(void) {
+    send_line("id name kgchess " KGCHESS_VERSION_STRING);
+    send_line("id author Krzysztof Gabis");
+    send_line("option name Hash type spin default %d min 1 max %d", DEFAULT_HASH_MB, MAX_HASH_MB);
+    send_line("option name Clear Hash type button");
+    send_line("option name Threads type spin default 1 min 1 max %d", MAX_THREADS);
+    send_line("option name Ponder type check default false");
+    send_line("option name Move Overhead type spin default %d min 0 max 5000", DEFAULT_MOVE_OVERHEAD_MS);
+    send_line("option name SyzygyPath type string default <empty>");
+    send_line("uciok");
+}
+
+// setoption name <name> [value <value>], names can have spaces.
+static void handle_setoption(engine_t *engine, char *args) {
+    char *name = strstr(args, "name ");
+    if (!name) {
+        return;
+    }
+    name += strlen("name ");
+    char *value = strstr(name, " value ");
+    if (value) {
+        *value = '\0';
+        value += strlen(" value ");
+    } else {
+        value = "";
+    }
+
+    if (strcmp(name, "Hash") == 0) {
+        int size_mb = atoi(value);
+        size_mb = size_mb < 1 ? 1 : (size_mb > MAX_HASH_MB ? MAX_HASH_MB : size_mb);
+        kgchess_tt_t *tt = kgchess_tt_make((size_t)size_mb);
+        if (tt) {
+            kgchess_tt_destroy(engine->tt);
+            engine->tt = tt;
+        } else {
+            send_line("info string allocating %d MB for hash failed", size_mb);
+        }
+    } else if (strcmp(name, "Clear Hash") == 0) {
+        engine_clear(engine);
+    } else if (strcmp(name, "Threads") == 0) {
+        int threads = atoi(value);
+        engine_set_threads(engine, threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads));
+    } else if (strcmp(name, "Move Overhead") == 0) {
+        int overhead_ms = atoi(value);
+        engine->move_overhead_ms = overhead_ms < 0 ? 0 : overhead_ms;
+    } else if (strcmp(name, "SyzygyPath") == 0) {
+        kgchess_tb_destroy(engine->tb);
+        engine->tb = NULL;
+        if (*value && strcmp(value, "<empty>") != 0) {
+            engine->tb = kgchess_tb_make(value);
+            if (engine->tb) {
+                send_line("info string found %d tablebases, up to %d pieces",
+                     kgchess_tb_get_tables_count(engine->tb), kgchess_tb_get_max_pieces(engine->tb));
+            }
+        }
+    } else if (strcmp(name, "Ponder") != 0) {
+        send_line("info string unknown option %s", name);
+    }
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+static void handle_position(engine_t *engine, char *args) {
+    char *moves = strstr(args, "moves");
+    if (moves) {
+        *moves = '\0';
+        moves += strlen("moves");
+    }
+    size_t args_length = strlen(args);
+    while (args_length > 0 && (args[args_length - 1] == ' ' || args[args_length - 1] == '\t')) {
+        args[--args_length] = '\0';
+    }
+    char *fen = strstr(args, "fen ");
+    if (fen) {
+        fen += strlen("fen ");
+        if (!kgchess_set_fen(engine->chess, fen)) {
+            send_line("info string invalid fen %s", fen);
+            kgchess_set_fen(engine->chess, START_FEN);
+            return;
+        }
+    } else {
+        kgchess_set_fen(engine->chess, START_FEN);
+    }
+    if (!moves) {
+        return;
+    }
+    char *save = NULL;
+    for (char *move = strtok_r(moves, " \t", &save); move; move = strtok_r(NULL, " \t", &save)) {
+        if (!play_uci_move(engine->chess, move)) {
+            send_line("info string invalid move %s", move);
+            return;
+        }
+    }
+}
+
+static void handle_go(engine_t *engine, char *args) {
+    go_params_t params;
+    memset(&params, 0, sizeof(go_params_t));
+    char *save = NULL;
+    for (char *token = strtok_r(args, " \t", &save); token; token = strtok_r(NULL, " \t", &save)) {
+        if (strcmp(token, "infinite") == 0) {
+            params.is_infinite = true;
+            continue;
+        } else if (strcmp(token, "ponder") == 0) {
+            params.is_ponder = true;
+            continue;
+        }
+        char *value = strtok_r(NULL, " \t", &save);
+        if (!value) {
+            break;
+        }
+        if (strcmp(token, "wtime") == 0) {
+            params.time_ms[0] = atoi(value);
+        } else if (strcmp(token, "btime") == 0) {
+            params.time_ms[1] = atoi(value);
+        } else if (strcmp(token, "winc") == 0) {
+            params.inc_ms[0] = atoi(value);
+        } else if (strcmp(token, "binc") == 0) {
+            params.inc_ms[1] = atoi(value);
+        } else if (strcmp(token, "movestogo") == 0) {
+            params.moves_to_go = atoi(value);
+        } else if (strcmp(token, "movetime") == 0) {
+            params.move_time_ms = atoi(value);
+        } else if (strcmp(token, "depth") == 0) {
+            params.depth = atoi(value);
+        } else if (strcmp(token, "nodes") == 0) {
+            params.nodes = strtoull(value, NULL, 10);
+        } else if (strcmp(token, "mate") == 0) {
+            params.depth = 2 * atoi(value); // a mate in n moves is found at depth 2n - 1
+        }
+    }
+
+    kgchess_copy_to(engine->search_chess, engine->chess);
+    kgchess_player_t player = kgchess_get_current_player(engine->chess);
+    engine->limits = kgchess_search_limits_make_empty();
+    engine->limits.depth = params.depth;
+    engine->limits.nodes = params.nodes;
+    engine->limits.stop = &engine->stop;
+    engine->limits.tt = engine->tt;
+    engine->limits.tb = engine->tb;
+    engine->limits.threads = engine->threads;
+    engine->limits.orderings = engine->orderings;
+    engine->limits.on_iteration = on_iteration;
+    engine->limits.on_iteration_data = engine;
+
+    engine->stop = false;
+    engine->is_pondering = params.is_infinite || params.is_ponder;
+    engine->is_search_done = false;
+    engine->start_time_ms = get_time_ms();
+    engine->optimum_time_ms = 0;
+    engine->maximum_time_ms = 0;
+    if (!params.is_infinite) {
+        allocate_time(engine, &params, player, &engine->optimum_time_ms, &engine->maximum_time_ms);
+    }
+
+    if (pthread_create(&engine->search_thread, NULL, search_thread, engine) != 0) {
+        send_line("info string starting search thread failed");
+        send_line("bestmove 0000");
+        return;
+    }
+    engine->is_searching = true;
+}
+
+// Time is counted again from ponderhit, the opponent's thinking time was a bonus.
+static void handle_ponderhit(engine_t *engine) {
+    if (!engine->is_searching) {
+        return;
+    }
+    pthread_mutex_lock(&engine->mutex);
+    engine->is_pondering = false;
+    engine->start_time_ms = get_time_ms();
+    pthread_cond_broadcast(&engine->cond);
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+// Moves are in long algebraic notation, e.g. "e2e4", "e1g1" for castling and "e7e8q" for promotions.
+static bool play_uci_move(kgchess_t *chess, const char *str) {
+    if (strlen(str) < 4) {
+        return false;
+    }
+    int from_x = str[0] - 'a', from_y = str[1] - '1', to_x = str[2] - 'a', to_y = str[3] - '1';
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    switch (str[4]) {
+        case 'q': promotion = KGCHESS_PIECE_QUEEN; break;
+        case 'r': promotion = KGCHESS_PIECE_ROOK; break;
+        case 'b': promotion = KGCHESS_PIECE_BISHOP; break;
+        case 'n': promotion = KGCHESS_PIECE_KNIGHT; break;
+        default: break;
+    }
+    kgchess_piece_t piece = kgchess_get_piece_at(chess, from_x, from_y);
+    if (piece.player != kgchess_get_current_player(chess)) {
+        return false;
+    }
+    kgchess_moves_array_t moves = kgchess_get_moves(chess, from_x, from_y);
+    for (int i = 0; i < moves.count; i++) {
+        kgchess_move_t move = moves.items[i];
+        if (move.to.x != to_x || move.to.y != to_y) {
+            continue;
+        }
+        if (!kgchess_move(chess, move)) {
+            return false;
+        }
+        if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+            return kgchess_promote(chess, promotion != KGCHESS_PIECE_NONE ? promotion : KGCHESS_PIECE_QUEEN);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Optimum is the time the search aims for, it doesn't start another depth after using half of it (the next one
+// usually takes longer than all before it). Maximum stops the search in the middle of a depth.
+static void allocate_time(const engine_t *engine, const go_params_t *params, kgchess_player_t player,
+                          int *optimum_ms, int *maximum_ms) {
+    int overhead_ms = engine->move_overhead_ms;
+    if (params->move_time_ms > 0) {
+        int time_ms = params->move_time_ms - overhead_ms;
+        *optimum_ms = time_ms > 1 ? time_ms : 1;
+        *maximum_ms = *optimum_ms;
+        return;
+    }
+    int side = player == KGCHESS_PLAYER_WHITE ? 0 : 1;
+    int time_ms = params->time_ms[side];
+    int inc_ms = params->inc_ms[side];
+    if (time_ms <= 0) {
+        return;
+    }
+    int moves_to_go = params->moves_to_go > 0 ? params->moves_to_go : DEFAULT_MOVES_TO_GO;
+    moves_to_go = moves_to_go < MAX_MOVES_TO_GO ? moves_to_go : MAX_MOVES_TO_GO;
+
+    // time left for this and the following moves until the next time control, keeping the overhead for each
+    int64_t available_ms = (int64_t)time_ms + (int64_t)inc_ms * (moves_to_go - 1) - (int64_t)overhead_ms * moves_to_go;
+    int64_t optimum = available_ms / moves_to_go;
+    int64_t maximum = optimum * 4;
+    int64_t limit_ms = time_ms - overhead_ms;
+    limit_ms = moves_to_go > 1 ? limit_ms * 3 / 4 : limit_ms; // with more moves to go don't spend all of it
+    maximum = maximum < limit_ms ? maximum : limit_ms;
+    maximum = maximum > 1 ? maximum : 1;
+    optimum = optimum < maximum ? optimum : maximum;
+    optimum = optimum > 1 ? optimum : 1;
+    *optimum_ms = (int)optimum;
+    *maximum_ms = (int)maximum;
+}
+
+static void* search_thread(void *data) {
+    engine_t *engine = data;
+    pthread_t timer;
+    bool has_timer = engine->maximum_time_ms > 0 && pthread_create(&timer, NULL, timer_thread, engine) == 0;
+
+    kgchess_search_result_t result;
+    bool ok = kgchess_search(engine->search_chess, engine->limits, &result);
+
+    // While pondering or in infinite mode bestmove can only be sent after stop or ponderhit.
+    pthread_mutex_lock(&engine->mutex);
+    while (engine->is_pondering && !engine->stop) {
+        pthread_cond_wait(&engine->cond, &engine->mutex);
+    }
+    engine->is_search_done = true;
+    pthread_cond_broadcast(&engine->cond);
+    pthread_mutex_unlock(&engine->mutex);
+    if (has_timer) {
+        pthread_join(timer, NULL);
+    }
+
+    if (!ok || result.pv_length == 0) {
+        send_line("bestmove 0000");
+        return NULL;
+    }
+    char best_str[6];
+    move_to_string(result.best_move, result.best_move_promotion, best_str);
+    if (result.pv_length > 1) {
+        char ponder_str[6];
+        move_to_string(result.pv[1], result.pv_promotions[1], ponder_str);
+        send_line("bestmove %s ponder %s", best_str, ponder_str);
+    } else {
+        send_line("bestmove %s", best_str);
+    }
+    return NULL;
+}
+
+// Stops the search once the maximum time has passed, which is counted from ponderhit when pondering.
+static void* timer_thread(void *data) {
+    engine_t *engine = data;
+    pthread_mutex_lock(&engine->mutex);
+    while (!engine->is_search_done && !engine->stop) {
+        if (engine->is_pondering) {
+            pthread_cond_wait(&engine->cond, &engine->mutex);
+            continue;
+        }
+        uint64_t deadline_ms = engine->start_time_ms + (uint64_t)engine->maximum_time_ms;
+        uint64_t now_ms = get_time_ms();
+        if (now_ms >= deadline_ms) {
+            engine->stop = true;
+            break;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t wait_ns = (uint64_t)ts.tv_nsec + (deadline_ms - now_ms) * 1000000;
+        ts.tv_sec += (time_t)(wait_ns / 1000000000);
+        ts.tv_nsec = (long)(wait_ns % 1000000000);
+        pthread_cond_timedwait(&engine->cond, &engine->mutex, &ts);
+    }
+    pthread_mutex_unlock(&engine->mutex);
+    return NULL;
+}
+
+static void on_iteration(const kgchess_search_result_t *result, void *data) {
+    engine_t *engine = data;
+    char pv[KGCHESS_SEARCH_MAX_PLY * 6 + 1];
+    int pv_size = 0;
+    for (int i = 0; i < result->pv_length; i++) {
+        move_to_string(result->pv[i], result->pv_promotions[i], pv + pv_size);
+        pv_size += (int)strlen(pv + pv_size);
+        pv[pv_size++] = ' ';
+    }
+    pv[pv_size > 0 ? pv_size - 1 : 0] = '\0';
+
+    char score[32];
+    if (result->mate_in != 0) {
+        snprintf(score, sizeof(score), "mate %d", result->mate_in);
+    } else {
+        snprintf(score, sizeof(score), "cp %d", result->score);
+    }
+    send_line("info depth %d score %s nodes %llu nps %llu time %d hashfull %d tbhits %llu pv %s",
+         result->depth, score, (unsigned long long)result->nodes, (unsigned long long)result->nps, result->time_ms,
+         kgchess_tt_get_usage_permill(engine->tt), (unsigned long long)result->tb_hits, pv);
+
+    pthread_mutex_lock(&engine->mutex);
+    if (!engine->is_pondering && engine->optimum_time_ms > 0
+        && get_time_ms() - engine->start_time_ms >= (uint64_t)engine->optimum_time_ms / 2) {
+        engine->stop = true;
+    }
+    pthread_mutex_unlock(&engine->mutex);
+}
+
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out) {
+    out[0] = 'a' + move.from.x;
+    out[1] = '1' + move.from.y;
+    out[2] = 'a' + move.to.x;
+    out[3] = '1' + move.to.y;
+    out[4] = '\0';
+    switch (promotion) {
+        case KGCHESS_PIECE_QUEEN: out[4] = 'q'; break;
+        case KGCHESS_PIECE_ROOK: out[4] = 'r'; break;
+        case KGCHESS_PIECE_BISHOP: out[4] = 'b'; break;
+        case KGCHESS_PIECE_KNIGHT: out[4] = 'n'; break;
+        default: break;
+    }
+    out[5] = '\0';
+}
+
+static uint64_t get_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,306 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Move generator correctness and speed check, counts leaf nodes of the game tree and compares them to known values.
+// usage: perft [max_depth]              runs all reference positions
+//        perft divide <depth> [fen] [moves]
+//              prints node counts under every move of position after moves (e.g. "e2e4 e7e5")
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../kgchess.h"
+
+#define MAX_REFERENCE_DEPTH 6
+
+typedef struct {
+    const char *name;
+    const char *fen;
+    const char *moves; // played from fen
+    uint64_t counts[MAX_REFERENCE_DEPTH]; // 0 for depths too slow to run by default
+} reference_position_t;
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Published counts, except for en passant and promotion, which were cross-checked with kgchess 0.1.0
+// (it generated moves square by square without bitboards).
+static const reference_position_t REFERENCE_POSITIONS[] = {
+    {
+        "start", START_FEN, "",
+        { 20, 400, 8902, 197281, 4865609, 119060324 },
+    },
+    {
+        "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", "",
+        { 48, 2039, 97862, 4085603, 193690690, 0 },
+    },
+    {
+        "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", "",
+        { 14, 191, 2812, 43238, 674624, 11030083 },
+    },
+    {
+        "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", "",
+        { 6, 264, 9467, 422333, 15833292, 0 },
+    },
+    {
+        "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", "",
+        { 44, 1486, 62379, 2103487, 89941194, 0 },
+    },
+    {
+        "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", "",
+        { 46, 2079, 89890, 3894594, 164075551, 0 },
+    },
+    {
+        // kiwipete reached by moves, checks that castling rights survive a game
+        "kiwipete moves", START_FEN,
+        "e2e4 e7e6 d2d4 g7g6 d4d5 b7b5 g1f3 b5b4 f3e5 h7h5 d1f3 h5h4 b1c3 h4h3 c1d2 f8g7 f1e2 c8a6 "
+        "c3b1 d8e7 b1c3 g8f6 c3b1 b8c6 b1c3 c6a5 c3b1 a5c4 b1c3 c4b6",
+        { 48, 2039, 97862, 4085603, 0, 0 },
+    },
+    {
+        // en passant capture available right away
+        "en passant", START_FEN, "e2e4 a7a6 e4e5 d7d5",
+        { 31, 781, 24166, 630536, 20105906, 0 },
+    },
+    {
+        // both sides can promote with a capture
+        "promotion", START_FEN, "h2h4 g7g5 h4g5 h7h5 g5g6 h5h4 g6g7 h4h3 a2a3 h3g2",
+        { 31, 848, 24326, 692422, 20756540, 0 },
+    },
+};
+
+static uint64_t perft(kgchess_t *chess, int depth);
+static uint64_t perft_move(kgchess_t *chess, kgchess_move_t move, int depth);
+static bool play_moves(kgchess_t *chess, const char *moves);
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out);
+static double get_time_ms(void);
+
+static const kgchess_piece_type_t PROMOTION_PIECES[] = {
+    KGCHESS_PIECE_QUEEN, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_BISHOP, KGCHESS_PIECE_KNIGHT,
+};
+
+static int run_reference_positions(int max_depth) {
+    bool all_ok = true;
+    uint64_t total_nodes = 0;
+    double total_time_ms = 0;
+    for (size_t i = 0; i < sizeof(REFERENCE_POSITIONS) / sizeof(REFERENCE_POSITIONS[0]); i++) {
+        const reference_position_t *position = &REFERENCE_POSITIONS[i];
+        kgchess_t *chess = kgchess_make_from_fen(position->fen);
+        if (!chess || !play_moves(chess, position->moves)) {
+            printf("%-14s invalid position\n", position->name);
+            all_ok = false;
+            kgchess_destroy(chess);
+            continue;
+        }
+        for (int depth = 1; depth <= max_depth && depth <= MAX_REFERENCE_DEPTH; depth++) {
+            uint64_t expected = position->counts[depth - 1];
+            if (expected == 0) {
+                break;
+            }
+            double start_ms = get_time_ms();
+            uint64_t nodes = perft(chess, depth);
+            double time_ms = get_time_ms() - start_ms;
+            total_nodes += nodes;
+            total_time_ms += time_ms;
+            bool ok = nodes == expected;
+            all_ok = all_ok && ok;
+            printf("%-14s depth %d %12llu nodes %9.1f ms %12.0f nps %s",
+                   position->name, depth, (unsigned long long)nodes, time_ms,
+                   time_ms > 0 ? nodes * 1000.0 / time_ms : 0.0, ok ? "ok" : "FAILED");
+            if (!ok) {
+                printf(" (expected %llu)", (unsigned long long)expected);
+            }
+            printf("\n");
+        }
+        if (chess) {
+            kgchess_destroy(chess);
+        }
+    }
+    printf("%s, %llu nodes in %.1f ms (%.0f nps)\n", all_ok ? "all ok" : "FAILED",
+           (unsigned long long)total_nodes, total_time_ms,
+           total_time_ms > 0 ? total_nodes * 1000.0 / total_time_ms : 0.0);
+    return all_ok ? 0 : 1;
+}
+
+static int run_divide(int depth, const char *fen, const char *moves) {
+    kgchess_t *chess = kgchess_make_from_fen(fen);
+    if (!chess) {
+        fprintf(stderr, "Invalid FEN.\n");
+        return 1;
+    }
+    if (!play_moves(chess, moves)) {
+        fprintf(stderr, "Invalid moves.\n");
+        kgchess_destroy(chess);
+        return 1;
+    }
+    double start_ms = get_time_ms();
+    uint64_t total_nodes = 0;
+    kgchess_move_t legal_moves[KGCHESS_MAX_MOVES];
+    int legal_moves_count = kgchess_get_all_moves(chess, legal_moves, KGCHESS_MAX_MOVES);
+    for (int i = 0; i < legal_moves_count; i++) {
+        kgchess_move_t move = legal_moves[i];
+        kgchess_push_move(chess, move);
+        if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+            kgchess_pop_move(chess);
+            for (int j = 0; j < 4; j++) {
+                kgchess_push_move(chess, move);
+                kgchess_promote(chess, PROMOTION_PIECES[j]);
+                uint64_t nodes = depth > 1 ? perft(chess, depth - 1) : 1;
+                kgchess_pop_move(chess);
+                char move_str[6];
+                move_to_string(move, PROMOTION_PIECES[j], move_str);
+                printf("%s: %llu\n", move_str, (unsigned long long)nodes);
+                total_nodes += nodes;
+            }
+        } else {
+            uint64_t nodes = depth > 1 ? perft(chess, depth - 1) : 1;
+            kgchess_pop_move(chess);
+            char move_str[6];
+            move_to_string(move, KGCHESS_PIECE_NONE, move_str);
+            printf("%s: %llu\n", move_str, (unsigned long long)nodes);
+            total_nodes += nodes;
+        }
+    }
+    double time_ms = get_time_ms() - start_ms;
+    printf("\nmoves: %d\nnodes: %llu\ntime: %.1f ms\nnps: %.0f\n", legal_moves_count, (unsigned long long)total_nodes,
+           time_ms, time_ms > 0 ? total_nodes * 1000.0 / time_ms : 0.0);
+    kgchess_destroy(chess);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "divide") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: perft divide <depth> [fen] [moves]\n");
+            return 1;
+        }
+        // FEN is optional, it's told apart from moves by its slashes
+        const char *fen = START_FEN;
+        int moves_arg = 3;
+        if (argc > 3 && strchr(argv[3], '/')) {
+            fen = argv[3];
+            moves_arg = 4;
+        }
+        return run_divide(atoi(argv[2]), fen, argc > moves_arg ? argv[moves_arg] : "");
+    }
+    int max_depth = argc > 1 ? atoi(argv[1]) : 5;
+    return run_reference_positions(max_depth);
+}
+
+// Promotions count as four moves, one for every piece a pawn can become.
+static uint64_t perft(kgchess_t *chess, int depth) {
+    kgchess_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_all_moves(chess, moves, KGCHESS_MAX_MOVES);
+    uint64_t nodes = 0;
+    for (int i = 0; i < moves_count; i++) {
+        nodes += perft_move(chess, moves[i], depth);
+    }
+    return nodes;
+}
+
+static uint64_t perft_move(kgchess_t *chess, kgchess_move_t move, int depth) {
+    kgchess_piece_t piece = kgchess_get_piece_at(chess, move.from.x, move.from.y);
+    bool is_promotion = piece.type == KGCHESS_PIECE_PAWN && (move.to.y == 0 || move.to.y == 7);
+    if (depth == 1) {
+        return is_promotion ? 4 : 1;
+    }
+    uint64_t nodes = 0;
+    int promotions_count = is_promotion ? 4 : 1;
+    for (int i = 0; i < promotions_count; i++) {
+        kgchess_push_move(chess, move);
+        if (is_promotion) {
+            kgchess_promote(chess, PROMOTION_PIECES[i]);
+        }
+        nodes += perft(chess, depth - 1);
+        kgchess_pop_move(chess);
+    }
+    return nodes;
+}
+
+// Moves are in coordinate notation separated by spaces, e.g. "e2e4 e7e5 g8f6" or "a7a8q".
+static bool play_moves(kgchess_t *chess, const char *moves) {
+    const char *it = moves;
+    while (*it) {
+        if (*it == ' ') {
+            it++;
+            continue;
+        }
+        if (strlen(it) < 4) {
+            return false;
+        }
+        int from_x = it[0] - 'a', from_y = it[1] - '1', to_x = it[2] - 'a', to_y = it[3] - '1';
+        it += 4;
+        kgchess_move_t legal_moves[KGCHESS_MAX_MOVES];
+        int legal_moves_count = kgchess_get_all_moves(chess, legal_moves, KGCHESS_MAX_MOVES);
+        bool found = false;
+        for (int i = 0; i < legal_moves_count; i++) {
+            kgchess_move_t move = legal_moves[i];
+            if (move.from.x == from_x && move.from.y == from_y && move.to.x == to_x && move.to.y == to_y) {
+                kgchess_move(chess, move);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+            kgchess_piece_type_t promotion = KGCHESS_PIECE_QUEEN;
+            switch (*it) {
+                case 'r': promotion = KGCHESS_PIECE_ROOK; it++; break;
+                case 'b': promotion = KGCHESS_PIECE_BISHOP; it++; break;
+                case 'n': promotion = KGCHESS_PIECE_KNIGHT; it++; break;
+                case 'q': it++; break;
+                default: break;
+            }
+            kgchess_promote(chess, promotion);
+        }
+    }
+    return true;
+}
+
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out) {
+    out[0] = 'a' + move.from.x;
+    out[1] = '1' + move.from.y;
+    out[2] = 'a' + move.to.x;
+    out[3] = '1' + move.to.y;
+    out[4] = '\0';
+    switch (promotion) {
+        case KGCHESS_PIECE_QUEEN: out[4] = 'q'; break;
+        case KGCHESS_PIECE_ROOK: out[4] = 'r'; break;
+        case KGCHESS_PIECE_BISHOP: out[4] = 'b'; break;
+        case KGCHESS_PIECE_KNIGHT: out[4] = 'n'; break;
+        default: break;
+    }
+    out[5] = '\0';
+}
+
+static double get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
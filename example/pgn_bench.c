@@ -0,0 +1,214 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Measures how fast games are read from a PGN file and replayed.
+// usage: pgn_bench <file.pgn> [threads]           replays all games, threads split the file at game boundaries
+//        pgn_bench generate <games> <file.pgn>    writes random games to replay
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../kgchess.h"
+#include "../kgchess_pgn.h"
+
+#define MAX_THREADS 64
+#define MAX_GENERATED_PLIES 200
+#define LINE_LENGTH 80
+
+typedef struct worker {
+    pthread_t thread;
+    const char *data;
+    size_t size;
+    int games_count;
+    int errors_count;
+    long long plies_count;
+    size_t first_error_offset;
+} worker_t;
+
+static void* replay_games(void *arg);
+static int generate(int games_count, const char *path);
+static double get_time_ms(void);
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "generate") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "usage: pgn_bench generate <games> <file.pgn>\n");
+            return 1;
+        }
+        return generate(atoi(argv[2]), argv[3]);
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: pgn_bench <file.pgn> [threads]\n");
+        return 1;
+    }
+
+    int threads_count = argc > 2 ? atoi(argv[2]) : 1;
+    if (threads_count < 1 || threads_count > MAX_THREADS) {
+        fprintf(stderr, "Threads must be between 1 and %d.\n", MAX_THREADS);
+        return 1;
+    }
+
+    double start_ms = get_time_ms();
+    kgchess_pgn_file_t *file = kgchess_pgn_file_open(argv[1]);
+    if (!file) {
+        fprintf(stderr, "Opening %s failed.\n", argv[1]);
+        return 1;
+    }
+    const char *data = kgchess_pgn_file_get_data(file);
+    size_t size = kgchess_pgn_file_get_size(file);
+
+    worker_t workers[MAX_THREADS];
+    memset(workers, 0, sizeof(workers));
+    size_t chunk_start = 0;
+    for (int i = 0; i < threads_count; i++) {
+        size_t chunk_end = size;
+        if (i < threads_count - 1) {
+            chunk_end = kgchess_pgn_find_game_start(data, size, size / threads_count * (i + 1));
+            if (chunk_end < chunk_start) {
+                chunk_end = chunk_start;
+            }
+        }
+        workers[i].data = data + chunk_start;
+        workers[i].size = chunk_end - chunk_start;
+        chunk_start = chunk_end;
+    }
+    for (int i = 1; i < threads_count; i++) {
+        pthread_create(&workers[i].thread, NULL, replay_games, &workers[i]);
+    }
+    replay_games(&workers[0]);
+
+    int games_count = workers[0].games_count;
+    int errors_count = workers[0].errors_count;
+    long long plies_count = workers[0].plies_count;
+    for (int i = 1; i < threads_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        games_count += workers[i].games_count;
+        errors_count += workers[i].errors_count;
+        plies_count += workers[i].plies_count;
+    }
+    double elapsed_ms = get_time_ms() - start_ms;
+
+    printf("file:     %s (%.1f MB)\n", argv[1], size / (1024.0 * 1024.0));
+    printf("threads:  %d\n", threads_count);
+    printf("games:    %d (%d with errors)\n", games_count, errors_count);
+    printf("plies:    %lld\n", plies_count);
+    printf("time:     %.0f ms\n", elapsed_ms);
+    printf("speed:    %.0f games/s, %.0f plies/s, %.1f MB/s\n", games_count * 1000.0 / elapsed_ms,
+           plies_count * 1000.0 / elapsed_ms, size / (1024.0 * 1024.0) * 1000.0 / elapsed_ms);
+    for (int i = 0; i < threads_count; i++) {
+        if (workers[i].errors_count > 0) {
+            printf("first error in thread %d at offset %zu\n", i,
+                   (size_t)(workers[i].data - data) + workers[i].first_error_offset);
+        }
+    }
+
+    kgchess_pgn_file_close(file);
+    return errors_count > 0 ? 1 : 0;
+}
+
+static void* replay_games(void *arg) {
+    worker_t *worker = arg;
+    kgchess_t *chess = kgchess_make();
+    kgchess_pgn_reader_t reader;
+    kgchess_pgn_reader_init(&reader, worker->data, worker->size);
+    kgchess_pgn_game_t game;
+    while (kgchess_pgn_read_game(&reader, &game)) {
+        int plies_count = kgchess_pgn_replay(&game, chess, NULL, NULL);
+        if (plies_count < 0) {
+            if (worker->errors_count == 0) {
+                worker->first_error_offset = game.offset;
+            }
+            worker->errors_count++;
+        } else {
+            worker->plies_count += plies_count;
+        }
+        worker->games_count++;
+    }
+    kgchess_destroy(chess);
+    return NULL;
+}
+
+static int generate(int games_count, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Opening %s failed.\n", path);
+        return 1;
+    }
+    unsigned int seed = 1;
+    kgchess_t *chess = kgchess_make();
+    for (int i = 0; i < games_count; i++) {
+        kgchess_set_fen(chess, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        char movetext[MAX_GENERATED_PLIES * (KGCHESS_MAX_SAN_LENGTH + 8)];
+        int movetext_len = 0;
+        int line_len = 0;
+        for (int ply = 0; ply < MAX_GENERATED_PLIES && kgchess_get_state(chess) == KGCHESS_STATE_MOVE; ply++) {
+            kgchess_move_t moves[KGCHESS_MAX_MOVES];
+            int moves_count = kgchess_get_all_moves(chess, moves, KGCHESS_MAX_MOVES);
+            seed = seed * 1103515245 + 12345;
+            kgchess_move_t move = moves[(seed >> 16) % moves_count];
+            char token[KGCHESS_MAX_SAN_LENGTH + 8];
+            int token_len = 0;
+            if (ply % 2 == 0) {
+                token_len = sprintf(token, "%d. ", ply / 2 + 1);
+            }
+            token_len += kgchess_move_to_san(chess, move, KGCHESS_PIECE_QUEEN, token + token_len, KGCHESS_MAX_SAN_LENGTH);
+            if (line_len + token_len + 1 > LINE_LENGTH) {
+                movetext[movetext_len++] = '\n';
+                line_len = 0;
+            } else if (line_len > 0) {
+                movetext[movetext_len++] = ' ';
+                line_len++;
+            }
+            memcpy(movetext + movetext_len, token, token_len);
+            movetext_len += token_len;
+            line_len += token_len;
+            kgchess_move(chess, move);
+            if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+                kgchess_promote(chess, KGCHESS_PIECE_QUEEN);
+            }
+        }
+        kgchess_player_t winner = kgchess_get_winner(chess);
+        const char *result = "*";
+        if (kgchess_get_state(chess) == KGCHESS_STATE_ENDED) {
+            result = winner == KGCHESS_PLAYER_WHITE ? "1-0" : winner == KGCHESS_PLAYER_BLACK ? "0-1" : "1/2-1/2";
+        }
+        fprintf(file, "[Event \"pgn_bench\"]\n[Site \"?\"]\n[Date \"????.??.??\"]\n[Round \"%d\"]\n"
+                "[White \"random\"]\n[Black \"random\"]\n[Result \"%s\"]\n\n%.*s %s\n\n",
+                i + 1, result, movetext_len, movetext, result);
+    }
+    kgchess_destroy(chess);
+    fclose(file);
+    return 0;
+}
+
+static double get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
@@ -23,7 +23,6 @@
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
-#include <limits.h>
 #include <time.h>
 
 #ifdef WIN32
@@ -35,10 +34,14 @@
 #endif
 
 #include "../kgchess.h"
+#include "../kgchess_search.h"
 
 #define BOARD_SIZE 320
 #define BOARD_MARGIN 10
 #define PIECE_SIZE (BOARD_SIZE / 8)
+#define AI_TIME_MS 500 // per move, the game waits for it
+#define AI_MAX_DEPTH 12
+#define AI_TT_SIZE_MB 16
 
 typedef enum game_state {
     GAME_STATE_NONE = 0,
@@ -51,6 +54,8 @@ typedef struct game {
     SDL_Renderer *renderer;
     SDL_Texture *pieces_texture;
     kgchess_t *chess;
+    kgchess_tt_t *tt; // kept between ai moves
+    kgchess_ordering_t *ordering; // as well
     game_state_t state;
     int cursor_x;
     int cursor_y;
@@ -64,8 +69,7 @@ static void game_render(game_t *game);
 static void highlight_field(game_t *game, int x, int y);
 static SDL_Rect get_field_rect(game_t *game, int x, int y);
 
-static int chessai_rate_move(kgchess_t *chess, kgchess_move_t move);
-static bool chessai_move(kgchess_t *chess);
+static bool chessai_move(game_t *game);
 
 int main(int argc, char *argv[]) {
     srand((unsigned int)time(NULL));
@@ -125,8 +129,10 @@ static game_t* game_make(SDL_Renderer *renderer) {
     game->pieces_texture = IMG_LoadTexture(renderer, "pieces.png");
     assert(game->pieces_texture);
     game->chess = kgchess_make();
+    game->tt = kgchess_tt_make(AI_TT_SIZE_MB);
+    game->ordering = kgchess_ordering_make();
     if (rand() % 2) {
-        chessai_move(game->chess);
+        chessai_move(game);
     }
     game->state = GAME_STATE_SELECT;
     game->cursor_x = -1;
@@ -174,8 +180,7 @@ static bool game_on_clicked(game_t *game, int mx, int my) {
                 game->state = GAME_STATE_PROMOTION;
             } else {
                 game->state = GAME_STATE_SELECT;
-                chessai_move(game->chess);
-
+                chessai_move(game);
             }
             game->cursor_x = -1;
             game->cursor_y = -1;
@@ -188,7 +193,7 @@ static bool game_on_clicked(game_t *game, int mx, int my) {
             bool ok = kgchess_promote(game->chess, x);
             if (ok) {
                 game->state = GAME_STATE_SELECT;
-                chessai_move(game->chess);
+                chessai_move(game);
             }
         }
         default: break;
@@ -280,45 +285,19 @@ static SDL_Rect get_field_rect(game_t *game, int x, int y) {
     return (SDL_Rect){ BOARD_MARGIN + x * PIECE_SIZE, BOARD_MARGIN + (7 - y) * PIECE_SIZE, PIECE_SIZE, PIECE_SIZE };
 }
 
-static int chessai_rate_move(kgchess_t *chess, kgchess_move_t move) {
-    kgchess_player_t player = kgchess_get_current_player(chess);
-    kgchess_player_t enemy = kgchess_get_enemy_player(player);
-    int result = 0;
-    if (kgchess_is_square_attacked_by_player(chess, move.to.x, move.to.y, enemy)) {
-        result -= 20;
-    }
-    if (move.is_attack) {
-        result += 10;
-    }
-    result += (rand()%20-10);
-    return result;
-}
-
-static bool chessai_move(kgchess_t *chess) {
-    int best_move_score = INT_MIN;
-    kgchess_move_t best_move = {};
-    kgchess_player_t player = kgchess_get_current_player(chess);
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 8; y++) {
-            kgchess_piece_t p = kgchess_get_piece_at(chess, x, y);
-            if (p.player != player) {
-                continue;
-            }
-            kgchess_moves_array_t moves = kgchess_get_moves(chess, x, y);
-            for (int i = 0; i < moves.count; i++) {
-                kgchess_move_t move = moves.items[i];
-                int score = chessai_rate_move(chess, move);
-                if (score > best_move_score) {
-                    best_move = move;
-                    best_move_score = score;
-                }
-            }
-        }
-    }
-
-    if (best_move_score == INT_MIN) {
+static bool chessai_move(game_t *game) {
+    kgchess_search_limits_t limits = kgchess_search_limits_make_empty();
+    limits.depth = AI_MAX_DEPTH;
+    limits.time_ms = AI_TIME_MS;
+    limits.tt = game->tt;
+    limits.orderings = game->ordering ? &game->ordering : NULL;
+    kgchess_search_result_t result;
+    if (!kgchess_search(game->chess, limits, &result)) {
         return false;
     }
-    kgchess_move(chess, best_move);
+    kgchess_move(game->chess, result.best_move);
+    if (kgchess_get_state(game->chess) == KGCHESS_STATE_PROMOTION) {
+        kgchess_promote(game->chess, result.best_move_promotion);
+    }
     return true;
 }
@@ -0,0 +1,94 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Searches a fixed set of positions to a fixed depth and reports nodes and time, so changes to the search
+// and move ordering can be compared by nodes to depth.
+// usage: search_bench [depth]
+// Built with -DKGCHESS_USE_STATS it also prints how often the library's hot paths ran and how long they took.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../kgchess.h"
+#include "../kgchess_tt.h"
+#include "../kgchess_search.h"
+
+#define TT_SIZE_MB 64
+
+static const char *POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    "2r3k1/pp3pp1/4p2p/3pP3/3P1P2/P4N2/1Pr3PP/R4RK1 b - - 0 24",
+    "r1b2rk1/2q1bppp/p2ppn2/1p6/3BP3/1BN5/PPP1QPPP/R4RK1 w - - 0 13",
+    "8/8/4k3/3p4/3P1K2/8/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "r2q1rk1/ppp2ppp/2n1bn2/2b1p3/4P3/2NP1N2/PPP1BPPP/R1BQ1RK1 w - - 0 8",
+};
+
+int main(int argc, char *argv[]) {
+    int depth = argc > 1 ? atoi(argv[1]) : 7;
+
+    kgchess_tt_t *tt = kgchess_tt_make(TT_SIZE_MB);
+    if (!tt) {
+        fprintf(stderr, "Allocating transposition table failed.\n");
+        return 1;
+    }
+
+    uint64_t total_nodes = 0;
+    uint64_t total_time_ms = 0;
+    for (size_t i = 0; i < sizeof(POSITIONS) / sizeof(POSITIONS[0]); i++) {
+        kgchess_t *chess = kgchess_make_from_fen(POSITIONS[i]);
+        if (!chess) {
+            fprintf(stderr, "Invalid FEN: %s\n", POSITIONS[i]);
+            return 1;
+        }
+        kgchess_tt_clear(tt);
+        kgchess_search_limits_t limits = kgchess_search_limits_make_empty();
+        limits.depth = depth;
+        limits.tt = tt;
+        kgchess_search_result_t result;
+        kgchess_search(chess, limits, &result);
+        printf("position %2d %12llu nodes %8d ms  score %6d\n", (int)i + 1, (unsigned long long)result.nodes,
+               result.time_ms, result.score);
+        total_nodes += result.nodes;
+        total_time_ms += result.time_ms;
+        kgchess_destroy(chess);
+    }
+    uint64_t nps = total_time_ms > 0 ? total_nodes * 1000 / total_time_ms : 0;
+    printf("depth %d: %llu nodes in %llu ms (%llu nps)\n", depth, (unsigned long long)total_nodes,
+           (unsigned long long)total_time_ms, (unsigned long long)nps);
+
+    if (kgchess_is_stats_enabled()) {
+        kgchess_stats_t stats = kgchess_get_stats();
+        char stats_str[KGCHESS_MAX_STATS_STRING_LENGTH];
+        kgchess_stats_to_string(&stats, stats_str, sizeof(stats_str));
+        printf("\n%s", stats_str);
+    }
+
+    kgchess_tt_destroy(tt);
+    return 0;
+}
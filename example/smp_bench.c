@@ -0,0 +1,116 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Measures how much faster a fixed depth search gets with more threads (time to depth).
+// usage: smp_bench [depth] [max_threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../kgchess.h"
+#include "../kgchess_tt.h"
+#include "../kgchess_search.h"
+
+#define TT_SIZE_MB 64
+
+// Positions are given as moves from the starting position.
+static const char *POSITIONS[] = {
+    "",
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7",
+    "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4 e2e3 e8g8 f1d3 d7d5",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6 c1e3 e7e5 d4b3 c8e6",
+};
+
+static bool play_moves(kgchess_t *chess, const char *moves);
+
+int main(int argc, char *argv[]) {
+    int depth = argc > 1 ? atoi(argv[1]) : 8;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 16;
+
+    kgchess_tt_t *tt = kgchess_tt_make(TT_SIZE_MB);
+    if (!tt) {
+        fprintf(stderr, "Allocating transposition table failed.\n");
+        return 1;
+    }
+
+    double base_time_ms = 0;
+    printf("%8s %12s %14s %12s %8s\n", "threads", "time (ms)", "nodes", "nps", "speedup");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double total_time_ms = 0;
+        uint64_t total_nodes = 0;
+        for (size_t i = 0; i < sizeof(POSITIONS) / sizeof(POSITIONS[0]); i++) {
+            kgchess_t *chess = kgchess_make();
+            if (!play_moves(chess, POSITIONS[i])) {
+                fprintf(stderr, "Invalid moves in position %d.\n", (int)i);
+                return 1;
+            }
+            kgchess_tt_clear(tt);
+            kgchess_search_limits_t limits = kgchess_search_limits_make_empty();
+            limits.depth = depth;
+            limits.threads = threads;
+            limits.tt = tt;
+            kgchess_search_result_t result;
+            kgchess_search(chess, limits, &result);
+            total_time_ms += result.time_ms;
+            total_nodes += result.nodes;
+            kgchess_destroy(chess);
+        }
+        if (threads == 1) {
+            base_time_ms = total_time_ms;
+        }
+        uint64_t nps = total_time_ms > 0 ? (uint64_t)(total_nodes * 1000 / total_time_ms) : 0;
+        double speedup = total_time_ms > 0 ? base_time_ms / total_time_ms : 0;
+        printf("%8d %12.0f %14llu %12llu %7.2fx\n", threads, total_time_ms, (unsigned long long)total_nodes,
+               (unsigned long long)nps, speedup);
+    }
+
+    kgchess_tt_destroy(tt);
+    return 0;
+}
+
+static bool play_moves(kgchess_t *chess, const char *moves) {
+    const char *it = moves;
+    while (*it) {
+        if (*it == ' ') {
+            it++;
+            continue;
+        }
+        int from_x = it[0] - 'a', from_y = it[1] - '1', to_x = it[2] - 'a', to_y = it[3] - '1';
+        kgchess_move_t legal_moves[KGCHESS_MAX_MOVES];
+        int legal_moves_count = kgchess_get_all_moves(chess, legal_moves, KGCHESS_MAX_MOVES);
+        bool found = false;
+        for (int i = 0; i < legal_moves_count; i++) {
+            kgchess_move_t move = legal_moves[i];
+            if (move.from.x == from_x && move.from.y == from_y && move.to.x == to_x && move.to.y == to_y) {
+                kgchess_move(chess, move);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        it += 4;
+    }
+    return true;
+}
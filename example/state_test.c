@@ -0,0 +1,345 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Game state checks, plays moves and compares state, end reason and winner with the expected ones. Random games
+// compare them with ones worked out from scratch after every move.
+// usage: state_test [random_games]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../kgchess.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define DEFAULT_RANDOM_GAMES 2000
+#define MAX_RANDOM_GAME_PLIES 600
+#define DARK_SQUARES 0xaa55aa55aa55aa55ull
+
+typedef struct {
+    const char *name;
+    const char *fen;
+    const char *moves; // played from fen
+    kgchess_state_t state;
+    kgchess_end_reason_t end_reason;
+    kgchess_player_t winner;
+} reference_game_t;
+
+static const reference_game_t REFERENCE_GAMES[] = {
+    {
+        "checkmate", START_FEN, "f2f3 e7e5 g2g4 d8h4",
+        KGCHESS_STATE_ENDED, KGCHESS_END_CHECKMATE, KGCHESS_PLAYER_BLACK,
+    },
+    {
+        "stalemate", "k7/8/1K6/8/8/8/8/2Q5 w - - 0 1", "c1c7",
+        KGCHESS_STATE_ENDED, KGCHESS_END_STALEMATE, KGCHESS_PLAYER_NONE,
+    },
+    {
+        "fifty moves", "4k3/8/8/8/8/8/4P3/R3K3 w - - 99 80", "a1a2",
+        KGCHESS_STATE_ENDED, KGCHESS_END_FIFTY_MOVES, KGCHESS_PLAYER_NONE,
+    },
+    {
+        // the clock is still over 100 plies
+        "fifty moves, king move", "4k3/8/8/8/8/8/4P3/R3K3 w - - 99 80", "a1a2 e8d8",
+        KGCHESS_STATE_ENDED, KGCHESS_END_FIFTY_MOVES, KGCHESS_PLAYER_NONE,
+    },
+    {
+        // the pawn move resets the clock, so the game goes on
+        "fifty moves, pawn move", "4k3/8/8/8/8/8/4P3/R3K3 w - - 99 80", "a1a2 e8d8 e2e4",
+        KGCHESS_STATE_MOVE, KGCHESS_END_NONE, KGCHESS_PLAYER_NONE,
+    },
+    {
+        "repetition", START_FEN, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1 f6g8",
+        KGCHESS_STATE_ENDED, KGCHESS_END_REPETITION, KGCHESS_PLAYER_NONE,
+    },
+    {
+        "repetition, new position", START_FEN, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1 f6g8 e2e4",
+        KGCHESS_STATE_MOVE, KGCHESS_END_NONE, KGCHESS_PLAYER_NONE,
+    },
+    {
+        "insufficient material", "k7/8/8/8/8/8/1r6/K7 w - - 0 1", "a1b2",
+        KGCHESS_STATE_ENDED, KGCHESS_END_INSUFFICIENT_MATERIAL, KGCHESS_PLAYER_NONE,
+    },
+    {
+        "insufficient material, king move", "k7/8/8/8/8/8/1r6/K7 w - - 0 1", "a1b2 a8b8",
+        KGCHESS_STATE_ENDED, KGCHESS_END_INSUFFICIENT_MATERIAL, KGCHESS_PLAYER_NONE,
+    },
+    {
+        // a fifty-move draw checkmated right after
+        "fifty moves, checkmate", "k7/8/1K6/8/8/8/8/7R w - - 99 80", "h1h2 a8b8 h2h8",
+        KGCHESS_STATE_ENDED, KGCHESS_END_CHECKMATE, KGCHESS_PLAYER_WHITE,
+    },
+};
+
+static bool check_reference_games(void);
+static bool check_pop_after_draw(void);
+static bool check_declared_draw(void);
+static bool check_copied_history(void);
+static bool check_random_games(int games_count);
+static bool check_random_position(kgchess_t *chess, const uint64_t *hashes, int ply, kgchess_end_reason_t *end_reason);
+static kgchess_end_reason_t get_expected_end_reason(kgchess_t *chess, const uint64_t *hashes, int ply);
+static bool is_material_insufficient(kgchess_t *chess);
+static bool play_moves(kgchess_t *chess, const char *moves);
+static uint64_t next_random(uint64_t *state);
+
+int main(int argc, char *argv[]) {
+    bool all_ok = check_reference_games();
+    all_ok = check_pop_after_draw() && all_ok;
+    all_ok = check_declared_draw() && all_ok;
+    all_ok = check_copied_history() && all_ok;
+    all_ok = check_random_games(argc > 1 ? atoi(argv[1]) : DEFAULT_RANDOM_GAMES) && all_ok;
+    printf("%s\n", all_ok ? "all ok" : "FAILED");
+    return all_ok ? 0 : 1;
+}
+
+static bool check_reference_games(void) {
+    bool all_ok = true;
+    for (size_t i = 0; i < sizeof(REFERENCE_GAMES) / sizeof(REFERENCE_GAMES[0]); i++) {
+        const reference_game_t *game = &REFERENCE_GAMES[i];
+        kgchess_t *chess = kgchess_make_from_fen(game->fen);
+        if (!chess || !play_moves(chess, game->moves)) {
+            printf("%-32s invalid moves FAILED\n", game->name);
+            all_ok = false;
+            kgchess_destroy(chess);
+            continue;
+        }
+        kgchess_state_t state = kgchess_get_state(chess);
+        kgchess_end_reason_t end_reason = kgchess_get_end_reason(chess);
+        kgchess_player_t winner = kgchess_get_winner(chess);
+        bool ok = state == game->state && end_reason == game->end_reason && winner == game->winner;
+        all_ok = all_ok && ok;
+        printf("%-32s state %d end reason %d winner %d %s", game->name, state, end_reason, winner, ok ? "ok" : "FAILED");
+        if (!ok) {
+            printf(" (expected %d %d %d)", game->state, game->end_reason, game->winner);
+        }
+        printf("\n");
+        kgchess_destroy(chess);
+    }
+    return all_ok;
+}
+
+// Taking back the move made after a draw brings the draw back.
+static bool check_pop_after_draw(void) {
+    kgchess_t *chess = kgchess_make_from_fen("4k3/8/8/8/8/8/4P3/R3K3 w - - 99 80");
+    bool ok = chess && play_moves(chess, "a1a2") && kgchess_get_state(chess) == KGCHESS_STATE_ENDED;
+    kgchess_move_t move = { { 4, 7 }, { 3, 7 }, false, false, false };
+    ok = ok && kgchess_push_move(chess, move);
+    ok = ok && kgchess_get_state(chess) == KGCHESS_STATE_ENDED; // the clock is still over 100 plies
+    ok = ok && kgchess_pop_move(chess);
+    ok = ok && kgchess_get_state(chess) == KGCHESS_STATE_ENDED
+        && kgchess_get_end_reason(chess) == KGCHESS_END_FIFTY_MOVES;
+    printf("%-32s %s\n", "pop after draw", ok ? "ok" : "FAILED");
+    kgchess_destroy(chess);
+    return ok;
+}
+
+// Declared results aren't checked again, so they stay after later moves.
+static bool check_declared_draw(void) {
+    kgchess_t *chess = kgchess_make();
+    kgchess_draw(chess);
+    bool ok = play_moves(chess, "e2e4");
+    ok = ok && kgchess_get_state(chess) == KGCHESS_STATE_ENDED
+        && kgchess_get_end_reason(chess) == KGCHESS_END_DECLARED;
+    printf("%-32s %s\n", "declared draw", ok ? "ok" : "FAILED");
+    kgchess_destroy(chess);
+    return ok;
+}
+
+// Boards set up in their own memory get history only when it's given, positions that can repeat are copied into it.
+static bool check_copied_history(void) {
+    kgchess_t *chess = kgchess_make();
+    char *mem = malloc(kgchess_sizeof() + kgchess_history_sizeof(4));
+    kgchess_t *board = kgchess_init_at(mem);
+    // g1f3 g8f6 f3g1 f6g8
+    const kgchess_move_t moves[] = {
+        { { 6, 0 }, { 5, 2 }, false, false, false }, { { 6, 7 }, { 5, 5 }, false, false, false },
+        { { 5, 2 }, { 6, 0 }, false, false, false }, { { 5, 5 }, { 6, 7 }, false, false, false },
+    };
+    bool ok = !kgchess_push_move(board, moves[0]);
+    ok = ok && play_moves(chess, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1");
+    kgchess_set_history(board, mem + kgchess_sizeof(), 4);
+    kgchess_copy_to(board, chess);
+    ok = ok && play_moves(board, "f6g8") && kgchess_get_end_reason(board) == KGCHESS_END_REPETITION;
+    for (int i = 0; i < 4; i++) {
+        ok = ok && kgchess_push_move(board, moves[i]);
+    }
+    ok = ok && !kgchess_push_move(board, moves[0]);
+    printf("%-32s %s\n", "copied history", ok ? "ok" : "FAILED");
+    kgchess_destroy(chess);
+    free(mem);
+    return ok;
+}
+
+// Plays random moves, asking for the state only after some of them, so it's looked at from positions that weren't
+// checked before and from ones taken back with kgchess_pop_move. Games go on after some draws, to see them reset.
+static bool check_random_games(int games_count) {
+    kgchess_t *chess = kgchess_make();
+    uint64_t hashes[MAX_RANDOM_GAME_PLIES + 1]; // of positions of the game, to count repetitions
+    int end_reasons_count[KGCHESS_END_DECLARED + 1] = { 0 };
+    uint64_t random_state = 0x9e3779b97f4a7c15ull;
+    bool ok = chess != NULL;
+    for (int game = 0; ok && game < games_count; game++) {
+        kgchess_set_fen(chess, START_FEN);
+        hashes[0] = kgchess_get_hash(chess);
+        for (int ply = 0; ok && ply < MAX_RANDOM_GAME_PLIES; ply++) {
+            kgchess_end_reason_t end_reason = KGCHESS_END_NONE;
+            if (next_random(&random_state) % 2 == 0) {
+                ok = check_random_position(chess, hashes, ply, &end_reason);
+                end_reasons_count[end_reason]++;
+            }
+            kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+            int moves_count = kgchess_get_all_packed_moves(chess, moves, KGCHESS_MAX_MOVES);
+            if (moves_count == 0 || (end_reason != KGCHESS_END_NONE && next_random(&random_state) % 2 == 0)) {
+                break;
+            }
+            if (next_random(&random_state) % 4 == 0) {
+                ok = ok && kgchess_push_packed_move(chess, moves[next_random(&random_state) % (uint64_t)moves_count]);
+                if (next_random(&random_state) % 2 == 0) {
+                    kgchess_get_state(chess); // the pushed position is checked before the pop half of the time
+                }
+                ok = ok && kgchess_pop_move(chess) && check_random_position(chess, hashes, ply, &end_reason);
+            }
+            ok = ok && kgchess_move_packed(chess, moves[next_random(&random_state) % (uint64_t)moves_count]);
+            hashes[ply + 1] = kgchess_get_hash(chess);
+        }
+        if (!ok) {
+            char fen[KGCHESS_MAX_FEN_LENGTH];
+            kgchess_get_fen(chess, fen, KGCHESS_MAX_FEN_LENGTH);
+            printf("random game %d, %s: state %d end reason %d winner %d FAILED\n", game, fen, kgchess_get_state(chess),
+                   kgchess_get_end_reason(chess), kgchess_get_winner(chess));
+        }
+    }
+    // every end has to come up, or the games don't test much
+    for (int i = KGCHESS_END_CHECKMATE; i <= KGCHESS_END_INSUFFICIENT_MATERIAL; i++) {
+        ok = ok && end_reasons_count[i] > 0;
+    }
+    printf("%-32s %d games, ends: %d checkmate %d stalemate %d repetition %d fifty moves %d material %s\n",
+           "random games", games_count, end_reasons_count[KGCHESS_END_CHECKMATE],
+           end_reasons_count[KGCHESS_END_STALEMATE], end_reasons_count[KGCHESS_END_REPETITION],
+           end_reasons_count[KGCHESS_END_FIFTY_MOVES], end_reasons_count[KGCHESS_END_INSUFFICIENT_MATERIAL],
+           ok ? "ok" : "FAILED");
+    kgchess_destroy(chess);
+    return ok;
+}
+
+// Compares state, end reason and winner with the expected ones, asking for the winner first half of the time.
+static bool check_random_position(kgchess_t *chess, const uint64_t *hashes, int ply, kgchess_end_reason_t *end_reason) {
+    kgchess_end_reason_t expected_reason = get_expected_end_reason(chess, hashes, ply);
+    kgchess_player_t expected_winner = KGCHESS_PLAYER_NONE;
+    if (expected_reason == KGCHESS_END_CHECKMATE) {
+        expected_winner = kgchess_get_enemy_player(kgchess_get_current_player(chess));
+    }
+    kgchess_player_t winner = KGCHESS_PLAYER_NONE;
+    if (ply % 2 == 0) {
+        winner = kgchess_get_winner(chess);
+    }
+    kgchess_state_t state = kgchess_get_state(chess);
+    if (ply % 2 != 0) {
+        winner = kgchess_get_winner(chess);
+    }
+    kgchess_state_t expected_state = expected_reason == KGCHESS_END_NONE ? KGCHESS_STATE_MOVE : KGCHESS_STATE_ENDED;
+    *end_reason = expected_reason;
+    return state == expected_state && kgchess_get_end_reason(chess) == expected_reason && winner == expected_winner;
+}
+
+// Worked out from legal moves, the position's pieces and the game's hashes, in the order the rules are checked in.
+static kgchess_end_reason_t get_expected_end_reason(kgchess_t *chess, const uint64_t *hashes, int ply) {
+    kgchess_move_t moves[KGCHESS_MAX_MOVES];
+    if (kgchess_get_all_moves(chess, moves, KGCHESS_MAX_MOVES) == 0) {
+        return kgchess_is_in_check(chess) ? KGCHESS_END_CHECKMATE : KGCHESS_END_STALEMATE;
+    }
+    int halfmove_clock = kgchess_get_halfmove_clock(chess);
+    if (halfmove_clock >= 100) {
+        return KGCHESS_END_FIFTY_MOVES;
+    }
+    int repetitions_count = 0;
+    for (int i = ply - halfmove_clock; i < ply; i++) {
+        repetitions_count += hashes[i] == hashes[ply];
+    }
+    if (repetitions_count >= 2) {
+        return KGCHESS_END_REPETITION;
+    }
+    if (is_material_insufficient(chess)) {
+        return KGCHESS_END_INSUFFICIENT_MATERIAL;
+    }
+    return KGCHESS_END_NONE;
+}
+
+// Bare kings, a single minor piece or only bishops on squares of one colour.
+static bool is_material_insufficient(kgchess_t *chess) {
+    if (kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_PAWN)
+        || kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_ROOK)
+        || kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_QUEEN)) {
+        return false;
+    }
+    int knights_count = kgchess_get_pieces_count(chess, KGCHESS_PLAYER_WHITE, KGCHESS_PIECE_KNIGHT)
+        + kgchess_get_pieces_count(chess, KGCHESS_PLAYER_BLACK, KGCHESS_PIECE_KNIGHT);
+    uint64_t bishops = kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_BISHOP);
+    int bishops_count = kgchess_get_pieces_count(chess, KGCHESS_PLAYER_WHITE, KGCHESS_PIECE_BISHOP)
+        + kgchess_get_pieces_count(chess, KGCHESS_PLAYER_BLACK, KGCHESS_PIECE_BISHOP);
+    if (knights_count + bishops_count <= 1) {
+        return true;
+    }
+    return knights_count == 0 && ((bishops & DARK_SQUARES) == 0 || (bishops & ~DARK_SQUARES) == 0);
+}
+
+// Moves are in coordinate notation separated by spaces, e.g. "e2e4 e7e5 g8f6". State is asked for after every
+// move, the way a game UI does, so draws are seen before later moves are made.
+static bool play_moves(kgchess_t *chess, const char *moves) {
+    const char *it = moves;
+    while (*it) {
+        if (*it == ' ') {
+            it++;
+            continue;
+        }
+        if (strlen(it) < 4) {
+            return false;
+        }
+        int from_x = it[0] - 'a', from_y = it[1] - '1', to_x = it[2] - 'a', to_y = it[3] - '1';
+        it += 4;
+        kgchess_move_t legal_moves[KGCHESS_MAX_MOVES];
+        int legal_moves_count = kgchess_get_all_moves(chess, legal_moves, KGCHESS_MAX_MOVES);
+        bool found = false;
+        for (int i = 0; i < legal_moves_count; i++) {
+            kgchess_move_t move = legal_moves[i];
+            if (move.from.x == from_x && move.from.y == from_y && move.to.x == to_x && move.to.y == to_y) {
+                kgchess_move(chess, move);
+                kgchess_get_state(chess);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// xorshift64*, a fixed seed makes failures reproducible
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dull;
+}
@@ -0,0 +1,104 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Probes Syzygy tablebases for a position and prints its result, DTZ and the moves keeping the best result.
+// usage: tb_probe <syzygy paths> [fen]     paths separated with ':' (';' on Windows)
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../kgchess.h"
+#include "../kgchess_tb.h"
+
+static const char *WDL_NAMES[] = { "loss", "blessed loss", "draw", "cursed win", "win" };
+
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out);
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: tb_probe <syzygy paths> [fen]\n");
+        return 1;
+    }
+    const char *fen = argc > 2 ? argv[2] : "8/8/8/4k3/8/8/3QK3/8 w - - 0 1";
+
+    kgchess_tb_t *tb = kgchess_tb_make(argv[1]);
+    if (!tb) {
+        fprintf(stderr, "Allocating tablebases failed.\n");
+        return 1;
+    }
+    printf("found %d tables, up to %d pieces\n", kgchess_tb_get_tables_count(tb), kgchess_tb_get_max_pieces(tb));
+
+    kgchess_t *chess = kgchess_make_from_fen(fen);
+    if (!chess) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        kgchess_tb_destroy(tb);
+        return 1;
+    }
+
+    kgchess_tb_wdl_t wdl = KGCHESS_TB_DRAW;
+    int dtz = 0;
+    if (!kgchess_tb_probe_wdl(tb, chess, &wdl)) {
+        printf("position can't be probed\n");
+        kgchess_destroy(chess);
+        kgchess_tb_destroy(tb);
+        return 1;
+    }
+    printf("wdl: %s\n", WDL_NAMES[wdl + 2]);
+    if (kgchess_tb_probe_dtz(tb, chess, &dtz)) {
+        printf("dtz: %d\n", dtz);
+    } else {
+        printf("dtz: missing table\n");
+    }
+
+    kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_all_packed_moves(chess, moves, KGCHESS_MAX_MOVES);
+    int kept_count = kgchess_tb_filter_packed_moves(tb, chess, moves, moves_count);
+    printf("best moves:");
+    for (int i = 0; i < kept_count; i++) {
+        kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+        kgchess_move_t move = kgchess_unpack_move(moves[i], &promotion);
+        char move_str[6];
+        move_to_string(move, promotion, move_str);
+        printf(" %s", move_str);
+    }
+    printf("\n");
+
+    kgchess_destroy(chess);
+    kgchess_tb_destroy(tb);
+    return 0;
+}
+
+static void move_to_string(kgchess_move_t move, kgchess_piece_type_t promotion, char *out) {
+    out[0] = 'a' + move.from.x;
+    out[1] = '1' + move.from.y;
+    out[2] = 'a' + move.to.x;
+    out[3] = '1' + move.to.y;
+    out[4] = '\0';
+    switch (promotion) {
+        case KGCHESS_PIECE_QUEEN: out[4] = 'q'; break;
+        case KGCHESS_PIECE_ROOK: out[4] = 'r'; break;
+        case KGCHESS_PIECE_BISHOP: out[4] = 'b'; break;
+        case KGCHESS_PIECE_KNIGHT: out[4] = 'n'; break;
+        default: break;
+    }
+    out[5] = '\0';
+}
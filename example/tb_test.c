@@ -0,0 +1,284 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+// Syzygy tablebase probing checks. Decoding is checked with tables built here, and if paths to the 3 and 4 piece
+// Syzygy files are given, positions with known results are probed in them.
+// usage: tb_test [syzygy paths]      paths separated with ':' (';' on Windows)
+
+// Private functions of the decoder are checked too, so it's compiled here instead of being linked.
+#include "../kgchess_tb.c"
+
+#define BLOCK_SIZE 64
+#define BLOCKS_COUNT 12
+#define SYMBOLS_COUNT 6
+#define MAX_VALUES (BLOCKS_COUNT * 160)
+
+typedef struct {
+    const char *fen;
+    kgchess_tb_wdl_t wdl;
+    int dtz;
+} reference_position_t;
+
+// Results from the point of view of the player to move, DTZ is in plies.
+static const reference_position_t REFERENCE_POSITIONS[] = {
+    // KQvK
+    { "k7/8/1K6/8/8/8/7Q/8 w - - 0 1", KGCHESS_TB_WIN, 1 },          // Qh8 mates
+    { "k6Q/8/1K6/8/8/8/8/8 b - - 0 1", KGCHESS_TB_LOSS, -1 },        // mated
+    { "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", KGCHESS_TB_DRAW, 0 },        // stalemate
+    { "8/8/8/8/8/8/2kQ4/5K2 b - - 0 1", KGCHESS_TB_DRAW, 0 },        // Kxd2
+    // KRvK
+    { "k7/8/1K6/8/8/8/8/7R w - - 0 1", KGCHESS_TB_WIN, 1 },          // Rh8 mates
+    { "k6R/8/1K6/8/8/8/8/8 b - - 0 1", KGCHESS_TB_LOSS, -1 },        // mated
+    { "8/8/8/8/8/8/2kR4/5K2 b - - 0 1", KGCHESS_TB_DRAW, 0 },        // Kxd2
+    // KPvK
+    { "8/4P3/8/8/8/8/8/K6k w - - 0 1", KGCHESS_TB_WIN, 1 },          // e8=Q
+    { "8/4P3/8/8/8/8/8/K6k b - - 0 1", KGCHESS_TB_LOSS, -2 },        // e8=Q after any move
+    { "8/8/8/8/8/8/3kP3/7K b - - 0 1", KGCHESS_TB_DRAW, 0 },         // Kxe2
+};
+
+static bool check_index_tables(void);
+static bool check_huffman_blocks(void);
+static bool check_single_value_tables(void);
+static bool check_reference_positions(const char *paths);
+static void write_file(const char *dir, const char *name, const uint8_t *data, size_t size);
+
+int main(int argc, char *argv[]) {
+    bool all_ok = check_index_tables();
+    all_ok = check_huffman_blocks() && all_ok;
+    all_ok = check_single_value_tables() && all_ok;
+    if (argc > 1) {
+        all_ok = check_reference_positions(argv[1]) && all_ok;
+    }
+    printf("%s\n", all_ok ? "all ok" : "FAILED");
+    return all_ok ? 0 : 1;
+}
+
+static bool check_index_tables(void) {
+    init_tables();
+    int max_kk = 0;
+    for (int i = 0; i < 10; i++) {
+        for (int sq = 0; sq < 64; sq++) {
+            if (map_kk[i][sq] > max_kk) {
+                max_kk = map_kk[i][sq];
+            }
+        }
+    }
+    // 462 placements of two kings not touching each other, with the white one in the a1-d1-d4 triangle
+    bool ok = max_kk == 461 && binomial[5][63] == 7028847;
+    printf("index tables: highest king pair %d, binomial(63, 5) %d %s\n", max_kk, binomial[5][63], ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// Blocks of random values compressed with a hand-built code: symbols 0-3 are values 0-3 with 3-bit codes 000-011,
+// symbol 4 is value 4 with code 10 and symbol 5 is the pair of symbols 1 and 4 with code 11.
+static bool check_huffman_blocks(void) {
+    static const int CODES[SYMBOLS_COUNT] = { 0, 1, 2, 3, 2, 3 };
+    static const int CODE_LENGTHS[SYMBOLS_COUNT] = { 3, 3, 3, 3, 2, 2 };
+    uint8_t lowest_symbols[4] = { 4, 0, 0, 0 }; // uint16 for code lengths 2 and 3
+    uint8_t btree[SYMBOLS_COUNT * 3];
+    for (int sym = 0; sym < SYMBOLS_COUNT; sym++) {
+        // leaves have 0xfff as the right symbol
+        btree[sym * 3] = (uint8_t)sym;
+        btree[sym * 3 + 1] = 0xf0;
+        btree[sym * 3 + 2] = 0xff;
+    }
+    btree[5 * 3] = 1;
+    btree[5 * 3 + 1] = 4 << 4;
+    btree[5 * 3 + 2] = 0;
+
+    static uint8_t data[BLOCKS_COUNT * BLOCK_SIZE];
+    uint8_t block_lengths[BLOCKS_COUNT * 2];
+    static int values[MAX_VALUES];
+    int values_count = 0;
+    memset(data, 0, sizeof(data));
+    srand(1);
+    for (int block = 0; block < BLOCKS_COUNT; block++) {
+        uint8_t *out = data + block * BLOCK_SIZE;
+        uint64_t bits = 0;
+        int bits_count = 0;
+        int block_start = values_count;
+        int symbols_in_block = 100 + rand() % 40;
+        for (int i = 0; i < symbols_in_block; i++) {
+            int sym = rand() % SYMBOLS_COUNT;
+            if (sym == 5) {
+                values[values_count++] = 1;
+                values[values_count++] = 4;
+            } else {
+                values[values_count++] = sym;
+            }
+            bits = (bits << CODE_LENGTHS[sym]) | (uint64_t)CODES[sym];
+            bits_count += CODE_LENGTHS[sym];
+            while (bits_count >= 8) {
+                *out++ = (uint8_t)(bits >> (bits_count - 8));
+                bits_count -= 8;
+            }
+        }
+        if (bits_count > 0) {
+            *out++ = (uint8_t)(bits << (8 - bits_count));
+        }
+        int block_length = values_count - block_start - 1;
+        block_lengths[block * 2] = (uint8_t)block_length;
+        block_lengths[block * 2 + 1] = (uint8_t)(block_length >> 8);
+    }
+
+    pairs_t d;
+    memset(&d, 0, sizeof(d));
+    d.min_code_length = 2;
+    d.max_code_length = 3;
+    d.lowest_symbols = lowest_symbols;
+    d.base64[0] = 2ULL << 62; // code 10
+    d.base64[1] = 0;          // code 000
+    d.btree = btree;
+    d.symbols_count = SYMBOLS_COUNT;
+    uint8_t symbol_sizes[SYMBOLS_COUNT] = { 0 };
+    uint8_t visited[SYMBOLS_COUNT] = { 0 };
+    d.symbol_sizes = symbol_sizes;
+    for (int sym = 0; sym < SYMBOLS_COUNT; sym++) {
+        if (!visited[sym]) {
+            symbol_sizes[sym] = set_symbol_size(&d, sym, visited);
+        }
+    }
+    d.block_size = BLOCK_SIZE;
+    d.data = data;
+    d.block_lengths = block_lengths;
+    d.blocks_count = BLOCKS_COUNT;
+    d.span = 64;
+
+    // Sparse entry k points at value k * span + span / 2.
+    uint8_t sparse_index[(MAX_VALUES / 64 + 1) * 6];
+    int sparse_count = (values_count + 63) / 64;
+    for (int k = 0; k < sparse_count; k++) {
+        int value_index = k * 64 + 32;
+        int block = 0;
+        int block_start = 0;
+        while (block_start + read_le16(block_lengths + block * 2) + 1 <= value_index) {
+            block_start += read_le16(block_lengths + block * 2) + 1;
+            block++;
+        }
+        uint8_t *entry = sparse_index + k * 6;
+        int offset = value_index - block_start;
+        entry[0] = (uint8_t)block;
+        entry[1] = entry[2] = entry[3] = 0;
+        entry[4] = (uint8_t)offset;
+        entry[5] = (uint8_t)(offset >> 8);
+    }
+    d.sparse_index = sparse_index;
+
+    int mismatches_count = 0;
+    for (int i = 0; i < values_count; i++) {
+        if (decompress_pairs(&d, (uint64_t)i) != values[i]) {
+            mismatches_count++;
+        }
+    }
+    bool ok = symbol_sizes[5] == 1 && mismatches_count == 0;
+    printf("huffman blocks: %d values, %d mismatches %s\n", values_count, mismatches_count, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// KQvK tables with a single value: always a win for white, 5 (stored in full moves, so 11 plies) to zeroing.
+static bool check_single_value_tables(void) {
+    static const uint8_t WDL_TABLE[64] = { 0x71, 0xe8, 0x23, 0x5d, 0x01, 0x00, 0x66, 0x55, 0xee, 0, 0x80, 4, 0x80, 0 };
+    static const uint8_t DTZ_TABLE[64] = { 0xd7, 0x66, 0x0c, 0xa5, 0x00, 0x00, 0x06, 0x05, 0x0e, 0, 0x80, 5 };
+    static const reference_position_t POSITIONS[] = {
+        { "8/8/8/3k4/8/8/3Q4/3K4 w - - 0 1", KGCHESS_TB_WIN, 11 },
+        { "8/8/8/3k4/8/8/3Q4/3K4 b - - 0 1", KGCHESS_TB_LOSS, -12 },
+        { "3k4/3q4/8/8/3K4/8/8/8 b - - 0 1", KGCHESS_TB_WIN, 11 }, // colors swapped
+        { "3k4/3q4/8/8/3K4/8/8/8 w - - 0 1", KGCHESS_TB_LOSS, -12 },
+    };
+    char dir[] = "/tmp/kgchess_tb_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("single value tables: creating a directory failed FAILED\n");
+        return false;
+    }
+    write_file(dir, "KQvK.rtbw", WDL_TABLE, sizeof(WDL_TABLE));
+    write_file(dir, "KQvK.rtbz", DTZ_TABLE, sizeof(DTZ_TABLE));
+    kgchess_tb_t *tb = kgchess_tb_make(dir);
+    bool all_ok = tb && kgchess_tb_get_tables_count(tb) == 1 && kgchess_tb_get_max_pieces(tb) == 3;
+    for (size_t i = 0; tb && i < sizeof(POSITIONS) / sizeof(POSITIONS[0]); i++) {
+        kgchess_t *chess = kgchess_make_from_fen(POSITIONS[i].fen);
+        kgchess_tb_wdl_t wdl = KGCHESS_TB_DRAW;
+        int dtz = 0;
+        bool ok = kgchess_tb_probe_wdl(tb, chess, &wdl) && kgchess_tb_probe_dtz(tb, chess, &dtz);
+        ok = ok && wdl == POSITIONS[i].wdl && dtz == POSITIONS[i].dtz;
+        all_ok = all_ok && ok;
+        kgchess_destroy(chess);
+    }
+    // a missing table and castling rights can't be probed
+    const char *unprobed_fens[] = { "8/8/8/8/8/8/3R4/3K1k2 w - - 0 1", "r3k3/8/8/8/8/8/3Q4/3K4 w q - 0 1" };
+    for (int i = 0; tb && i < 2; i++) {
+        kgchess_t *chess = kgchess_make_from_fen(unprobed_fens[i]);
+        kgchess_tb_wdl_t wdl = KGCHESS_TB_DRAW;
+        all_ok = all_ok && !kgchess_tb_probe_wdl(tb, chess, &wdl);
+        kgchess_destroy(chess);
+    }
+    kgchess_tb_destroy(tb);
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/KQvK.rtbw", dir);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/KQvK.rtbz", dir);
+    remove(path);
+    remove(dir);
+    printf("single value tables %s\n", all_ok ? "ok" : "FAILED");
+    return all_ok;
+}
+
+static bool check_reference_positions(const char *paths) {
+    kgchess_tb_t *tb = kgchess_tb_make(paths);
+    if (!tb || kgchess_tb_get_max_pieces(tb) < 3) {
+        printf("no tables found in %s FAILED\n", paths);
+        kgchess_tb_destroy(tb);
+        return false;
+    }
+    bool all_ok = true;
+    for (size_t i = 0; i < sizeof(REFERENCE_POSITIONS) / sizeof(REFERENCE_POSITIONS[0]); i++) {
+        const reference_position_t *position = &REFERENCE_POSITIONS[i];
+        kgchess_t *chess = kgchess_make_from_fen(position->fen);
+        kgchess_tb_wdl_t wdl = KGCHESS_TB_DRAW;
+        int dtz = 0;
+        bool probed = chess && kgchess_tb_probe_wdl(tb, chess, &wdl) && kgchess_tb_probe_dtz(tb, chess, &dtz);
+        bool ok = probed && wdl == position->wdl && dtz == position->dtz;
+        all_ok = all_ok && ok;
+        if (probed) {
+            printf("%-32s wdl %2d dtz %3d %s", position->fen, wdl, dtz, ok ? "ok" : "FAILED");
+        } else {
+            printf("%-32s can't be probed FAILED", position->fen);
+        }
+        if (probed && !ok) {
+            printf(" (expected wdl %d dtz %d)", position->wdl, position->dtz);
+        }
+        printf("\n");
+        kgchess_destroy(chess);
+    }
+    kgchess_tb_destroy(tb);
+    return all_ok;
+}
+
+static void write_file(const char *dir, const char *name, const uint8_t *data, size_t size) {
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return;
+    }
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+}
@@ -21,125 +21,664 @@
  */
 
 
+
 #include "kgchess.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> // SwitchToThread
+#else
+#include <sched.h>
+#endif
+
+#ifdef KGCHESS_USE_PEXT
+#include <immintrin.h>
+#endif
+
+#ifdef KGCHESS_USE_STATS
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
 
 #define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
 
+#define SQUARE(x, y) ((y) * 8 + (x))
+#define SQUARE_X(sq) ((sq) & 7)
+#define SQUARE_Y(sq) ((sq) >> 3)
+#define SQUARE_BIT(sq) (1ULL << (sq))
+
+#define SLIDER_ATTACKS_TABLE_SIZE (102400 + 5248)
+#define ATTACK_COUNT_BITS 5 // a square can be attacked by at most 16 pieces of one player
+#define HASH_HISTORY_SIZE 128 // power of two above the 100 plies after which the fifty-move rule ends the game
+#define FIFTY_MOVES_PLIES 100
+#define DARK_SQUARES 0xaa55aa55aa55aa55ULL
+
+#define PACKED_FLAG_CASTLING 2
+#define PACKED_FLAG_CAPTURE 4
+#define PACKED_FLAG_EN_PASSANT 5
+#define PACKED_FLAG_PROMOTION 8
+
+// Counting hot paths, compiled out unless KGCHESS_USE_STATS is defined.
+#ifdef KGCHESS_USE_STATS
+#define STATS_BEGIN(stat) uint64_t stats_start_##stat = read_cycles()
+#define STATS_END(stat) stats_add(stat, read_cycles() - stats_start_##stat)
+#define STATS_COUNT(stat) stats_add(stat, 0)
+#else
+#define STATS_BEGIN(stat)
+#define STATS_END(stat)
+#define STATS_COUNT(stat)
+#endif
+
+typedef enum {
+    DIRECTION_N = 0,
+    DIRECTION_S,
+    DIRECTION_W,
+    DIRECTION_E,
+    DIRECTION_NE,
+    DIRECTION_SW,
+    DIRECTION_NW,
+    DIRECTION_SE,
+} direction_t;
+
+typedef struct {
+    uint64_t mask;
+    uint64_t magic;
+    uint64_t *attacks;
+    int shift;
+} magic_t;
+
+typedef struct {
+    kgchess_move_t *items; // NULL when only counting moves
+    int count;
+    int capacity;
+    bool is_captures_only; // quiet moves other than promotions aren't generated
+} moves_list_t;
+
+// Legality of moves of one player, computed once per position instead of trying out every move.
 typedef struct {
-    kgchess_piece_type_t type;
     kgchess_player_t player;
-    int last_move_num;
-} kgchess_piece_internal_t;
+    int king_sq;          // -1 if player has no king
+    uint64_t checkers;
+    uint64_t check_mask;  // squares non-king moves have to land on to resolve a check
+    uint64_t pinned;
+} legality_t;
+
+typedef struct {
+    kgchess_move_t move;
+    kgchess_move_t last_move;
+    uint8_t moved_piece;    // same encoding as kgchess_t.squares
+    uint8_t captured_piece;
+    uint8_t current_player;
+    uint8_t state;
+    uint8_t winner;
+    bool is_end_checked;
+    uint8_t end_reason;
+    kgchess_pos_t promotion_pos;
+    int halfmove_clock;
+    int repetition_plies;
+    uint64_t unmoved_bb;
+    uint64_t hash;
+} undo_t;
+
+// Position parsed from FEN before it's applied, so an invalid FEN leaves kgchess_t untouched.
+typedef struct {
+    uint8_t squares[64];  // same encoding as kgchess_t.squares
+    kgchess_player_t current_player;
+    int castling_rights;  // same bits as get_castling_rights
+    int en_passant_sq;    // -1 if none
+    int halfmove_clock;
+    int fullmove_num;
+} fen_position_t;
 
 typedef struct kgchess {
     kgchess_player_t current_player;
-    kgchess_piece_internal_t pieces[8][8];
+    uint64_t type_bbs[7];   // indexed by kgchess_piece_type_t, bit index is SQUARE(x, y)
+    uint64_t player_bbs[3]; // indexed by kgchess_player_t
+    uint64_t unmoved_bb;    // pieces that haven't moved since the start of the game
+    uint8_t squares[64];    // piece type | (player << 3)
     int move_num;
     kgchess_move_t last_move;
     kgchess_state_t state;
     kgchess_pos_t promotion_pos;
     kgchess_player_t winner;
+    bool is_end_checked;    // false until state and winner are checked for the end of the game after a move
+    kgchess_end_reason_t end_reason;
+    int halfmove_clock;
+    int repetition_plies;   // how far back positions can repeat: plies since a capture, pawn move, null move or set up
+    uint64_t hash;
+    uint64_t attack_counts[3][ATTACK_COUNT_BITS]; // per player, bit i of the count of attackers of every square
+    int eval_mg;            // kgchess_evaluate totals, white's minus black's
+    int eval_eg;
+    int eval_phase;
+    int eval_generation;    // of weights the totals were computed with
+    // History is kept in memory given with kgchess_set_history, so boards stay small and cheap to copy.
+    uint64_t *hash_history; // hash after every ply, indexed by move_num % HASH_HISTORY_SIZE, NULL without history
+    undo_t *undo_stack;     // pushed moves, right after hash_history
+    int undo_count;
+    int undo_capacity;
 } kgchess_t;
 
 static kgchess_pos_t KGCHESS_POS_INVALID = (kgchess_pos_t){ -1, -1 };
 
+static const char FEN_PIECE_CHARS[3][7] = {
+    [KGCHESS_PLAYER_WHITE] = { '\0', 'K', 'Q', 'B', 'N', 'R', 'P' },
+    [KGCHESS_PLAYER_BLACK] = { '\0', 'k', 'q', 'b', 'n', 'r', 'p' },
+};
+
+// Promotion pieces in the order of packed move flags, and in the order packed move lists expand them.
+static const kgchess_piece_type_t PACKED_PROMOTION_PIECES[4] = {
+    KGCHESS_PIECE_KNIGHT, KGCHESS_PIECE_BISHOP, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_QUEEN
+};
+static const kgchess_piece_type_t PROMOTION_PIECES[4] = {
+    KGCHESS_PIECE_QUEEN, KGCHESS_PIECE_KNIGHT, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_BISHOP
+};
+
+// Piece values used by kgchess_see, the king's only matters when it's the last capturer.
+static const int SEE_VALUES[7] = {
+    [KGCHESS_PIECE_NONE] = 0,
+    [KGCHESS_PIECE_KING] = 20000,
+    [KGCHESS_PIECE_QUEEN] = 900,
+    [KGCHESS_PIECE_BISHOP] = 330,
+    [KGCHESS_PIECE_KNIGHT] = 320,
+    [KGCHESS_PIECE_ROOK] = 500,
+    [KGCHESS_PIECE_PAWN] = 100,
+};
+
+// Order in which kgchess_see captures with pieces, least valuable first.
+static const kgchess_piece_type_t SEE_CAPTURE_ORDER[6] = {
+    KGCHESS_PIECE_PAWN, KGCHESS_PIECE_KNIGHT, KGCHESS_PIECE_BISHOP, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_QUEEN, KGCHESS_PIECE_KING
+};
+
+static const int DIRECTION_DX[8] = { 0, 0, -1, +1, +1, -1, -1, +1 };
+static const int DIRECTION_DY[8] = { +1, -1, 0, 0, +1, -1, +1, -1 };
+static const bool DIRECTION_IS_ASCENDING[8] = { true, false, false, true, true, false, true, false };
+
+static const direction_t ROOK_DIRECTIONS[4] = { DIRECTION_N, DIRECTION_S, DIRECTION_W, DIRECTION_E };
+static const direction_t BISHOP_DIRECTIONS[4] = { DIRECTION_NE, DIRECTION_SW, DIRECTION_NW, DIRECTION_SE };
+
+static const int KNIGHT_DX[8] = { +2, +2, -2, -2, +1, +1, -1, -1 };
+static const int KNIGHT_DY[8] = { +1, -1, +1, -1, +2, -2, +2, -2 };
+
+// PeSTO weights by Ronald Friederich, tuned on quiet positions.
+static const kgchess_eval_weights_t DEFAULT_EVAL_WEIGHTS = {
+    .mg_values = { 0, 0, 1025, 365, 337, 477, 82 },
+    .eg_values = { 0, 0, 936, 297, 281, 512, 94 },
+    .mg_tables = {
+        [KGCHESS_PIECE_KING] = {
+            -65,  23,  16, -15, -56, -34,   2,  13,
+             29,  -1, -20,  -7,  -8,  -4, -38, -29,
+             -9,  24,   2, -16, -20,   6,  22, -22,
+            -17, -20, -12, -27, -30, -25, -14, -36,
+            -49,  -1, -27, -39, -46, -44, -33, -51,
+            -14, -14, -22, -46, -44, -30, -15, -27,
+              1,   7,  -8, -64, -43, -16,   9,   8,
+            -15,  36,  12, -54,   8, -28,  24,  14,
+        },
+        [KGCHESS_PIECE_QUEEN] = {
+            -28,   0,  29,  12,  59,  44,  43,  45,
+            -24, -39,  -5,   1, -16,  57,  28,  54,
+            -13, -17,   7,   8,  29,  56,  47,  57,
+            -27, -27, -16, -16,  -1,  17,  -2,   1,
+             -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+            -14,   2, -11,  -2,  -5,   2,  14,   5,
+            -35,  -8,  11,   2,   8,  15,  -3,   1,
+             -1, -18,  -9,  10, -15, -25, -31, -50,
+        },
+        [KGCHESS_PIECE_BISHOP] = {
+            -29,   4, -82, -37, -25, -42,   7,  -8,
+            -26,  16, -18, -13,  30,  59,  18, -47,
+            -16,  37,  43,  40,  35,  50,  37,  -2,
+             -4,   5,  19,  50,  37,  37,   7,  -2,
+             -6,  13,  13,  26,  34,  12,  10,   4,
+              0,  15,  15,  15,  14,  27,  18,  10,
+              4,  15,  16,   0,   7,  21,  33,   1,
+            -33,  -3, -14, -21, -13, -12, -39, -21,
+        },
+        [KGCHESS_PIECE_KNIGHT] = {
+            -167, -89, -34, -49,  61, -97, -15, -107,
+             -73, -41,  72,  36,  23,  62,   7,  -17,
+             -47,  60,  37,  65,  84, 129,  73,   44,
+              -9,  17,  19,  53,  37,  69,  18,   22,
+             -13,   4,  16,  13,  28,  19,  21,   -8,
+             -23,  -9,  12,  10,  19,  17,  25,  -16,
+             -29, -53, -12,  -3,  -1,  18, -14,  -19,
+            -105, -21, -58, -33, -17, -28, -19,  -23,
+        },
+        [KGCHESS_PIECE_ROOK] = {
+             32,  42,  32,  51,  63,   9,  31,  43,
+             27,  32,  58,  62,  80,  67,  26,  44,
+             -5,  19,  26,  36,  17,  45,  61,  16,
+            -24, -11,   7,  26,  24,  35,  -8, -20,
+            -36, -26, -12,  -1,   9,  -7,   6, -23,
+            -45, -25, -16, -17,   3,   0,  -5, -33,
+            -44, -16, -20,  -9,  -1,  11,  -6, -71,
+            -19, -13,   1,  17,  16,   7, -37, -26,
+        },
+        [KGCHESS_PIECE_PAWN] = {
+              0,   0,   0,   0,   0,   0,   0,   0,
+             98, 134,  61,  95,  68, 126,  34, -11,
+             -6,   7,  26,  31,  65,  56,  25, -20,
+            -14,  13,   6,  21,  23,  12,  17, -23,
+            -27,  -2,  -5,  12,  17,   6,  10, -25,
+            -26,  -4,  -4, -10,   3,   3,  33, -12,
+            -35,  -1, -20, -23, -15,  24,  38, -22,
+              0,   0,   0,   0,   0,   0,   0,   0,
+        },
+    },
+    .eg_tables = {
+        [KGCHESS_PIECE_KING] = {
+            -74, -35, -18, -18, -11,  15,   4, -17,
+            -12,  17,  14,  17,  17,  38,  23,  11,
+             10,  17,  23,  15,  20,  45,  44,  13,
+             -8,  22,  24,  27,  26,  33,  26,   3,
+            -18,  -4,  21,  24,  27,  23,   9, -11,
+            -19,  -3,  11,  21,  23,  16,   7,  -9,
+            -27, -11,   4,  13,  14,   4,  -5, -17,
+            -53, -34, -21, -11, -28, -14, -24, -43,
+        },
+        [KGCHESS_PIECE_QUEEN] = {
+             -9,  22,  22,  27,  27,  19,  10,  20,
+            -17,  20,  32,  41,  58,  25,  30,   0,
+            -20,   6,   9,  49,  47,  35,  19,   9,
+              3,  22,  24,  45,  57,  40,  57,  36,
+            -18,  28,  19,  47,  31,  34,  39,  23,
+            -16, -27,  15,   6,   9,  17,  10,   5,
+            -22, -23, -30, -16, -16, -23, -36, -32,
+            -33, -28, -22, -43,  -5, -32, -20, -41,
+        },
+        [KGCHESS_PIECE_BISHOP] = {
+            -14, -21, -11,  -8,  -7,  -9, -17, -24,
+             -8,  -4,   7, -12,  -3, -13,  -4, -14,
+              2,  -8,   0,  -1,  -2,   6,   0,   4,
+             -3,   9,  12,   9,  14,  10,   3,   2,
+             -6,   3,  13,  19,   7,  10,  -3,  -9,
+            -12,  -3,   8,  10,  13,   3,  -7, -15,
+            -14, -18,  -7,  -1,   4,  -9, -15, -27,
+            -23,  -9, -23,  -5,  -9, -16,  -5, -17,
+        },
+        [KGCHESS_PIECE_KNIGHT] = {
+            -58, -38, -13, -28, -31, -27, -63, -99,
+            -25,  -8, -25,  -2,  -9, -25, -24, -52,
+            -24, -20,  10,   9,  -1,  -9, -19, -41,
+            -17,   3,  22,  22,  22,  11,   8, -18,
+            -18,  -6,  16,  25,  16,  17,   4, -18,
+            -23,  -3,  -1,  15,  10,  -3, -20, -22,
+            -42, -20, -10,  -5,  -2, -20, -23, -44,
+            -29, -51, -23, -15, -22, -18, -50, -64,
+        },
+        [KGCHESS_PIECE_ROOK] = {
+             13,  10,  18,  15,  12,  12,   8,   5,
+             11,  13,  13,  11,  -3,   3,   8,   3,
+              7,   7,   7,   5,   4,  -3,  -5,  -3,
+              4,   3,  13,   1,   2,   1,  -1,   2,
+              3,   5,   8,   4,  -5,  -6,  -8, -11,
+             -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+             -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+             -9,   2,   3,  -1,  -5, -13,   4, -20,
+        },
+        [KGCHESS_PIECE_PAWN] = {
+              0,   0,   0,   0,   0,   0,   0,   0,
+            178, 173, 158, 134, 147, 132, 165, 187,
+             94, 100,  85,  67,  56,  53,  82,  84,
+             32,  24,  13,   5,  -2,   4,  17,  17,
+             13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+              4,   7,  -6,   1,   0,  -5,  -1,  -8,
+             13,   8,   8,  10,  13,   0,   2,  -7,
+              0,   0,   0,   0,   0,   0,   0,   0,
+        },
+    },
+    .phase_weights = { 0, 0, 4, 1, 1, 2, 0 },
+};
+
+static const uint64_t ROOK_MAGIC_NUMBERS[64] = {
+    0x1080004008801020ULL, 0x0840092002c03000ULL, 0x1900200010400900ULL, 0x0880100008000480ULL,
+    0x4200100420080200ULL, 0x8100020100080400ULL, 0x0200040110886200ULL, 0x0200008040220411ULL,
+    0x0404800084400220ULL, 0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000a001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL, 0x0442000102105084ULL,
+    0x9080010020804100ULL, 0x0040404000201009ULL, 0x0000808010002009ULL, 0x2200090021d00100ULL,
+    0x0008008008040080ULL, 0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000a0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL, 0x1000100080080080ULL,
+    0x0442000a00049020ULL, 0x2100040080020080ULL, 0x0800120400900148ULL, 0x0010040a00128541ULL,
+    0x2800804000800030ULL, 0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xc100020080800400ULL, 0x0002000802000401ULL, 0x0182085882000401ULL,
+    0x0220204000808000ULL, 0x2860100040024022ULL, 0x0001002004110040ULL, 0x99101042000a0020ULL,
+    0x0004080004008080ULL, 0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040a00300ULL, 0x0801100280080480ULL,
+    0x0242009008200600ULL, 0x1002000489500200ULL, 0x0040800200010080ULL, 0x0091800041000080ULL,
+    0x0000209300488001ULL, 0x04c1002414824001ULL, 0x020020000b001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084c0007ULL, 0x0888221800813004ULL, 0x4000002840840112ULL,
+};
+
+static const uint64_t BISHOP_MAGIC_NUMBERS[64] = {
+    0xa010041108003100ULL, 0x006082020a002900ULL, 0x6810010619200000ULL, 0x08281a0520000408ULL,
+    0x0001104001000400ULL, 0x0018901008048400ULL, 0x00040a0210245280ULL, 0x000200210808a402ULL,
+    0x9140048410821200ULL, 0x0800091010820041ULL, 0x20504804832202c0ULL, 0x0100091401081000ULL,
+    0x8021011140000012ULL, 0x0810020804450400ULL, 0x208b0542109008a2ULL, 0x0080084a08040204ULL,
+    0x0040e2a80811244cULL, 0x2505022008008108ULL, 0x0430220100420040ULL, 0x010a040420220040ULL,
+    0x1105000290400000ULL, 0x0093001200822120ULL, 0x4000a62048043004ULL, 0x280120048a015004ULL,
+    0x006090002a020814ULL, 0x44042000240800d0ULL, 0x01102800040a4400ULL, 0x1004080080220040ULL,
+    0x0001001011004024ULL, 0x0010044000805040ULL, 0x0914041200820100ULL, 0x0004821012821480ULL,
+    0x0024040500c05021ULL, 0x0088611002080200ULL, 0x0116080a00040020ULL, 0x4000020080080080ULL,
+    0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL, 0x8081110600002e00ULL,
+    0x2842101105000801ULL, 0x1100809008001025ULL, 0x00020202221c0400ULL, 0x0422014022009020ULL,
+    0x0210046102100c00ULL, 0xc004008082029102ULL, 0x00aa461801101200ULL, 0x0404080080201108ULL,
+    0x020542108c205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL, 0x0400200042021100ULL,
+    0x00004204850400c0ULL, 0x0200100410a42102ULL, 0x1040020801210102ULL, 0x0805040410420000ULL,
+    0x2884804130100200ULL, 0x800c262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+    0x0104000012a02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL, 0x0402020801010201ULL,
+};
+
+static kgchess_malloc_fn malloc_fn = malloc;
+static kgchess_free_fn free_fn = free;
+
+static const char *STAT_NAMES[] = {
+    [KGCHESS_STAT_GET_MOVES] = "get_moves",
+    [KGCHESS_STAT_ILLEGAL_MOVES] = "illegal_moves",
+    [KGCHESS_STAT_APPLY_MOVE] = "apply_move",
+    [KGCHESS_STAT_IS_IN_CHECK] = "is_in_check",
+    [KGCHESS_STAT_IS_SQUARE_ATTACKED] = "is_square_attacked",
+    [KGCHESS_STAT_GAME_END] = "game_end",
+};
+
+#ifdef KGCHESS_USE_STATS
+// Counters of one thread. Blocks are only ever added to the list (and kept after their threads exit), so they
+// can be summed up at any time without locking. Only the owning thread writes to a block.
+typedef struct stats_block {
+    _Atomic uint64_t calls[KGCHESS_STAT_COUNT];
+    _Atomic uint64_t cycles[KGCHESS_STAT_COUNT];
+    struct stats_block *next;
+} stats_block_t;
+
+static _Atomic(stats_block_t*) stats_blocks = NULL;
+static _Thread_local stats_block_t *thread_stats_block = NULL;
+#endif
+
+// Tables are filled by the first thread that needs them, others wait until they're ready.
+enum { TABLES_EMPTY, TABLES_FILLING, TABLES_READY };
+static atomic_int tables_state = TABLES_EMPTY;
+static atomic_flag eval_weights_lock = ATOMIC_FLAG_INIT; // held while eval weights are copied or replaced
+static kgchess_t start_position; // copied by kgchess_init_at
+static uint64_t ray_masks[8][64];
+static uint64_t between_masks[64][64];
+static uint64_t line_masks[64][64];
+static uint64_t knight_attacks[64];
+static uint64_t king_attacks[64];
+static uint64_t pawn_attacks[3][64]; // indexed by kgchess_player_t
+static magic_t rook_magics[64];
+static magic_t bishop_magics[64];
+static uint64_t slider_attacks[SLIDER_ATTACKS_TABLE_SIZE];
+static uint64_t zobrist_pieces[3][7][64]; // indexed by player, piece type and square
+static uint64_t zobrist_castling[16];
+static uint64_t zobrist_en_passant[8];
+static uint64_t zobrist_black_to_move;
+static kgchess_eval_weights_t eval_weights;
+static int eval_scores[2][3][7][64]; // middlegame and endgame value plus table by player, piece type and square, negative for black
+static int eval_max_phase;           // phase of the starting position
+static int eval_generation;          // changed with the weights, boards with totals of older ones compute them again
+
 //-----------------------------------------------------------------------------
 // Private declarations
 //-----------------------------------------------------------------------------
 
 static kgchess_move_t move_make(int from_x, int from_y, int to_x, int to_y, bool is_attack, bool is_castling, bool is_en_passant);
-static void add_move(kgchess_moves_array_t *arr, kgchess_move_t move);
-static void add_move_if_legal(const kgchess_t *chess, kgchess_moves_array_t *arr, kgchess_move_t move, bool is_attacks_check);
+static moves_list_t moves_list_make(kgchess_move_t *items, int capacity);
+static void add_move(moves_list_t *list, kgchess_move_t move);
+static undo_t* push_undo(kgchess_t *chess, kgchess_move_t move);
+static void record_hash(kgchess_t *chess);
+static void copy_hash_history(kgchess_t *dst, const kgchess_t *src);
+static int pack_moves(const kgchess_t *chess, const kgchess_move_t *moves, int count, kgchess_packed_move_t *out, int capacity);
+static legality_t get_legality(const kgchess_t *chess, kgchess_player_t player);
+static void add_move_if_legal(const kgchess_t *chess, const legality_t *legality, moves_list_t *list, kgchess_move_t move);
+static bool is_move_legal(const kgchess_t *chess, const legality_t *legality, kgchess_move_t move);
+static bool is_king_move_legal(const kgchess_t *chess, const legality_t *legality, kgchess_move_t move);
 static void apply_move(kgchess_t *chess, kgchess_move_t move, bool update_state);
-static bool is_position_empty(const kgchess_t *chess, int x, int y);
-static bool is_player_at_position(const kgchess_t *chess, kgchess_player_t player, int x, int y);
-static kgchess_piece_internal_t piece_make(kgchess_piece_type_t type, kgchess_player_t player);
-static kgchess_piece_internal_t get_piece_at(const kgchess_t *chess, int x, int y);
-static void set_piece_at(kgchess_t *chess, kgchess_piece_internal_t piece, int x, int y);
+static uint64_t get_move_squares(kgchess_move_t move);
+static kgchess_piece_t piece_make(kgchess_piece_type_t type, kgchess_player_t player);
+static bool is_pos_valid(kgchess_pos_t pos);
+static kgchess_piece_t get_piece_at(const kgchess_t *chess, int x, int y);
+static kgchess_piece_t get_square_piece(const kgchess_t *chess, int sq);
+static void set_piece_at(kgchess_t *chess, kgchess_piece_t piece, int x, int y);
+static uint64_t get_occupied(const kgchess_t *chess);
 static bool is_castling_possible(const kgchess_t *chess, int x, int y, int rook_x);
+static int get_castling_rights(const kgchess_t *chess);
+static int get_en_passant_file(const kgchess_t *chess);
+static uint64_t get_state_hash(const kgchess_t *chess);
+static uint64_t compute_hash(const kgchess_t *chess);
+static void compute_eval(kgchess_t *chess);
+static void sum_eval(const kgchess_t *chess, int *mg, int *eg, int *phase);
 static int get_en_passant(const kgchess_t *chess, int x, int y, kgchess_piece_t piece);
+static bool is_square_attacked(const kgchess_t *chess, int sq, kgchess_player_t player);
 static bool is_in_check(const kgchess_t *chess, kgchess_player_t player);
-static void check_checkmate(kgchess_t *chess);
-
-static kgchess_piece_t convert_piece(kgchess_piece_internal_t piece);
-
-static kgchess_moves_array_t get_moves(const kgchess_t *chess, int x, int y, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_king_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_queen_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_bishop_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_knight_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_rook_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static kgchess_moves_array_t get_pawn_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check);
-static void add_move_range(const kgchess_t *chess, kgchess_moves_array_t *moves, int x, int y, kgchess_piece_t piece,
-                            int dx, int dy, int end, bool add_potential_attacks, bool is_attacks_check);
+static int get_least_valuable_attacker(const kgchess_t *chess, uint64_t attackers, kgchess_piece_type_t *out_type);
+static bool parse_fen(const char *fen, fen_position_t *position);
+static const char* parse_fen_number(const char *it, int *out);
+static int write_fen_number(char *out, int value);
+static uint8_t get_fen_piece_square(char c);
+static void set_position(kgchess_t *chess, const fen_position_t *position);
+static int get_double_push_sq(const kgchess_t *chess);
+static void update_game_end(kgchess_t *chess);
+static kgchess_end_reason_t get_draw_reason(const kgchess_t *chess, int repetitions_count);
+static bool is_draw_by_rules(kgchess_end_reason_t end_reason);
+static int get_repetitions_count(const kgchess_t *chess, int max_count);
+static bool is_material_insufficient(const kgchess_t *chess);
+static bool has_legal_moves(const kgchess_t *chess);
+
+static void get_moves(const kgchess_t *chess, const legality_t *legality, int sq, moves_list_t *moves);
+static void get_player_moves(const kgchess_t *chess, kgchess_player_t player, moves_list_t *moves);
+static void get_king_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void get_queen_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void get_bishop_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void get_knight_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void get_rook_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void get_pawn_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves);
+static void add_direction_moves(const kgchess_t *chess, const legality_t *legality, moves_list_t *moves, int sq,
+                                kgchess_piece_t piece, uint64_t attacks, direction_t direction);
+
+static void init_tables(void);
+static void init_start_position(kgchess_t *chess);
+static void init_zobrist(void);
+static void init_eval(const kgchess_eval_weights_t *weights);
+static void lock_eval_weights(void);
+static void unlock_eval_weights(void);
+static void yield_thread(void);
+static uint64_t splitmix64(uint64_t *state);
+static void init_magics(magic_t *magics, const uint64_t *magic_numbers, const direction_t *directions, uint64_t **table);
+static uint64_t get_ray_attacks(int sq, uint64_t occupied, const direction_t *directions, int directions_count);
+static unsigned get_magic_index(const magic_t *magic, uint64_t occupied);
+static uint64_t get_rook_attacks(int sq, uint64_t occupied);
+static uint64_t get_bishop_attacks(int sq, uint64_t occupied);
+static uint64_t get_attackers(const kgchess_t *chess, int sq, uint64_t occupied);
+static uint64_t get_piece_attacks(const kgchess_t *chess, int sq, uint64_t occupied);
+static void compute_attacks(kgchess_t *chess);
+static uint64_t begin_attacks_update(kgchess_t *chess, uint64_t changed);
+static void end_attacks_update(kgchess_t *chess, uint64_t changed, uint64_t sources);
+static uint64_t get_attack_sources(const kgchess_t *chess, uint64_t changed);
+static void add_attacks(kgchess_t *chess, kgchess_player_t player, uint64_t attacks);
+static void remove_attacks(kgchess_t *chess, kgchess_player_t player, uint64_t attacks);
+static uint64_t get_attacked(const kgchess_t *chess, kgchess_player_t player);
+
+static int bb_count(uint64_t bb);
+static int bb_lsb(uint64_t bb);
+static int bb_msb(uint64_t bb);
+static int bb_pop_lsb(uint64_t *bb);
+static int bb_pop_msb(uint64_t *bb);
+
+#ifdef KGCHESS_USE_STATS
+static void stats_add(kgchess_stat_t stat, uint64_t cycles);
+static stats_block_t* make_thread_stats_block(void);
+static uint64_t read_cycles(void);
+#endif
 
 //-----------------------------------------------------------------------------
 // Public definitions
 //-----------------------------------------------------------------------------
 
-kgchess_t* kgchess_make() {
-    kgchess_t *chess = malloc(sizeof(kgchess_t));
-    memset(chess, 0, sizeof(kgchess_t));
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_WHITE), 0, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_WHITE), 1, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_WHITE), 2, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_QUEEN,  KGCHESS_PLAYER_WHITE), 3, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KING,   KGCHESS_PLAYER_WHITE), 4, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_WHITE), 5, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_WHITE), 6, 0);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_WHITE), 7, 0);
-
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 0, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 1, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 2, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 3, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 4, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 5, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 6, 1);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 7, 1);
+size_t kgchess_sizeof() {
+    return sizeof(kgchess_t);
+}
 
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_BLACK), 0, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_BLACK), 1, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_BLACK), 2, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_QUEEN,  KGCHESS_PLAYER_BLACK), 3, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KING,   KGCHESS_PLAYER_BLACK), 4, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_BLACK), 5, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_BLACK), 6, 7);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_BLACK), 7, 7);
+void kgchess_set_allocation_functions(kgchess_malloc_fn malloc_fun, kgchess_free_fn free_fun) {
+    malloc_fn = malloc_fun ? malloc_fun : malloc;
+    free_fn = free_fun ? free_fun : free;
+}
 
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 0, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 1, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 2, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 3, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 4, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 5, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 6, 6);
-    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 7, 6);
+size_t kgchess_history_sizeof(int pushed_moves_capacity) {
+    return HASH_HISTORY_SIZE * sizeof(uint64_t) + (size_t)pushed_moves_capacity * sizeof(undo_t);
+}
 
-    chess->current_player = KGCHESS_PLAYER_WHITE;
-    chess->move_num = 0;
-    chess->state = KGCHESS_STATE_MOVE;
-    chess->promotion_pos = KGCHESS_POS_INVALID;
-    chess->winner = KGCHESS_PLAYER_NONE;
+// History is allocated together with the board.
+kgchess_t* kgchess_make() {
+    kgchess_t *chess = malloc_fn(sizeof(kgchess_t) + kgchess_history_sizeof(KGCHESS_MAX_PUSHED_MOVES));
+    if (!chess) {
+        return NULL;
+    }
+    kgchess_init_at(chess);
+    kgchess_set_history(chess, chess + 1, KGCHESS_MAX_PUSHED_MOVES);
+    return chess;
+}
 
+kgchess_t* kgchess_init_at(void *mem) {
+    init_tables();
+    kgchess_t *chess = mem;
+    memcpy(chess, &start_position, sizeof(kgchess_t));
     return chess;
 }
 
+void kgchess_set_history(kgchess_t *chess, void *mem, int pushed_moves_capacity) {
+    kgchess_t old_history = *chess;
+    chess->hash_history = mem;
+    chess->undo_stack = mem ? (undo_t*)(chess->hash_history + HASH_HISTORY_SIZE) : NULL;
+    chess->undo_count = 0;
+    chess->undo_capacity = mem ? pushed_moves_capacity : 0;
+    copy_hash_history(chess, &old_history);
+}
+
+void kgchess_copy_to(kgchess_t *dst, const kgchess_t *src) {
+    if (dst == src) {
+        return;
+    }
+    uint64_t *hash_history = dst->hash_history;
+    undo_t *undo_stack = dst->undo_stack;
+    int undo_capacity = dst->undo_capacity;
+    memcpy(dst, src, sizeof(kgchess_t));
+    dst->hash_history = hash_history;
+    dst->undo_stack = undo_stack;
+    dst->undo_count = 0;
+    dst->undo_capacity = undo_capacity;
+    copy_hash_history(dst, src);
+}
+
 kgchess_t* kgchess_make_copy(const kgchess_t *chess) {
     kgchess_t *res = kgchess_make();
-    memcpy(res, chess, sizeof(kgchess_t));
+    if (!res) {
+        return NULL;
+    }
+    kgchess_copy_to(res, chess);
     return res;
 }
 
+kgchess_t* kgchess_make_from_fen(const char *fen) {
+    fen_position_t position;
+    if (!parse_fen(fen, &position)) {
+        return NULL;
+    }
+    kgchess_t *chess = kgchess_make();
+    if (!chess) {
+        return NULL;
+    }
+    set_position(chess, &position);
+    return chess;
+}
+
+bool kgchess_set_fen(kgchess_t *chess, const char *fen) {
+    fen_position_t position;
+    if (!parse_fen(fen, &position)) {
+        return false;
+    }
+    set_position(chess, &position);
+    return true;
+}
+
+int kgchess_get_fen(const kgchess_t *chess, char *out, int capacity) {
+    char buf[KGCHESS_MAX_FEN_LENGTH];
+    int len = 0;
+    for (int y = 7; y >= 0; y--) {
+        int empty_count = 0;
+        for (int x = 0; x < 8; x++) {
+            uint8_t square = chess->squares[SQUARE(x, y)];
+            if (square == 0) {
+                empty_count++;
+                continue;
+            }
+            if (empty_count > 0) {
+                buf[len++] = (char)('0' + empty_count);
+                empty_count = 0;
+            }
+            buf[len++] = FEN_PIECE_CHARS[square >> 3][square & 7];
+        }
+        if (empty_count > 0) {
+            buf[len++] = (char)('0' + empty_count);
+        }
+        if (y > 0) {
+            buf[len++] = '/';
+        }
+    }
+
+    buf[len++] = ' ';
+    buf[len++] = chess->current_player == KGCHESS_PLAYER_BLACK ? 'b' : 'w';
+
+    buf[len++] = ' ';
+    int castling_rights = get_castling_rights(chess);
+    if (castling_rights == 0) {
+        buf[len++] = '-';
+    }
+    const char castling_chars[] = { 'K', 'Q', 'k', 'q' };
+    for (int i = 0; i < 4; i++) {
+        if (castling_rights & (1 << i)) {
+            buf[len++] = castling_chars[i];
+        }
+    }
+
+    buf[len++] = ' ';
+    int en_passant_sq = get_double_push_sq(chess);
+    if (en_passant_sq == -1) {
+        buf[len++] = '-';
+    } else {
+        buf[len++] = (char)('a' + SQUARE_X(en_passant_sq));
+        buf[len++] = (char)('1' + SQUARE_Y(en_passant_sq));
+    }
+
+    buf[len++] = ' ';
+    len += write_fen_number(buf + len, chess->halfmove_clock);
+    buf[len++] = ' ';
+    len += write_fen_number(buf + len, chess->move_num / 2 + 1);
+
+    if (len >= capacity) {
+        return 0;
+    }
+    memcpy(out, buf, len);
+    out[len] = '\0';
+    return len;
+}
+
 void kgchess_destroy(kgchess_t *chess) {
-    free(chess);
+    free_fn(chess);
 }
 
 kgchess_piece_t kgchess_get_piece_at(const kgchess_t *chess, int x, int y) {
-    return convert_piece(get_piece_at(chess, x, y));
+    return get_piece_at(chess, x, y);
 }
 
 kgchess_moves_array_t kgchess_moves_array_make_empty() {
@@ -149,7 +688,128 @@ kgchess_moves_array_t kgchess_moves_array_make_empty() {
 }
 
 kgchess_moves_array_t kgchess_get_moves(const kgchess_t *chess, int x, int y) {
-    return get_moves(chess, x, y, false, false);
+    kgchess_moves_array_t arr;
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) {
+        arr.count = 0;
+        return arr;
+    }
+    int sq = SQUARE(x, y);
+    legality_t legality = get_legality(chess, get_square_piece(chess, sq).player);
+    moves_list_t list = moves_list_make(arr.items, ARRAY_LENGTH(arr.items));
+    get_moves(chess, &legality, sq, &list);
+    arr.count = list.count;
+    return arr;
+}
+
+int kgchess_get_all_moves(const kgchess_t *chess, kgchess_move_t *out, int capacity) {
+    moves_list_t list = moves_list_make(out, capacity);
+    get_player_moves(chess, chess->current_player, &list);
+    return list.count;
+}
+
+int kgchess_get_moves_to(const kgchess_t *chess, kgchess_piece_type_t type, int x, int y, kgchess_move_t *out, int capacity) {
+    if (x < 0 || x >= 8 || y < 0 || y >= 8 || type < KGCHESS_PIECE_KING || type > KGCHESS_PIECE_PAWN) {
+        return 0;
+    }
+    kgchess_player_t player = chess->current_player;
+    int to = SQUARE(x, y);
+    uint64_t occupied = get_occupied(chess);
+    uint64_t pieces = chess->player_bbs[player] & chess->type_bbs[type];
+    uint64_t candidates = 0;
+    switch (type) {
+        case KGCHESS_PIECE_KING:   candidates = pieces; break; // castling moves it two squares
+        case KGCHESS_PIECE_QUEEN:  candidates = pieces & (get_rook_attacks(to, occupied) | get_bishop_attacks(to, occupied)); break;
+        case KGCHESS_PIECE_BISHOP: candidates = pieces & get_bishop_attacks(to, occupied); break;
+        case KGCHESS_PIECE_KNIGHT: candidates = pieces & knight_attacks[to]; break;
+        case KGCHESS_PIECE_ROOK:   candidates = pieces & get_rook_attacks(to, occupied); break;
+        case KGCHESS_PIECE_PAWN: {
+            int dir = player == KGCHESS_PLAYER_WHITE ? 1 : -1;
+            candidates = pieces & pawn_attacks[kgchess_get_enemy_player(player)][to];
+            for (int i = 1; i <= 2; i++) {
+                int from_y = y - i * dir;
+                if (from_y >= 0 && from_y < 8) {
+                    candidates |= pieces & SQUARE_BIT(SQUARE(x, from_y));
+                }
+            }
+            break;
+        }
+        default: return 0;
+    }
+
+    legality_t legality = get_legality(chess, player);
+    moves_list_t list = moves_list_make(out, capacity);
+    while (candidates) {
+        kgchess_move_t moves[28];
+        moves_list_t piece_moves = moves_list_make(moves, ARRAY_LENGTH(moves));
+        get_moves(chess, &legality, bb_pop_lsb(&candidates), &piece_moves);
+        for (int i = 0; i < piece_moves.count; i++) {
+            if (moves[i].to.x == x && moves[i].to.y == y) {
+                add_move(&list, moves[i]);
+            }
+        }
+    }
+    return list.count;
+}
+
+int kgchess_get_packed_moves(const kgchess_t *chess, int x, int y, kgchess_packed_move_t *out, int capacity) {
+    kgchess_moves_array_t arr = kgchess_get_moves(chess, x, y);
+    return pack_moves(chess, arr.items, arr.count, out, capacity);
+}
+
+int kgchess_get_all_packed_moves(const kgchess_t *chess, kgchess_packed_move_t *out, int capacity) {
+    kgchess_move_t moves[KGCHESS_MAX_MOVES];
+    moves_list_t list = moves_list_make(moves, ARRAY_LENGTH(moves));
+    get_player_moves(chess, chess->current_player, &list);
+    return pack_moves(chess, moves, list.count, out, capacity);
+}
+
+int kgchess_get_all_packed_captures(const kgchess_t *chess, kgchess_packed_move_t *out, int capacity) {
+    kgchess_move_t moves[KGCHESS_MAX_MOVES];
+    moves_list_t list = moves_list_make(moves, ARRAY_LENGTH(moves));
+    list.is_captures_only = true;
+    get_player_moves(chess, chess->current_player, &list);
+    return pack_moves(chess, moves, list.count, out, capacity);
+}
+
+kgchess_packed_move_t kgchess_pack_move(kgchess_move_t move, kgchess_piece_type_t promotion) {
+    if (!is_pos_valid(move.from) || !is_pos_valid(move.to)) {
+        return KGCHESS_PACKED_MOVE_NONE;
+    }
+    int flags = 0;
+    if (move.is_castling) {
+        flags = PACKED_FLAG_CASTLING;
+    } else if (move.is_en_passant) {
+        flags = PACKED_FLAG_EN_PASSANT;
+    } else {
+        if (move.is_attack) {
+            flags |= PACKED_FLAG_CAPTURE;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (PACKED_PROMOTION_PIECES[i] == promotion) {
+                flags |= PACKED_FLAG_PROMOTION | i;
+            }
+        }
+    }
+    int from = SQUARE(move.from.x, move.from.y);
+    int to = SQUARE(move.to.x, move.to.y);
+    return (kgchess_packed_move_t)(from | (to << 6) | (flags << 12));
+}
+
+kgchess_move_t kgchess_unpack_move(kgchess_packed_move_t move, kgchess_piece_type_t *promotion) {
+    int from = move & 63;
+    int to = (move >> 6) & 63;
+    int flags = move >> 12;
+    if (promotion) {
+        *promotion = flags & PACKED_FLAG_PROMOTION ? PACKED_PROMOTION_PIECES[flags & 3] : KGCHESS_PIECE_NONE;
+    }
+    return move_make(SQUARE_X(from), SQUARE_Y(from), SQUARE_X(to), SQUARE_Y(to),
+                     (flags & PACKED_FLAG_CAPTURE) != 0, flags == PACKED_FLAG_CASTLING, flags == PACKED_FLAG_EN_PASSANT);
+}
+
+int kgchess_count_all_moves(const kgchess_t *chess) {
+    moves_list_t list = moves_list_make(NULL, 0);
+    get_player_moves(chess, chess->current_player, &list);
+    return list.count;
 }
 
 bool kgchess_move(kgchess_t *chess, kgchess_move_t move) {
@@ -157,6 +817,112 @@ bool kgchess_move(kgchess_t *chess, kgchess_move_t move) {
     return true;
 }
 
+bool kgchess_move_packed(kgchess_t *chess, kgchess_packed_move_t move) {
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    kgchess_move(chess, kgchess_unpack_move(move, &promotion));
+    if (promotion != KGCHESS_PIECE_NONE && chess->state == KGCHESS_STATE_PROMOTION) {
+        kgchess_promote(chess, promotion);
+    }
+    return true;
+}
+
+bool kgchess_push_move(kgchess_t *chess, kgchess_move_t move) {
+    if (chess->undo_count >= chess->undo_capacity) {
+        return false;
+    }
+    if (!is_pos_valid(move.from) || !is_pos_valid(move.to)) {
+        return false;
+    }
+    int captured_sq = move.is_en_passant ? SQUARE(move.to.x, move.from.y) : SQUARE(move.to.x, move.to.y);
+    undo_t *undo = push_undo(chess, move);
+    undo->moved_piece = chess->squares[SQUARE(move.from.x, move.from.y)];
+    undo->captured_piece = move.is_castling ? 0 : chess->squares[captured_sq];
+    apply_move(chess, move, true);
+    return true;
+}
+
+bool kgchess_push_null_move(kgchess_t *chess) {
+    if (chess->undo_count >= chess->undo_capacity || chess->state != KGCHESS_STATE_MOVE) {
+        return false;
+    }
+    STATS_BEGIN(KGCHESS_STAT_APPLY_MOVE);
+    kgchess_move_t null_move = move_make(-1, -1, -1, -1, false, false, false);
+    push_undo(chess, null_move);
+    chess->hash ^= get_state_hash(chess);
+    chess->move_num++;
+    chess->last_move = null_move;
+    chess->hash ^= get_state_hash(chess);
+    chess->current_player = kgchess_get_enemy_player(chess->current_player);
+    chess->hash ^= zobrist_black_to_move;
+    chess->is_end_checked = false;
+    chess->halfmove_clock++;
+    chess->repetition_plies = 0;
+    record_hash(chess);
+    STATS_END(KGCHESS_STAT_APPLY_MOVE);
+    return true;
+}
+
+bool kgchess_push_packed_move(kgchess_t *chess, kgchess_packed_move_t move) {
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    if (!kgchess_push_move(chess, kgchess_unpack_move(move, &promotion))) {
+        return false;
+    }
+    if (promotion != KGCHESS_PIECE_NONE && chess->state == KGCHESS_STATE_PROMOTION) {
+        kgchess_promote(chess, promotion);
+    }
+    return true;
+}
+
+bool kgchess_pop_move(kgchess_t *chess) {
+    if (chess->undo_count <= 0) {
+        return false;
+    }
+    STATS_BEGIN(KGCHESS_STAT_APPLY_MOVE);
+    chess->undo_count--;
+    const undo_t *undo = &chess->undo_stack[chess->undo_count];
+    kgchess_move_t move = undo->move;
+    kgchess_piece_t empty_piece = piece_make(KGCHESS_PIECE_NONE, KGCHESS_PLAYER_NONE);
+    kgchess_piece_t moved_piece = piece_make(undo->moved_piece & 7, undo->moved_piece >> 3);
+    kgchess_piece_t captured_piece = piece_make(undo->captured_piece & 7, undo->captured_piece >> 3);
+
+    uint64_t changed = get_move_squares(move);
+    uint64_t attack_sources = begin_attacks_update(chess, changed);
+    if (!is_pos_valid(move.from)) {
+        // null move, no pieces to restore
+    } else if (move.is_castling) {
+        int rook_from_x = move.to.x == 2 ? 0 : 7;
+        int rook_to_x = move.to.x == 2 ? 3 : 5;
+        kgchess_piece_t rook = get_piece_at(chess, rook_to_x, move.to.y);
+        set_piece_at(chess, empty_piece, move.to.x, move.to.y);
+        set_piece_at(chess, empty_piece, rook_to_x, move.to.y);
+        set_piece_at(chess, moved_piece, move.from.x, move.from.y);
+        set_piece_at(chess, rook, rook_from_x, move.from.y);
+    } else if (move.is_en_passant) {
+        set_piece_at(chess, empty_piece, move.to.x, move.to.y);
+        set_piece_at(chess, moved_piece, move.from.x, move.from.y);
+        set_piece_at(chess, captured_piece, move.to.x, move.from.y);
+    } else {
+        set_piece_at(chess, captured_piece, move.to.x, move.to.y);
+        set_piece_at(chess, moved_piece, move.from.x, move.from.y);
+    }
+    end_attacks_update(chess, changed, attack_sources);
+
+    chess->unmoved_bb = undo->unmoved_bb;
+    chess->hash = undo->hash;
+    chess->move_num--;
+    chess->last_move = undo->last_move;
+    chess->current_player = undo->current_player;
+    chess->state = undo->state;
+    chess->winner = undo->winner;
+    chess->is_end_checked = undo->is_end_checked;
+    chess->end_reason = undo->end_reason;
+    chess->promotion_pos = undo->promotion_pos;
+    chess->halfmove_clock = undo->halfmove_clock;
+    chess->repetition_plies = undo->repetition_plies;
+    STATS_END(KGCHESS_STAT_APPLY_MOVE);
+    return true;
+}
+
 kgchess_player_t kgchess_get_enemy_player(kgchess_player_t player) {
     if (player == KGCHESS_PLAYER_BLACK) {
         return KGCHESS_PLAYER_WHITE;
@@ -168,9 +934,30 @@ kgchess_player_t kgchess_get_enemy_player(kgchess_player_t player) {
 }
 
 kgchess_state_t kgchess_get_state(kgchess_t *chess) {
+    update_game_end(chess);
     return chess->state;
 }
 
+kgchess_end_reason_t kgchess_get_end_reason(kgchess_t *chess) {
+    update_game_end(chess);
+    return chess->end_reason;
+}
+
+int kgchess_get_halfmove_clock(const kgchess_t *chess) {
+    return chess->halfmove_clock;
+}
+
+int kgchess_get_repetitions_count(const kgchess_t *chess) {
+    return get_repetitions_count(chess, INT_MAX);
+}
+
+bool kgchess_is_draw(const kgchess_t *chess) {
+    STATS_BEGIN(KGCHESS_STAT_GAME_END);
+    bool is_draw = get_draw_reason(chess, 1) != KGCHESS_END_NONE;
+    STATS_END(KGCHESS_STAT_GAME_END);
+    return is_draw;
+}
+
 kgchess_pos_t kgchess_get_promotion_position(kgchess_t *chess) {
     return chess->promotion_pos;
 }
@@ -185,16 +972,26 @@ bool kgchess_promote(kgchess_t *chess, kgchess_piece_type_t piece_type) {
     if (piece_type == KGCHESS_PIECE_PAWN || piece_type == KGCHESS_PIECE_KING) {
         return false;
     }
-    kgchess_piece_internal_t piece = get_piece_at(chess, chess->promotion_pos.x, chess->promotion_pos.y);
+    kgchess_piece_t piece = get_piece_at(chess, chess->promotion_pos.x, chess->promotion_pos.y);
     piece.type = piece_type;
+    uint64_t changed = SQUARE_BIT(SQUARE(chess->promotion_pos.x, chess->promotion_pos.y));
+    uint64_t attack_sources = begin_attacks_update(chess, changed);
     set_piece_at(chess, piece, chess->promotion_pos.x, chess->promotion_pos.y);
+    end_attacks_update(chess, changed, attack_sources);
     chess->state = KGCHESS_STATE_MOVE;
     chess->current_player = kgchess_get_enemy_player(chess->current_player);
-    check_checkmate(chess);
+    chess->hash ^= zobrist_black_to_move;
+    chess->is_end_checked = false;
+    record_hash(chess);
     return true;
 }
 
+uint64_t kgchess_get_hash(const kgchess_t *chess) {
+    return chess->hash;
+}
+
 kgchess_player_t kgchess_get_winner(kgchess_t *chess) {
+    update_game_end(chess);
     return chess->winner;
 }
 
@@ -203,32 +1000,246 @@ kgchess_player_t kgchess_get_current_player(kgchess_t *chess) {
 }
 
 void kgchess_draw(kgchess_t *chess) {
+    chess->is_end_checked = true;
     chess->state = KGCHESS_STATE_ENDED;
     chess->winner = KGCHESS_PLAYER_NONE;
+    chess->end_reason = KGCHESS_END_DECLARED;
 }
 
 void kgchess_set_winner(kgchess_t *chess, kgchess_player_t player) {
+    chess->is_end_checked = true;
     chess->state = KGCHESS_STATE_ENDED;
     chess->winner = player;
+    chess->end_reason = KGCHESS_END_DECLARED;
 }
 
-bool kgchess_is_square_attacked_by_player(const kgchess_t *chess, int square_x, int square_y, kgchess_player_t player) {
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 8; y++) {
-            kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-            if (piece.player != player) {
-                continue;
-            }
-            kgchess_moves_array_t moves = get_moves(chess, x, y, true, true);
-            for (int i = 0; i < moves.count; i++) {
-                kgchess_move_t move = moves.items[i];
-                if (move.is_attack && move.to.x == square_x && move.to.y == square_y) {
-                    return true;
-                }
-            }
+int kgchess_get_attackers_count(const kgchess_t *chess, int x, int y, kgchess_player_t player) {
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) {
+        return 0;
+    }
+    if (player != KGCHESS_PLAYER_WHITE && player != KGCHESS_PLAYER_BLACK) {
+        return 0;
+    }
+    int sq = SQUARE(x, y);
+    int count = 0;
+    for (int i = 0; i < ATTACK_COUNT_BITS; i++) {
+        count |= (int)((chess->attack_counts[player][i] >> sq) & 1) << i;
+    }
+    return count;
+}
+
+bool kgchess_is_in_check(const kgchess_t *chess) {
+    return is_in_check(chess, chess->current_player);
+}
+
+int kgchess_get_pieces_count(const kgchess_t *chess, kgchess_player_t player, kgchess_piece_type_t type) {
+    if (player < KGCHESS_PLAYER_WHITE || player > KGCHESS_PLAYER_BLACK) {
+        return 0;
+    }
+    if (type == KGCHESS_PIECE_NONE) {
+        return bb_count(chess->player_bbs[player]);
+    }
+    if (type < KGCHESS_PIECE_KING || type > KGCHESS_PIECE_PAWN) {
+        return 0;
+    }
+    return bb_count(chess->type_bbs[type] & chess->player_bbs[player]);
+}
+
+uint64_t kgchess_get_bitboard(const kgchess_t *chess, kgchess_player_t player, kgchess_piece_type_t type) {
+    if (player < KGCHESS_PLAYER_NONE || player > KGCHESS_PLAYER_BLACK || type < KGCHESS_PIECE_NONE || type > KGCHESS_PIECE_PAWN) {
+        return 0;
+    }
+    uint64_t players_bb = player == KGCHESS_PLAYER_NONE ? get_occupied(chess) : chess->player_bbs[player];
+    uint64_t types_bb = type == KGCHESS_PIECE_NONE ? get_occupied(chess) : chess->type_bbs[type];
+    return players_bb & types_bb;
+}
+
+int kgchess_get_castling_rights(const kgchess_t *chess) {
+    return get_castling_rights(chess);
+}
+
+int kgchess_get_en_passant_square(const kgchess_t *chess) {
+    return get_double_push_sq(chess);
+}
+
+int kgchess_evaluate(const kgchess_t *chess) {
+    int mg = chess->eval_mg;
+    int eg = chess->eval_eg;
+    int phase = chess->eval_phase;
+    if (chess->eval_generation != eval_generation) {
+        sum_eval(chess, &mg, &eg, &phase); // weights changed, the board updates its totals with its next move
+    }
+    int score = eg;
+    if (eval_max_phase > 0) {
+        phase = phase < 0 ? 0 : phase;
+        phase = phase > eval_max_phase ? eval_max_phase : phase; // promotions can add more than the start had
+        score = (mg * phase + eg * (eval_max_phase - phase)) / eval_max_phase;
+    }
+    return chess->current_player == KGCHESS_PLAYER_WHITE ? score : -score;
+}
+
+void kgchess_get_eval_weights(kgchess_eval_weights_t *out) {
+    init_tables();
+    lock_eval_weights();
+    *out = eval_weights;
+    unlock_eval_weights();
+}
+
+void kgchess_set_eval_weights(const kgchess_eval_weights_t *weights) {
+    init_tables();
+    lock_eval_weights();
+    init_eval(weights ? weights : &DEFAULT_EVAL_WEIGHTS);
+    eval_generation++;
+    compute_eval(&start_position);
+    unlock_eval_weights();
+}
+
+// Swap algorithm: both players keep capturing on the target square with their least valuable piece, removing
+// each capturer from the occupancy reveals sliders behind it. Then, going back from the last capture, every player
+// either makes the capture or stops if it would lose material.
+int kgchess_see(const kgchess_t *chess, kgchess_move_t move) {
+    if (!is_pos_valid(move.from) || !is_pos_valid(move.to) || move.is_castling) {
+        return 0;
+    }
+    int from = SQUARE(move.from.x, move.from.y);
+    int to = SQUARE(move.to.x, move.to.y);
+    uint8_t moved = chess->squares[from];
+    if (moved == 0) {
+        return 0;
+    }
+    uint64_t occupied = get_occupied(chess) & ~SQUARE_BIT(from);
+    int gains[32];
+    gains[0] = SEE_VALUES[chess->squares[to] & 7];
+    if (move.is_en_passant) {
+        gains[0] = SEE_VALUES[KGCHESS_PIECE_PAWN];
+        occupied &= ~SQUARE_BIT(SQUARE(move.to.x, move.from.y));
+    }
+    int victim_value = SEE_VALUES[moved & 7];
+    kgchess_player_t player = kgchess_get_enemy_player(moved >> 3);
+    uint64_t diagonal_sliders = chess->type_bbs[KGCHESS_PIECE_BISHOP] | chess->type_bbs[KGCHESS_PIECE_QUEEN];
+    uint64_t straight_sliders = chess->type_bbs[KGCHESS_PIECE_ROOK] | chess->type_bbs[KGCHESS_PIECE_QUEEN];
+    uint64_t attackers = get_attackers(chess, to, occupied) & occupied;
+    int depth = 0;
+    while (depth < ARRAY_LENGTH(gains) - 1) {
+        kgchess_piece_type_t type = KGCHESS_PIECE_NONE;
+        int sq = get_least_valuable_attacker(chess, attackers & chess->player_bbs[player], &type);
+        if (sq == -1) {
+            break;
+        }
+        depth++;
+        gains[depth] = victim_value - gains[depth - 1];
+        occupied &= ~SQUARE_BIT(sq);
+        attackers |= (get_bishop_attacks(to, occupied) & diagonal_sliders) | (get_rook_attacks(to, occupied) & straight_sliders);
+        attackers &= occupied;
+        kgchess_player_t enemy = kgchess_get_enemy_player(player);
+        if (type == KGCHESS_PIECE_KING && (attackers & chess->player_bbs[enemy])) {
+            depth--; // king can't capture on a defended square
+            break;
+        }
+        victim_value = SEE_VALUES[type];
+        player = enemy;
+    }
+    while (depth > 0) {
+        if (gains[depth] > -gains[depth - 1]) {
+            gains[depth - 1] = -gains[depth];
         }
+        depth--;
     }
+    return gains[0];
+}
+
+bool kgchess_is_square_attacked_by_player(const kgchess_t *chess, int x, int y, kgchess_player_t player) {
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) {
+        return false;
+    }
+    STATS_BEGIN(KGCHESS_STAT_IS_SQUARE_ATTACKED);
+    bool is_attacked = is_square_attacked(chess, SQUARE(x, y), player);
+    STATS_END(KGCHESS_STAT_IS_SQUARE_ATTACKED);
+    return is_attacked;
+}
+
+kgchess_stats_t kgchess_get_stats() {
+    kgchess_stats_t stats;
+    memset(&stats, 0, sizeof(kgchess_stats_t));
+#ifdef KGCHESS_USE_STATS
+    for (stats_block_t *block = atomic_load(&stats_blocks); block; block = block->next) {
+        for (int i = 0; i < KGCHESS_STAT_COUNT; i++) {
+            stats.calls[i] += atomic_load_explicit(&block->calls[i], memory_order_relaxed);
+            stats.cycles[i] += atomic_load_explicit(&block->cycles[i], memory_order_relaxed);
+        }
+    }
+#endif
+    return stats;
+}
+
+void kgchess_reset_stats() {
+#ifdef KGCHESS_USE_STATS
+    for (stats_block_t *block = atomic_load(&stats_blocks); block; block = block->next) {
+        for (int i = 0; i < KGCHESS_STAT_COUNT; i++) {
+            atomic_store_explicit(&block->calls[i], 0, memory_order_relaxed);
+            atomic_store_explicit(&block->cycles[i], 0, memory_order_relaxed);
+        }
+    }
+#endif
+}
+
+bool kgchess_is_stats_enabled() {
+#ifdef KGCHESS_USE_STATS
+    return true;
+#else
     return false;
+#endif
+}
+
+const char* kgchess_get_stat_name(kgchess_stat_t stat) {
+    if (stat < 0 || stat >= KGCHESS_STAT_COUNT) {
+        return NULL;
+    }
+    return STAT_NAMES[stat];
+}
+
+int kgchess_stats_to_string(const kgchess_stats_t *stats, char *out, int capacity) {
+    int length = 0;
+    int written = snprintf(out, capacity > 0 ? (size_t)capacity : 0, "%-20s %14s %16s %12s\n",
+                           "counter", "calls", "cycles", "cycles/call");
+    if (written < 0 || written >= capacity) {
+        return 0;
+    }
+    length += written;
+    for (int i = 0; i < KGCHESS_STAT_COUNT; i++) {
+        uint64_t per_call = stats->calls[i] > 0 ? stats->cycles[i] / stats->calls[i] : 0;
+        written = snprintf(out + length, (size_t)(capacity - length), "%-20s %14llu %16llu %12llu\n", STAT_NAMES[i],
+                           (unsigned long long)stats->calls[i], (unsigned long long)stats->cycles[i],
+                           (unsigned long long)per_call);
+        if (written < 0 || written >= capacity - length) {
+            return 0;
+        }
+        length += written;
+    }
+    return length;
+}
+
+int kgchess_stats_to_json(const kgchess_stats_t *stats, char *out, int capacity) {
+    if (capacity < 2) {
+        return 0;
+    }
+    int length = 0;
+    out[length++] = '{';
+    for (int i = 0; i < KGCHESS_STAT_COUNT; i++) {
+        int written = snprintf(out + length, (size_t)(capacity - length), "%s\"%s\":{\"calls\":%llu,\"cycles\":%llu}",
+                               i > 0 ? "," : "", STAT_NAMES[i], (unsigned long long)stats->calls[i],
+                               (unsigned long long)stats->cycles[i]);
+        if (written < 0 || written >= capacity - length) {
+            return 0;
+        }
+        length += written;
+    }
+    if (length + 2 > capacity) {
+        return 0;
+    }
+    out[length++] = '}';
+    out[length] = '\0';
+    return length;
 }
 
 //-----------------------------------------------------------------------------
@@ -247,34 +1258,200 @@ static kgchess_move_t move_make(int from_x, int from_y, int to_x, int to_y, bool
     return move;
 }
 
-static void add_move(kgchess_moves_array_t *arr, kgchess_move_t move) {
-    if (arr->count >= ARRAY_LENGTH(arr->items)) {
-        return;
-    }
-    arr->items[arr->count] = move;
-    arr->count++;
+static moves_list_t moves_list_make(kgchess_move_t *items, int capacity) {
+    moves_list_t list;
+    list.items = items;
+    list.count = 0;
+    list.capacity = capacity;
+    list.is_captures_only = false;
+    return list;
 }
 
-static void add_move_if_legal(const kgchess_t *chess, kgchess_moves_array_t *arr, kgchess_move_t move, bool is_attacks_check) {
-    if (move.to.x < 0 || move.to.x >= 8 || move.to.y < 0 || move.to.y >= 8) {
+static void add_move(moves_list_t *list, kgchess_move_t move) {
+    if (list->items == NULL) {
+        list->count++;
         return;
     }
-    if (!is_attacks_check) {
-        kgchess_piece_t piece = kgchess_get_piece_at(chess, move.from.x, move.from.y);
-        kgchess_t chess_copy = *chess;
-        apply_move(&chess_copy, move, false);
-        if (is_in_check(&chess_copy, piece.player)) {
-            return;
+    if (list->count >= list->capacity) {
+        return;
+    }
+    list->items[list->count] = move;
+    list->count++;
+}
+
+static undo_t* push_undo(kgchess_t *chess, kgchess_move_t move) {
+    undo_t *undo = &chess->undo_stack[chess->undo_count];
+    undo->move = move;
+    undo->last_move = chess->last_move;
+    undo->moved_piece = 0;
+    undo->captured_piece = 0;
+    undo->current_player = (uint8_t)chess->current_player;
+    undo->state = (uint8_t)chess->state;
+    undo->winner = (uint8_t)chess->winner;
+    undo->is_end_checked = chess->is_end_checked;
+    undo->end_reason = (uint8_t)chess->end_reason;
+    undo->promotion_pos = chess->promotion_pos;
+    undo->halfmove_clock = chess->halfmove_clock;
+    undo->repetition_plies = chess->repetition_plies;
+    undo->unmoved_bb = chess->unmoved_bb;
+    undo->hash = chess->hash;
+    chess->undo_count++;
+    return undo;
+}
+
+static void record_hash(kgchess_t *chess) {
+    if (chess->hash_history) {
+        chess->hash_history[chess->move_num % HASH_HISTORY_SIZE] = chess->hash;
+    }
+}
+
+// Copies hashes of the positions dst can repeat, the ones since the last capture or pawn move (src may be dst
+// with its old history). If src has no history dst's repetitions start over.
+static void copy_hash_history(kgchess_t *dst, const kgchess_t *src) {
+    if (!dst->hash_history) {
+        return;
+    }
+    if (!src->hash_history) {
+        dst->repetition_plies = 0;
+    } else if (src->hash_history != dst->hash_history) {
+        int plies = src->repetition_plies < HASH_HISTORY_SIZE ? src->repetition_plies : HASH_HISTORY_SIZE - 1;
+        for (int i = 1; i <= plies; i++) {
+            int index = (src->move_num - i) % HASH_HISTORY_SIZE;
+            dst->hash_history[index] = src->hash_history[index];
+        }
+    }
+    record_hash(dst);
+}
+
+// Pawn moves to the last rank become one packed move per promotion piece.
+static int pack_moves(const kgchess_t *chess, const kgchess_move_t *moves, int count, kgchess_packed_move_t *out, int capacity) {
+    int packed_count = 0;
+    for (int i = 0; i < count; i++) {
+        kgchess_move_t move = moves[i];
+        bool is_promotion = (chess->type_bbs[KGCHESS_PIECE_PAWN] & SQUARE_BIT(SQUARE(move.from.x, move.from.y)))
+                            && (move.to.y == 0 || move.to.y == 7);
+        if (!is_promotion) {
+            if (packed_count < capacity) {
+                out[packed_count++] = kgchess_pack_move(move, KGCHESS_PIECE_NONE);
+            }
+            continue;
+        }
+        for (int j = 0; j < 4 && packed_count < capacity; j++) {
+            out[packed_count++] = kgchess_pack_move(move, PROMOTION_PIECES[j]);
+        }
+    }
+    return packed_count;
+}
+
+static legality_t get_legality(const kgchess_t *chess, kgchess_player_t player) {
+    legality_t legality;
+    legality.player = player;
+    legality.king_sq = -1;
+    legality.checkers = 0;
+    legality.check_mask = ~0ULL;
+    legality.pinned = 0;
+
+    uint64_t king = chess->type_bbs[KGCHESS_PIECE_KING] & chess->player_bbs[player];
+    if (king == 0) {
+        return legality;
+    }
+    int king_sq = bb_lsb(king);
+    legality.king_sq = king_sq;
+
+    uint64_t occupied = get_occupied(chess);
+    uint64_t enemy_bb = chess->player_bbs[kgchess_get_enemy_player(player)];
+    kgchess_player_t enemy = kgchess_get_enemy_player(player);
+    if (get_attacked(chess, enemy) & king) {
+        legality.checkers = get_attackers(chess, king_sq, occupied) & enemy_bb;
+    }
+    if (legality.checkers) {
+        if (legality.checkers & (legality.checkers - 1)) {
+            legality.check_mask = 0;
+        } else {
+            legality.check_mask = legality.checkers | between_masks[king_sq][bb_lsb(legality.checkers)];
+        }
+    }
+
+    const uint64_t *types = chess->type_bbs;
+    uint64_t snipers = ((get_rook_attacks(king_sq, 0) & (types[KGCHESS_PIECE_ROOK] | types[KGCHESS_PIECE_QUEEN]))
+                      | (get_bishop_attacks(king_sq, 0) & (types[KGCHESS_PIECE_BISHOP] | types[KGCHESS_PIECE_QUEEN])))
+                      & enemy_bb;
+    while (snipers) {
+        uint64_t blockers = between_masks[king_sq][bb_pop_lsb(&snipers)] & occupied;
+        if (blockers && (blockers & (blockers - 1)) == 0) {
+            legality.pinned |= blockers & chess->player_bbs[player];
         }
     }
-    add_move(arr, move);
+    return legality;
+}
+
+static void add_move_if_legal(const kgchess_t *chess, const legality_t *legality, moves_list_t *list, kgchess_move_t move) {
+    if (is_move_legal(chess, legality, move)) {
+        add_move(list, move);
+    } else {
+        STATS_COUNT(KGCHESS_STAT_ILLEGAL_MOVES);
+    }
+}
+
+static bool is_move_legal(const kgchess_t *chess, const legality_t *legality, kgchess_move_t move) {
+    int from = SQUARE(move.from.x, move.from.y);
+    int to = SQUARE(move.to.x, move.to.y);
+    if (legality->king_sq == -1) {
+        return true;
+    }
+    if (move.is_en_passant) {
+        // The captured pawn disappears from a third square, which can uncover the king along its rank.
+        uint64_t captured_bit = SQUARE_BIT(SQUARE(move.to.x, move.from.y));
+        uint64_t occupied = (get_occupied(chess) & ~SQUARE_BIT(from) & ~captured_bit) | SQUARE_BIT(to);
+        uint64_t enemy_bb = chess->player_bbs[kgchess_get_enemy_player(legality->player)] & ~captured_bit & ~SQUARE_BIT(to);
+        return (get_attackers(chess, legality->king_sq, occupied) & enemy_bb) == 0;
+    } else if (from == legality->king_sq) {
+        return is_king_move_legal(chess, legality, move);
+    }
+    if (!(legality->check_mask & SQUARE_BIT(to))) {
+        return false;
+    }
+    return !(legality->pinned & SQUARE_BIT(from)) || (line_masks[legality->king_sq][from] & SQUARE_BIT(to));
+}
+
+static bool is_king_move_legal(const kgchess_t *chess, const legality_t *legality, kgchess_move_t move) {
+    int to = SQUARE(move.to.x, move.to.y);
+    kgchess_player_t enemy = kgchess_get_enemy_player(legality->player);
+    if (legality->checkers == 0) {
+        // Without a check the king doesn't shield any square it can step on (castling rook only adds a blocker).
+        return (get_attacked(chess, enemy) & SQUARE_BIT(to)) == 0;
+    }
+    uint64_t occupied = get_occupied(chess) & ~SQUARE_BIT(legality->king_sq);
+    if (move.is_castling) {
+        int rook_from_x = move.to.x == 2 ? 0 : 7;
+        int rook_to_x = move.to.x == 2 ? 3 : 5;
+        occupied &= ~SQUARE_BIT(SQUARE(rook_from_x, move.from.y));
+        occupied |= SQUARE_BIT(SQUARE(rook_to_x, move.to.y)) | SQUARE_BIT(to);
+    }
+    uint64_t enemy_bb = chess->player_bbs[enemy];
+    return (get_attackers(chess, to, occupied) & enemy_bb & ~SQUARE_BIT(to)) == 0;
 }
 
 static void apply_move(kgchess_t *chess, kgchess_move_t move, bool update_state) {
-    kgchess_piece_internal_t empty_piece = piece_make(KGCHESS_PIECE_NONE, KGCHESS_PLAYER_NONE);
+    STATS_BEGIN(KGCHESS_STAT_APPLY_MOVE);
+    kgchess_piece_t empty_piece = piece_make(KGCHESS_PIECE_NONE, KGCHESS_PLAYER_NONE);
+
+    chess->hash ^= get_state_hash(chess);
+
+    // Draws by the rules leave legal moves, if one is made the game goes on and the end is checked again after it.
+    if (update_state && chess->state == KGCHESS_STATE_ENDED && is_draw_by_rules(chess->end_reason)) {
+        chess->state = KGCHESS_STATE_MOVE;
+        chess->end_reason = KGCHESS_END_NONE;
+    }
+
+    // Castling moves a king onto an empty square, so only pawn moves and captures reset the halfmove clock.
+    uint8_t moved_square = chess->squares[SQUARE(move.from.x, move.from.y)];
+    bool is_irreversible = (moved_square & 7) == KGCHESS_PIECE_PAWN || chess->squares[SQUARE(move.to.x, move.to.y)] != 0;
 
+    uint64_t changed = get_move_squares(move);
+    uint64_t attack_sources = begin_attacks_update(chess, changed);
     if (move.is_castling) {
-        kgchess_piece_internal_t king = get_piece_at(chess, move.from.x, move.from.y);
+        kgchess_piece_t king = get_piece_at(chess, move.from.x, move.from.y);
         int rook_from_x = -1;
         int rook_to_x = -1;
         if (move.to.x == 2) {
@@ -284,25 +1461,20 @@ static void apply_move(kgchess_t *chess, kgchess_move_t move, bool update_state)
             rook_from_x = 7;
             rook_to_x = 5;
         }
-        kgchess_piece_internal_t rook = get_piece_at(chess, rook_from_x, move.from.y);
+        kgchess_piece_t rook = get_piece_at(chess, rook_from_x, move.from.y);
 
         set_piece_at(chess, empty_piece, move.from.x, move.from.y);
         set_piece_at(chess, empty_piece, rook_from_x, move.from.y);
 
-        king.last_move_num = chess->move_num;
-        rook.last_move_num = chess->move_num;
-
         set_piece_at(chess, king, move.to.x, move.to.y);
         set_piece_at(chess, rook, rook_to_x, move.to.y);
     } else if (move.is_en_passant) {
-        kgchess_piece_internal_t piece = get_piece_at(chess, move.from.x, move.from.y);
-        piece.last_move_num = chess->move_num;
+        kgchess_piece_t piece = get_piece_at(chess, move.from.x, move.from.y);
         set_piece_at(chess, empty_piece, move.from.x, move.from.y);
         set_piece_at(chess, piece, move.to.x, move.to.y);
         set_piece_at(chess, empty_piece, move.to.x, move.from.y);
     } else {
-        kgchess_piece_internal_t piece = get_piece_at(chess, move.from.x, move.from.y);
-        piece.last_move_num = chess->move_num;
+        kgchess_piece_t piece = get_piece_at(chess, move.from.x, move.from.y);
         set_piece_at(chess, empty_piece, move.from.x, move.from.y);
         set_piece_at(chess, piece, move.to.x, move.to.y);
         if (piece.type == KGCHESS_PIECE_PAWN) {
@@ -313,56 +1485,108 @@ static void apply_move(kgchess_t *chess, kgchess_move_t move, bool update_state)
             }
         }
     }
+    end_attacks_update(chess, changed, attack_sources);
 
     chess->move_num++;
     chess->last_move = move;
-    if (chess->state == KGCHESS_STATE_MOVE && update_state) {
+    chess->hash ^= get_state_hash(chess);
+    chess->halfmove_clock = is_irreversible ? 0 : chess->halfmove_clock + 1;
+    chess->repetition_plies = is_irreversible ? 0 : chess->repetition_plies + 1;
+    if (chess->state != KGCHESS_STATE_PROMOTION && update_state) {
         chess->current_player = kgchess_get_enemy_player(chess->current_player);
-        check_checkmate(chess);
+        chess->hash ^= zobrist_black_to_move;
+        chess->is_end_checked = false;
     }
+    record_hash(chess);
+    STATS_END(KGCHESS_STAT_APPLY_MOVE);
 }
 
-static bool is_position_empty(const kgchess_t *chess, int x, int y) {
-    kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-    return piece.type == KGCHESS_PIECE_NONE;
-}
-
-static bool is_player_at_position(const kgchess_t *chess, kgchess_player_t player, int x, int y) {
-    kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-    return piece.type != KGCHESS_PIECE_NONE && piece.player == player;
+// Squares whose pieces change when the move is applied or taken back.
+static uint64_t get_move_squares(kgchess_move_t move) {
+    if (!is_pos_valid(move.from) || !is_pos_valid(move.to)) {
+        return 0;
+    }
+    uint64_t squares = SQUARE_BIT(SQUARE(move.from.x, move.from.y)) | SQUARE_BIT(SQUARE(move.to.x, move.to.y));
+    if (move.is_castling) {
+        int rook_from_x = move.to.x == 2 ? 0 : 7;
+        int rook_to_x = move.to.x == 2 ? 3 : 5;
+        squares |= SQUARE_BIT(SQUARE(rook_from_x, move.from.y)) | SQUARE_BIT(SQUARE(rook_to_x, move.from.y));
+    } else if (move.is_en_passant) {
+        squares |= SQUARE_BIT(SQUARE(move.to.x, move.from.y));
+    }
+    return squares;
 }
 
-static kgchess_piece_internal_t piece_make(kgchess_piece_type_t type, kgchess_player_t player) {
-    kgchess_piece_internal_t p;
+static kgchess_piece_t piece_make(kgchess_piece_type_t type, kgchess_player_t player) {
+    kgchess_piece_t p;
     p.type = type;
     p.player = player;
-    p.last_move_num = -1;
     return p;
 }
 
-static kgchess_piece_internal_t get_piece_at(const kgchess_t *chess, int x, int y) {
+static bool is_pos_valid(kgchess_pos_t pos) {
+    return pos.x >= 0 && pos.x < 8 && pos.y >= 0 && pos.y < 8;
+}
+
+static kgchess_piece_t get_piece_at(const kgchess_t *chess, int x, int y) {
     if (x < 0 || x >= 8 || y < 0 || y >= 8) {
         return piece_make(KGCHESS_PIECE_NONE, KGCHESS_PLAYER_NONE);
     }
-    return chess->pieces[x][y];
+    return get_square_piece(chess, SQUARE(x, y));
 }
 
-static void set_piece_at(kgchess_t *chess, kgchess_piece_internal_t piece, int x, int y) {
+static kgchess_piece_t get_square_piece(const kgchess_t *chess, int sq) {
+    uint8_t square = chess->squares[sq];
+    return piece_make(square & 7, square >> 3);
+}
+
+// Every piece placed on a square has moved (or was captured), so the square loses its unmoved flag.
+static void set_piece_at(kgchess_t *chess, kgchess_piece_t piece, int x, int y) {
     if (x < 0 || x >= 8 || y < 0 || y >= 8) {
         return;
     }
-    chess->pieces[x][y] = piece;
+    if (chess->eval_generation != eval_generation) {
+        compute_eval(chess); // weights changed since the totals were computed
+    }
+    int sq = SQUARE(x, y);
+    uint64_t bit = SQUARE_BIT(sq);
+    uint8_t square = chess->squares[sq];
+    if (square != 0) {
+        chess->type_bbs[square & 7] &= ~bit;
+        chess->player_bbs[square >> 3] &= ~bit;
+        chess->hash ^= zobrist_pieces[square >> 3][square & 7][sq];
+        chess->eval_mg -= eval_scores[0][square >> 3][square & 7][sq];
+        chess->eval_eg -= eval_scores[1][square >> 3][square & 7][sq];
+        chess->eval_phase -= eval_weights.phase_weights[square & 7];
+    }
+    chess->unmoved_bb &= ~bit;
+    if (piece.type == KGCHESS_PIECE_NONE) {
+        chess->squares[sq] = 0;
+        return;
+    }
+    chess->type_bbs[piece.type] |= bit;
+    chess->player_bbs[piece.player] |= bit;
+    chess->hash ^= zobrist_pieces[piece.player][piece.type][sq];
+    chess->eval_mg += eval_scores[0][piece.player][piece.type][sq];
+    chess->eval_eg += eval_scores[1][piece.player][piece.type][sq];
+    chess->eval_phase += eval_weights.phase_weights[piece.type];
+    chess->squares[sq] = (uint8_t)(piece.type | (piece.player << 3));
+}
+
+static uint64_t get_occupied(const kgchess_t *chess) {
+    return chess->player_bbs[KGCHESS_PLAYER_WHITE] | chess->player_bbs[KGCHESS_PLAYER_BLACK];
 }
 
 static bool is_castling_possible(const kgchess_t *chess, int x, int y, int rook_x) {
-    kgchess_piece_internal_t king = get_piece_at(chess, x, y);
-    kgchess_piece_internal_t rook = get_piece_at(chess, rook_x, y);
+    kgchess_piece_t king = get_piece_at(chess, x, y);
+    kgchess_piece_t rook = get_piece_at(chess, rook_x, y);
 
     if (king.type != KGCHESS_PIECE_KING || rook.type != KGCHESS_PIECE_ROOK) {
         return false;
     }
-    
-    if (king.last_move_num != -1 || rook.last_move_num != -1) {
+
+    uint64_t castling_pieces = SQUARE_BIT(SQUARE(x, y)) | SQUARE_BIT(SQUARE(rook_x, y));
+    if ((chess->unmoved_bb & castling_pieces) != castling_pieces) {
         return false;
     }
 
@@ -372,20 +1596,22 @@ static bool is_castling_possible(const kgchess_t *chess, int x, int y, int rook_
         return false;
     }
 
-    // todo: cache attacks?
+    uint64_t occupied = get_occupied(chess);
     if (rook_x == 0) {
-        if (!is_position_empty(chess, 1, y) || !is_position_empty(chess, 2, y) || !is_position_empty(chess, 3, y)) {
+        uint64_t between = SQUARE_BIT(SQUARE(1, y)) | SQUARE_BIT(SQUARE(2, y)) | SQUARE_BIT(SQUARE(3, y));
+        if (occupied & between) {
             return false;
         }
-        if (kgchess_is_square_attacked_by_player(chess, 3, y, enemy)) {
+        if (is_square_attacked(chess, SQUARE(3, y), enemy)) {
             return false;
         }
         return true;
     } else if (rook_x == 7) {
-        if (!is_position_empty(chess, 5, y) || !is_position_empty(chess, 6, y)) {
+        uint64_t between = SQUARE_BIT(SQUARE(5, y)) | SQUARE_BIT(SQUARE(6, y));
+        if (occupied & between) {
             return false;
         }
-        if (kgchess_is_square_attacked_by_player(chess, 5, y, enemy)) {
+        if (is_square_attacked(chess, SQUARE(5, y), enemy)) {
             return false;
         }
         return true;
@@ -399,7 +1625,7 @@ static int get_en_passant(const kgchess_t *chess, int pawn_x, int pawn_y, kgches
     }
 
     kgchess_move_t last_move = chess->last_move;
-    kgchess_piece_t last_move_piece = kgchess_get_piece_at(chess, last_move.to.x, last_move.to.y);
+    kgchess_piece_t last_move_piece = get_piece_at(chess, last_move.to.x, last_move.to.y);
     if (pawn.type != KGCHESS_PIECE_PAWN || last_move_piece.type != KGCHESS_PIECE_PAWN) {
         return -1;
     }
@@ -424,212 +1650,1040 @@ static int get_en_passant(const kgchess_t *chess, int pawn_x, int pawn_y, kgches
     return enemy_pawn_x;
 }
 
-static bool is_in_check(const kgchess_t *chess, kgchess_player_t player) {
-    int king_x = -1;
-    int king_y = -1;
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 8; y++) {
-            kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-            if (piece.type == KGCHESS_PIECE_KING && piece.player == player) {
-                king_x = x;
-                king_y = y;
-                break;
-            }
-        }
+// Bit 0: white king side, bit 1: white queen side, bit 2: black king side, bit 3: black queen side.
+static int get_castling_rights(const kgchess_t *chess) {
+    const uint64_t white_king = SQUARE_BIT(SQUARE(4, 0));
+    const uint64_t black_king = SQUARE_BIT(SQUARE(4, 7));
+    uint64_t unmoved_bb = chess->unmoved_bb;
+    int rights = 0;
+    if (unmoved_bb & white_king) {
+        rights |= (unmoved_bb & SQUARE_BIT(SQUARE(7, 0))) ? 1 : 0;
+        rights |= (unmoved_bb & SQUARE_BIT(SQUARE(0, 0))) ? 2 : 0;
+    }
+    if (unmoved_bb & black_king) {
+        rights |= (unmoved_bb & SQUARE_BIT(SQUARE(7, 7))) ? 4 : 0;
+        rights |= (unmoved_bb & SQUARE_BIT(SQUARE(0, 7))) ? 8 : 0;
+    }
+    return rights;
+}
+
+// File of a pawn that has just moved two squares and can be captured en passant, -1 otherwise.
+static int get_en_passant_file(const kgchess_t *chess) {
+    if (chess->move_num <= 0) {
+        return -1;
+    }
+    kgchess_move_t last_move = chess->last_move;
+    if (!is_pos_valid(last_move.to) || abs(last_move.to.y - last_move.from.y) != 2) {
+        return -1;
+    }
+    int sq = SQUARE(last_move.to.x, last_move.to.y);
+    kgchess_piece_t pawn = get_square_piece(chess, sq);
+    if (pawn.type != KGCHESS_PIECE_PAWN) {
+        return -1;
+    }
+    uint64_t neighbours = ((SQUARE_BIT(sq) << 1) & ~0x0101010101010101ULL) | ((SQUARE_BIT(sq) >> 1) & ~0x8080808080808080ULL);
+    uint64_t enemy_pawns = chess->type_bbs[KGCHESS_PIECE_PAWN] & chess->player_bbs[kgchess_get_enemy_player(pawn.player)];
+    if ((neighbours & enemy_pawns) == 0) {
+        return -1;
+    }
+    return last_move.to.x;
+}
+
+// Part of the hash that isn't updated piece by piece: castling rights and en passant file.
+static uint64_t get_state_hash(const kgchess_t *chess) {
+    uint64_t hash = zobrist_castling[get_castling_rights(chess)];
+    int en_passant_file = get_en_passant_file(chess);
+    if (en_passant_file != -1) {
+        hash ^= zobrist_en_passant[en_passant_file];
+    }
+    return hash;
+}
+
+static uint64_t compute_hash(const kgchess_t *chess) {
+    uint64_t hash = get_state_hash(chess);
+    uint64_t pieces = get_occupied(chess);
+    while (pieces) {
+        int sq = bb_pop_lsb(&pieces);
+        uint8_t square = chess->squares[sq];
+        hash ^= zobrist_pieces[square >> 3][square & 7][sq];
+    }
+    if (chess->current_player == KGCHESS_PLAYER_BLACK) {
+        hash ^= zobrist_black_to_move;
+    }
+    return hash;
+}
+
+static void compute_eval(kgchess_t *chess) {
+    sum_eval(chess, &chess->eval_mg, &chess->eval_eg, &chess->eval_phase);
+    chess->eval_generation = eval_generation;
+}
+
+static void sum_eval(const kgchess_t *chess, int *mg, int *eg, int *phase) {
+    *mg = 0;
+    *eg = 0;
+    *phase = 0;
+    uint64_t pieces = get_occupied(chess);
+    while (pieces) {
+        int sq = bb_pop_lsb(&pieces);
+        uint8_t square = chess->squares[sq];
+        *mg += eval_scores[0][square >> 3][square & 7][sq];
+        *eg += eval_scores[1][square >> 3][square & 7][sq];
+        *phase += eval_weights.phase_weights[square & 7];
     }
+}
 
-    if (king_x == -1 || king_y == -1) {
+static bool is_square_attacked(const kgchess_t *chess, int sq, kgchess_player_t player) {
+    if (player != KGCHESS_PLAYER_WHITE && player != KGCHESS_PLAYER_BLACK) {
         return false;
     }
+    // Only pawns count as attacking a square occupied by their own player, other pieces are blocked by it.
+    if (chess->player_bbs[player] & SQUARE_BIT(sq)) {
+        kgchess_player_t enemy = kgchess_get_enemy_player(player);
+        return (pawn_attacks[enemy][sq] & chess->type_bbs[KGCHESS_PIECE_PAWN] & chess->player_bbs[player]) != 0;
+    }
+    return (get_attacked(chess, player) & SQUARE_BIT(sq)) != 0;
+}
 
-    return kgchess_is_square_attacked_by_player(chess, king_x, king_y, kgchess_get_enemy_player(player));
+// Returns square of the least valuable piece in attackers (-1 if it's empty) and sets its type.
+static int get_least_valuable_attacker(const kgchess_t *chess, uint64_t attackers, kgchess_piece_type_t *out_type) {
+    for (int i = 0; i < ARRAY_LENGTH(SEE_CAPTURE_ORDER); i++) {
+        uint64_t pieces = attackers & chess->type_bbs[SEE_CAPTURE_ORDER[i]];
+        if (pieces) {
+            *out_type = SEE_CAPTURE_ORDER[i];
+            return bb_lsb(pieces);
+        }
+    }
+    return -1;
 }
 
-static void check_checkmate(kgchess_t *chess) {
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 8; y++) {
-            kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-            if (piece.type == KGCHESS_PIECE_NONE || piece.player != chess->current_player) {
-                continue;
+static bool is_in_check(const kgchess_t *chess, kgchess_player_t player) {
+    STATS_BEGIN(KGCHESS_STAT_IS_IN_CHECK);
+    uint64_t king = chess->type_bbs[KGCHESS_PIECE_KING] & chess->player_bbs[player];
+    bool is_checked = king != 0 && is_square_attacked(chess, bb_lsb(king), kgchess_get_enemy_player(player));
+    STATS_END(KGCHESS_STAT_IS_IN_CHECK);
+    return is_checked;
+}
+
+// Accepts EPD too: halfmove clock and fullmove number are optional and anything after them is ignored.
+static bool parse_fen(const char *fen, fen_position_t *position) {
+    if (fen == NULL) {
+        return false;
+    }
+    const char *it = fen;
+    while (*it == ' ') {
+        it++;
+    }
+
+    memset(position->squares, 0, sizeof(position->squares));
+    int x = 0;
+    int y = 7;
+    for (; *it != ' '; it++) {
+        char c = *it;
+        if (c == '/') {
+            if (x != 8 || y == 0) {
+                return false;
+            }
+            x = 0;
+            y--;
+        } else if (c >= '1' && c <= '8') {
+            x += c - '0';
+            if (x > 8) {
+                return false;
             }
-            kgchess_moves_array_t moves = kgchess_get_moves(chess, x, y);
-            if (moves.count != 0) {
-                return;
+        } else {
+            uint8_t square = get_fen_piece_square(c);
+            if (square == 0 || x >= 8) {
+                return false; // also catches end of string
             }
+            position->squares[SQUARE(x, y)] = square;
+            x++;
         }
     }
-    if (is_in_check(chess, chess->current_player)) {
-        chess->winner = kgchess_get_enemy_player(chess->current_player);
+    if (x != 8 || y != 0) {
+        return false;
     }
-    chess->state = KGCHESS_STATE_ENDED;
+    it++;
+
+    if (*it == 'w') {
+        position->current_player = KGCHESS_PLAYER_WHITE;
+    } else if (*it == 'b') {
+        position->current_player = KGCHESS_PLAYER_BLACK;
+    } else {
+        return false;
+    }
+    it++;
+    if (*it != ' ') {
+        return false;
+    }
+    it++;
+
+    position->castling_rights = 0;
+    if (*it == '-') {
+        it++;
+    } else {
+        for (; *it != ' ' && *it != '\0'; it++) {
+            switch (*it) {
+                case 'K': position->castling_rights |= 1; break;
+                case 'Q': position->castling_rights |= 2; break;
+                case 'k': position->castling_rights |= 4; break;
+                case 'q': position->castling_rights |= 8; break;
+                default: return false;
+            }
+        }
+    }
+    if (*it != ' ') {
+        return false;
+    }
+    it++;
+
+    position->en_passant_sq = -1;
+    if (*it == '-') {
+        it++;
+    } else {
+        if (it[0] < 'a' || it[0] > 'h' || (it[1] != '3' && it[1] != '6')) {
+            return false;
+        }
+        position->en_passant_sq = SQUARE(it[0] - 'a', it[1] - '1');
+        it += 2;
+    }
+
+    position->halfmove_clock = 0;
+    position->fullmove_num = 1;
+    while (*it == ' ') {
+        it++;
+    }
+    if (*it >= '0' && *it <= '9') {
+        it = parse_fen_number(it, &position->halfmove_clock);
+        while (*it == ' ') {
+            it++;
+        }
+        if (*it >= '0' && *it <= '9') {
+            parse_fen_number(it, &position->fullmove_num);
+        }
+    }
+    if (position->fullmove_num < 1) {
+        position->fullmove_num = 1;
+    }
+    return true;
 }
 
-static kgchess_piece_t convert_piece(kgchess_piece_internal_t piece) {
-    kgchess_piece_t res;
-    res.player = piece.player;
-    res.type = piece.type;
-    return res;
+static const char* parse_fen_number(const char *it, int *out) {
+    int value = 0;
+    while (*it >= '0' && *it <= '9' && value < 100000) {
+        value = value * 10 + (*it - '0');
+        it++;
+    }
+    *out = value;
+    return it;
 }
 
-static kgchess_moves_array_t get_moves(const kgchess_t *chess, int x, int y, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_piece_t piece = kgchess_get_piece_at(chess, x, y);
-    switch (piece.type) {
-        case KGCHESS_PIECE_KING:   return get_king_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        case KGCHESS_PIECE_QUEEN:  return get_queen_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        case KGCHESS_PIECE_BISHOP: return get_bishop_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        case KGCHESS_PIECE_KNIGHT: return get_knight_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        case KGCHESS_PIECE_ROOK:   return get_rook_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        case KGCHESS_PIECE_PAWN:   return get_pawn_moves(chess, x, y, piece, add_potential_attacks, is_attacks_check);
-        default: break;
+// Piece as encoded in kgchess_t.squares, 0 if c isn't a piece.
+static uint8_t get_fen_piece_square(char c) {
+    const uint8_t white = KGCHESS_PLAYER_WHITE << 3;
+    const uint8_t black = KGCHESS_PLAYER_BLACK << 3;
+    switch (c) {
+        case 'K': return KGCHESS_PIECE_KING | white;
+        case 'Q': return KGCHESS_PIECE_QUEEN | white;
+        case 'B': return KGCHESS_PIECE_BISHOP | white;
+        case 'N': return KGCHESS_PIECE_KNIGHT | white;
+        case 'R': return KGCHESS_PIECE_ROOK | white;
+        case 'P': return KGCHESS_PIECE_PAWN | white;
+        case 'k': return KGCHESS_PIECE_KING | black;
+        case 'q': return KGCHESS_PIECE_QUEEN | black;
+        case 'b': return KGCHESS_PIECE_BISHOP | black;
+        case 'n': return KGCHESS_PIECE_KNIGHT | black;
+        case 'r': return KGCHESS_PIECE_ROOK | black;
+        case 'p': return KGCHESS_PIECE_PAWN | black;
+        default:  return 0;
     }
-    return kgchess_moves_array_make_empty();
 }
 
-static kgchess_moves_array_t get_king_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
+static int write_fen_number(char *out, int value) {
+    char digits[12];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (int i = 0; i < count; i++) {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
+}
 
-    add_move_range(chess, &moves, x, y, piece, 0, +1, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, 0, -1, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, 0, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, 0, 1, add_potential_attacks, is_attacks_check);
+// Castling rights become unmoved kings and rooks and an en passant square becomes the last move,
+// rights and squares that don't match the pieces on the board are dropped.
+static void set_position(kgchess_t *chess, const fen_position_t *position) {
+    memset(chess->type_bbs, 0, sizeof(chess->type_bbs));
+    memset(chess->player_bbs, 0, sizeof(chess->player_bbs));
+    memcpy(chess->squares, position->squares, sizeof(chess->squares));
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t square = position->squares[sq];
+        if (square != 0) {
+            chess->type_bbs[square & 7] |= SQUARE_BIT(sq);
+            chess->player_bbs[square >> 3] |= SQUARE_BIT(sq);
+        }
+    }
 
-    add_move_range(chess, &moves, x, y, piece, +1, +1, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, -1, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, +1, 1, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, -1, 1, add_potential_attacks, is_attacks_check);
+    const uint8_t white_king = KGCHESS_PIECE_KING | (KGCHESS_PLAYER_WHITE << 3);
+    const uint8_t white_rook = KGCHESS_PIECE_ROOK | (KGCHESS_PLAYER_WHITE << 3);
+    const uint8_t black_king = KGCHESS_PIECE_KING | (KGCHESS_PLAYER_BLACK << 3);
+    const uint8_t black_rook = KGCHESS_PIECE_ROOK | (KGCHESS_PLAYER_BLACK << 3);
+    const int castling_king_sqs[4] = { SQUARE(4, 0), SQUARE(4, 0), SQUARE(4, 7), SQUARE(4, 7) };
+    const int castling_rook_sqs[4] = { SQUARE(7, 0), SQUARE(0, 0), SQUARE(7, 7), SQUARE(0, 7) };
+    const uint8_t castling_kings[4] = { white_king, white_king, black_king, black_king };
+    const uint8_t castling_rooks[4] = { white_rook, white_rook, black_rook, black_rook };
+    chess->unmoved_bb = 0;
+    for (int i = 0; i < 4; i++) {
+        if ((position->castling_rights & (1 << i))
+            && chess->squares[castling_king_sqs[i]] == castling_kings[i]
+            && chess->squares[castling_rook_sqs[i]] == castling_rooks[i]) {
+            chess->unmoved_bb |= SQUARE_BIT(castling_king_sqs[i]) | SQUARE_BIT(castling_rook_sqs[i]);
+        }
+    }
 
-    if (!is_attacks_check && is_castling_possible(chess, x, y, 0)) {
-        kgchess_move_t move = move_make(x, y, 2, y, false, true, false);
-        add_move_if_legal(chess, &moves, move, false);
+    chess->current_player = position->current_player;
+    chess->move_num = (position->fullmove_num - 1) * 2 + (position->current_player == KGCHESS_PLAYER_BLACK ? 1 : 0);
+    chess->last_move = move_make(-1, -1, -1, -1, false, false, false);
+    int en_passant_sq = position->en_passant_sq;
+    if (en_passant_sq != -1) {
+        int x = SQUARE_X(en_passant_sq);
+        int y = SQUARE_Y(en_passant_sq);
+        kgchess_player_t pawn_player = y == 2 ? KGCHESS_PLAYER_WHITE : KGCHESS_PLAYER_BLACK;
+        int dy = pawn_player == KGCHESS_PLAYER_WHITE ? 1 : -1;
+        uint8_t pawn = KGCHESS_PIECE_PAWN | (pawn_player << 3);
+        if (pawn_player != position->current_player
+            && chess->squares[SQUARE(x, y + dy)] == pawn
+            && chess->squares[en_passant_sq] == 0
+            && chess->squares[SQUARE(x, y - dy)] == 0) {
+            chess->last_move = move_make(x, y - dy, x, y + dy, false, false, false);
+            if (chess->move_num < 1) {
+                chess->move_num = 1;
+            }
+        }
     }
-    if (!is_attacks_check && is_castling_possible(chess, x, y, 7)) {
-        kgchess_move_t move = move_make(x, y, 6, y, false, true, false);
-        add_move_if_legal(chess, &moves, move, false);
+
+    chess->state = KGCHESS_STATE_MOVE;
+    chess->promotion_pos = KGCHESS_POS_INVALID;
+    chess->winner = KGCHESS_PLAYER_NONE;
+    chess->is_end_checked = false;
+    chess->end_reason = KGCHESS_END_NONE;
+    chess->halfmove_clock = position->halfmove_clock;
+    chess->repetition_plies = 0;
+    chess->undo_count = 0;
+    chess->hash = compute_hash(chess);
+    record_hash(chess);
+    compute_eval(chess);
+    compute_attacks(chess);
+}
+
+// Square a pawn skipped over with its last move, the one written as en passant square in FEN, -1 if there's none.
+static int get_double_push_sq(const kgchess_t *chess) {
+    if (chess->move_num <= 0) {
+        return -1;
+    }
+    kgchess_move_t last_move = chess->last_move;
+    if (!is_pos_valid(last_move.to) || !is_pos_valid(last_move.from) || abs(last_move.to.y - last_move.from.y) != 2) {
+        return -1;
+    }
+    if (get_piece_at(chess, last_move.to.x, last_move.to.y).type != KGCHESS_PIECE_PAWN) {
+        return -1;
     }
+    return SQUARE(last_move.to.x, (last_move.to.y + last_move.from.y) / 2);
+}
 
-    return moves;
+// Checkmate and stalemate are only looked for when state or winner is asked for, most moves made
+// (e.g. when replaying games or searching) never need it.
+static void update_game_end(kgchess_t *chess) {
+    if (chess->is_end_checked) {
+        return;
+    }
+    chess->is_end_checked = true;
+    if (chess->state != KGCHESS_STATE_MOVE) {
+        return;
+    }
+    STATS_BEGIN(KGCHESS_STAT_GAME_END);
+    if (!has_legal_moves(chess)) {
+        chess->end_reason = KGCHESS_END_STALEMATE;
+        if (is_in_check(chess, chess->current_player)) {
+            chess->winner = kgchess_get_enemy_player(chess->current_player);
+            chess->end_reason = KGCHESS_END_CHECKMATE;
+        }
+        chess->state = KGCHESS_STATE_ENDED;
+    } else {
+        kgchess_end_reason_t draw_reason = get_draw_reason(chess, 2);
+        if (draw_reason != KGCHESS_END_NONE) {
+            chess->end_reason = draw_reason;
+            chess->state = KGCHESS_STATE_ENDED;
+        }
+    }
+    STATS_END(KGCHESS_STAT_GAME_END);
 }
 
-static kgchess_moves_array_t get_queen_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
+// Checks draws that don't depend on legal moves, repetitions_count is how many times the position has to have
+// occurred before.
+static kgchess_end_reason_t get_draw_reason(const kgchess_t *chess, int repetitions_count) {
+    if (chess->halfmove_clock >= FIFTY_MOVES_PLIES) {
+        return KGCHESS_END_FIFTY_MOVES;
+    }
+    if (get_repetitions_count(chess, repetitions_count) >= repetitions_count) {
+        return KGCHESS_END_REPETITION;
+    }
+    if (is_material_insufficient(chess)) {
+        return KGCHESS_END_INSUFFICIENT_MATERIAL;
+    }
+    return KGCHESS_END_NONE;
+}
 
-    add_move_range(chess, &moves, x, y, piece, 0, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, 0, -1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, 0, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, 0, 7, add_potential_attacks, is_attacks_check);
+static bool is_draw_by_rules(kgchess_end_reason_t end_reason) {
+    return end_reason == KGCHESS_END_REPETITION || end_reason == KGCHESS_END_FIFTY_MOVES
+        || end_reason == KGCHESS_END_INSUFFICIENT_MATERIAL;
+}
 
-    add_move_range(chess, &moves, x, y, piece, +1, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, -1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, -1, 7, add_potential_attacks, is_attacks_check);
+// Only positions with the same player to move can repeat, so every other ply is compared, starting 4 plies back.
+static int get_repetitions_count(const kgchess_t *chess, int max_count) {
+    if (!chess->hash_history) {
+        return 0;
+    }
+    int plies = chess->repetition_plies < HASH_HISTORY_SIZE ? chess->repetition_plies : HASH_HISTORY_SIZE - 1;
+    int count = 0;
+    for (int i = 4; i <= plies && count < max_count; i += 2) {
+        if (chess->hash_history[(chess->move_num - i) % HASH_HISTORY_SIZE] == chess->hash) {
+            count++;
+        }
+    }
+    return count;
+}
 
-    return moves;
+// King against king with at most one minor piece, or with bishops all on squares of one color.
+static bool is_material_insufficient(const kgchess_t *chess) {
+    const uint64_t *types = chess->type_bbs;
+    if (types[KGCHESS_PIECE_PAWN] | types[KGCHESS_PIECE_ROOK] | types[KGCHESS_PIECE_QUEEN]) {
+        return false;
+    }
+    uint64_t minors = types[KGCHESS_PIECE_KNIGHT] | types[KGCHESS_PIECE_BISHOP];
+    if (bb_count(minors) <= 1) {
+        return true;
+    }
+    uint64_t bishops = types[KGCHESS_PIECE_BISHOP];
+    return types[KGCHESS_PIECE_KNIGHT] == 0 && ((bishops & DARK_SQUARES) == 0 || (bishops & ~DARK_SQUARES) == 0);
 }
 
-static kgchess_moves_array_t get_bishop_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
+// Stops at the first piece with a legal move, starting with the king, which is the only candidate in a double check.
+static bool has_legal_moves(const kgchess_t *chess) {
+    legality_t legality = get_legality(chess, chess->current_player);
+    uint64_t pieces = chess->player_bbs[chess->current_player];
+    if (legality.king_sq != -1) {
+        moves_list_t moves = moves_list_make(NULL, 0);
+        get_moves(chess, &legality, legality.king_sq, &moves);
+        if (moves.count != 0) {
+            return true;
+        }
+        if (legality.check_mask == 0) {
+            return false;
+        }
+        pieces &= ~SQUARE_BIT(legality.king_sq);
+    }
+    while (pieces) {
+        moves_list_t moves = moves_list_make(NULL, 0);
+        get_moves(chess, &legality, bb_pop_lsb(&pieces), &moves);
+        if (moves.count != 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    add_move_range(chess, &moves, x, y, piece, +1, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, -1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, -1, 7, add_potential_attacks, is_attacks_check);
+static void get_moves(const kgchess_t *chess, const legality_t *legality, int sq, moves_list_t *moves) {
+    STATS_BEGIN(KGCHESS_STAT_GET_MOVES);
+    kgchess_piece_t piece = get_square_piece(chess, sq);
+    switch (piece.type) {
+        case KGCHESS_PIECE_KING:   get_king_moves(chess, legality, sq, piece, moves); break;
+        case KGCHESS_PIECE_QUEEN:  get_queen_moves(chess, legality, sq, piece, moves); break;
+        case KGCHESS_PIECE_BISHOP: get_bishop_moves(chess, legality, sq, piece, moves); break;
+        case KGCHESS_PIECE_KNIGHT: get_knight_moves(chess, legality, sq, piece, moves); break;
+        case KGCHESS_PIECE_ROOK:   get_rook_moves(chess, legality, sq, piece, moves); break;
+        case KGCHESS_PIECE_PAWN:   get_pawn_moves(chess, legality, sq, piece, moves); break;
+        default: break;
+    }
+    STATS_END(KGCHESS_STAT_GET_MOVES);
+}
 
-    return moves;
+// Pieces are visited file by file (a1, a2, ..., h8), same as iterating with kgchess_get_moves over x and then y.
+static void get_player_moves(const kgchess_t *chess, kgchess_player_t player, moves_list_t *moves) {
+    const uint64_t file_a = 0x0101010101010101ULL;
+    legality_t legality = get_legality(chess, player);
+    uint64_t player_bb = chess->player_bbs[player];
+    for (int x = 0; x < 8; x++) {
+        uint64_t pieces = player_bb & (file_a << x);
+        while (pieces) {
+            get_moves(chess, &legality, bb_pop_lsb(&pieces), moves);
+        }
+    }
 }
 
-static kgchess_moves_array_t get_knight_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
-    kgchess_player_t enemy = kgchess_get_enemy_player(piece.player);
-    kgchess_pos_t positions_to_check[] = {
-        { x + 2, y + 1 },
-        { x + 2, y - 1 },
-        { x - 2, y + 1 },
-        { x - 2, y - 1 },
+static void get_king_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    int x = SQUARE_X(sq);
+    int y = SQUARE_Y(sq);
+    for (int dir = 0; dir < 8; dir++) {
+        add_direction_moves(chess, legality, moves, sq, piece, king_attacks[sq], dir);
+    }
 
-        { x + 1, y + 2 },
-        { x + 1, y - 2 },
-        { x - 1, y + 2 },
-        { x - 1, y - 2 },
-    };
+    if (moves->is_captures_only) {
+        return;
+    }
+    if (is_castling_possible(chess, x, y, 0)) {
+        kgchess_move_t move = move_make(x, y, 2, y, false, true, false);
+        add_move_if_legal(chess, legality, moves, move);
+    }
+    if (is_castling_possible(chess, x, y, 7)) {
+        kgchess_move_t move = move_make(x, y, 6, y, false, true, false);
+        add_move_if_legal(chess, legality, moves, move);
+    }
+}
 
-    for (int i = 0; i < ARRAY_LENGTH(positions_to_check); i++) {
-        kgchess_pos_t pos = positions_to_check[i];
-        kgchess_piece_t temp_piece = kgchess_get_piece_at(chess, pos.x, pos.y);
-        if (temp_piece.type == KGCHESS_PIECE_NONE && (!is_attacks_check || add_potential_attacks)) {
-            kgchess_move_t move = move_make(x, y, pos.x, pos.y, add_potential_attacks, false, false);
-            add_move_if_legal(chess, &moves, move, is_attacks_check);
-        } else if (temp_piece.player == enemy) {
-            kgchess_move_t move = move_make(x, y, pos.x, pos.y, true, false, false);
-            add_move_if_legal(chess, &moves, move, is_attacks_check);
-        }
+static void get_queen_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    uint64_t occupied = get_occupied(chess);
+    uint64_t attacks = get_rook_attacks(sq, occupied) | get_bishop_attacks(sq, occupied);
+    for (int dir = 0; dir < 8; dir++) {
+        add_direction_moves(chess, legality, moves, sq, piece, attacks, dir);
     }
-    return moves;
 }
 
-static kgchess_moves_array_t get_rook_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
+static void get_bishop_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    uint64_t attacks = get_bishop_attacks(sq, get_occupied(chess));
+    for (int i = 0; i < ARRAY_LENGTH(BISHOP_DIRECTIONS); i++) {
+        add_direction_moves(chess, legality, moves, sq, piece, attacks, BISHOP_DIRECTIONS[i]);
+    }
+}
 
-    add_move_range(chess, &moves, x, y, piece, 0, +1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, 0, -1, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, -1, 0, 7, add_potential_attacks, is_attacks_check);
-    add_move_range(chess, &moves, x, y, piece, +1, 0, 7, add_potential_attacks, is_attacks_check);
+static void get_knight_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    int x = SQUARE_X(sq);
+    int y = SQUARE_Y(sq);
+    uint64_t player_bb = chess->player_bbs[piece.player];
+    uint64_t enemy_bb = chess->player_bbs[kgchess_get_enemy_player(piece.player)];
+    for (int i = 0; i < ARRAY_LENGTH(KNIGHT_DX); i++) {
+        int to_x = x + KNIGHT_DX[i];
+        int to_y = y + KNIGHT_DY[i];
+        if (to_x < 0 || to_x >= 8 || to_y < 0 || to_y >= 8) {
+            continue;
+        }
+        uint64_t to_bit = SQUARE_BIT(SQUARE(to_x, to_y));
+        if ((player_bb & to_bit) || (moves->is_captures_only && !(enemy_bb & to_bit))) {
+            continue;
+        }
+        kgchess_move_t move = move_make(x, y, to_x, to_y, (enemy_bb & to_bit) != 0, false, false);
+        add_move_if_legal(chess, legality, moves, move);
+    }
+}
 
-    return moves;
+static void get_rook_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    uint64_t attacks = get_rook_attacks(sq, get_occupied(chess));
+    for (int i = 0; i < ARRAY_LENGTH(ROOK_DIRECTIONS); i++) {
+        add_direction_moves(chess, legality, moves, sq, piece, attacks, ROOK_DIRECTIONS[i]);
+    }
 }
 
-static kgchess_moves_array_t get_pawn_moves(const kgchess_t *chess, int x, int y, kgchess_piece_t piece, bool add_potential_attacks, bool is_attacks_check) {
-    kgchess_moves_array_t moves = kgchess_moves_array_make_empty();
+static void get_pawn_moves(const kgchess_t *chess, const legality_t *legality, int sq, kgchess_piece_t piece, moves_list_t *moves) {
+    int x = SQUARE_X(sq);
+    int y = SQUARE_Y(sq);
     int dir = 1;
     int initial_y = 1;
     if (piece.player == KGCHESS_PLAYER_BLACK) {
         dir = -1;
         initial_y = 6;
     }
-    if (!is_attacks_check && is_position_empty(chess, x, y + 1 * dir)) {
-        kgchess_move_t move = move_make(x, y, x, y + 1 * dir, false, false, false);
-        add_move_if_legal(chess, &moves, move, is_attacks_check);
-        if (y == initial_y && is_position_empty(chess, x, y + 2 * dir)) {
+    int to_y = y + dir;
+    if (to_y < 0 || to_y >= 8) {
+        return;
+    }
+    uint64_t occupied = get_occupied(chess);
+    bool is_promotion = to_y == 0 || to_y == 7;
+    if ((!moves->is_captures_only || is_promotion) && !(occupied & SQUARE_BIT(SQUARE(x, to_y)))) {
+        kgchess_move_t move = move_make(x, y, x, to_y, false, false, false);
+        add_move_if_legal(chess, legality, moves, move);
+        if (!moves->is_captures_only && y == initial_y && !(occupied & SQUARE_BIT(SQUARE(x, y + 2 * dir)))) {
             kgchess_move_t move = move_make(x, y, x, y + 2 * dir, false, false, false);
-            add_move_if_legal(chess, &moves, move, is_attacks_check);
+            add_move_if_legal(chess, legality, moves, move);
         }
     }
-    kgchess_player_t enemy = kgchess_get_enemy_player(piece.player);
-    if (add_potential_attacks || is_player_at_position(chess, enemy, x + 1, y + 1 * dir)) {
-        kgchess_move_t move = move_make(x, y, x + 1, y + 1 * dir, true, false, false);
-        add_move_if_legal(chess, &moves, move, is_attacks_check);
+    uint64_t enemy_bb = chess->player_bbs[kgchess_get_enemy_player(piece.player)];
+    if (x + 1 < 8 && (enemy_bb & SQUARE_BIT(SQUARE(x + 1, to_y)))) {
+        kgchess_move_t move = move_make(x, y, x + 1, to_y, true, false, false);
+        add_move_if_legal(chess, legality, moves, move);
     }
-    if (add_potential_attacks || is_player_at_position(chess, enemy, x - 1, y + 1 * dir)) {
-        kgchess_move_t move = move_make(x, y, x - 1, y + 1 * dir, true, false, false);
-        add_move_if_legal(chess, &moves, move, is_attacks_check);
+    if (x - 1 >= 0 && (enemy_bb & SQUARE_BIT(SQUARE(x - 1, to_y)))) {
+        kgchess_move_t move = move_make(x, y, x - 1, to_y, true, false, false);
+        add_move_if_legal(chess, legality, moves, move);
     }
 
-    if (!add_potential_attacks && !is_attacks_check) {
-        int en_passant_x = get_en_passant(chess, x, y, piece);
-        if (en_passant_x != -1) {
-            kgchess_move_t move = move_make(x, y, en_passant_x, y + dir, true, false, true);
-            add_move_if_legal(chess, &moves, move, is_attacks_check);
+    int en_passant_x = get_en_passant(chess, x, y, piece);
+    if (en_passant_x != -1) {
+        kgchess_move_t move = move_make(x, y, en_passant_x, to_y, true, false, true);
+        add_move_if_legal(chess, legality, moves, move);
+    }
+}
+
+// Adds moves along one direction in the same order as walking the ray from the piece outwards.
+static void add_direction_moves(const kgchess_t *chess, const legality_t *legality, moves_list_t *moves, int sq,
+                                kgchess_piece_t piece, uint64_t attacks, direction_t direction)
+{
+    uint64_t targets = attacks & ray_masks[direction][sq] & ~chess->player_bbs[piece.player];
+    uint64_t enemy_bb = chess->player_bbs[kgchess_get_enemy_player(piece.player)];
+    if (moves->is_captures_only) {
+        targets &= enemy_bb;
+    }
+    while (targets) {
+        int to = DIRECTION_IS_ASCENDING[direction] ? bb_pop_lsb(&targets) : bb_pop_msb(&targets);
+        bool is_attack = (enemy_bb & SQUARE_BIT(to)) != 0;
+        kgchess_move_t move = move_make(SQUARE_X(sq), SQUARE_Y(sq), SQUARE_X(to), SQUARE_Y(to), is_attack, false, false);
+        add_move_if_legal(chess, legality, moves, move);
+    }
+}
 
+static void init_tables() {
+    if (atomic_load_explicit(&tables_state, memory_order_acquire) == TABLES_READY) {
+        return;
+    }
+    int expected = TABLES_EMPTY;
+    if (!atomic_compare_exchange_strong_explicit(&tables_state, &expected, TABLES_FILLING,
+                                                 memory_order_acquire, memory_order_acquire)) {
+        while (atomic_load_explicit(&tables_state, memory_order_acquire) != TABLES_READY) {
+            yield_thread();
         }
+        return;
     }
 
-    return moves;
+    for (int sq = 0; sq < 64; sq++) {
+        int x = SQUARE_X(sq);
+        int y = SQUARE_Y(sq);
+        for (int dir = 0; dir < 8; dir++) {
+            uint64_t ray = 0;
+            for (int i = 1; i < 8; i++) {
+                int ray_x = x + i * DIRECTION_DX[dir];
+                int ray_y = y + i * DIRECTION_DY[dir];
+                if (ray_x < 0 || ray_x >= 8 || ray_y < 0 || ray_y >= 8) {
+                    break;
+                }
+                ray |= SQUARE_BIT(SQUARE(ray_x, ray_y));
+                if (i == 1) {
+                    king_attacks[sq] |= SQUARE_BIT(SQUARE(ray_x, ray_y));
+                }
+            }
+            ray_masks[dir][sq] = ray;
+        }
+        for (int i = 0; i < ARRAY_LENGTH(KNIGHT_DX); i++) {
+            int to_x = x + KNIGHT_DX[i];
+            int to_y = y + KNIGHT_DY[i];
+            if (to_x >= 0 && to_x < 8 && to_y >= 0 && to_y < 8) {
+                knight_attacks[sq] |= SQUARE_BIT(SQUARE(to_x, to_y));
+            }
+        }
+        for (int dx = -1; dx <= 1; dx += 2) {
+            if (x + dx < 0 || x + dx >= 8) {
+                continue;
+            }
+            if (y + 1 < 8) {
+                pawn_attacks[KGCHESS_PLAYER_WHITE][sq] |= SQUARE_BIT(SQUARE(x + dx, y + 1));
+            }
+            if (y - 1 >= 0) {
+                pawn_attacks[KGCHESS_PLAYER_BLACK][sq] |= SQUARE_BIT(SQUARE(x + dx, y - 1));
+            }
+        }
+    }
+
+    for (int sq = 0; sq < 64; sq++) {
+        for (int dir = 0; dir < 8; dir++) {
+            int opposite_dir = dir ^ 1;
+            uint64_t line = ray_masks[dir][sq] | ray_masks[opposite_dir][sq] | SQUARE_BIT(sq);
+            uint64_t ray = ray_masks[dir][sq];
+            while (ray) {
+                int to = bb_pop_lsb(&ray);
+                between_masks[sq][to] = ray_masks[dir][sq] & ray_masks[opposite_dir][to];
+                line_masks[sq][to] = line;
+            }
+        }
+    }
+
+    uint64_t *table = slider_attacks;
+    init_magics(rook_magics, ROOK_MAGIC_NUMBERS, ROOK_DIRECTIONS, &table);
+    init_magics(bishop_magics, BISHOP_MAGIC_NUMBERS, BISHOP_DIRECTIONS, &table);
+
+    init_zobrist();
+    init_eval(&DEFAULT_EVAL_WEIGHTS);
+    init_start_position(&start_position);
+
+    atomic_store_explicit(&tables_state, TABLES_READY, memory_order_release);
 }
 
-static void add_move_range(const kgchess_t *chess, kgchess_moves_array_t *moves, int x, int y,
-                           kgchess_piece_t piece, int dx, int dy,
-                           int end, bool add_potential_attacks, bool is_attacks_check)
-{
-    for (int i = 1; i < (end + 1); i++) {
-        kgchess_piece_t temp_piece = kgchess_get_piece_at(chess, x + i * dx, y + i * dy);
-        if (temp_piece.type == KGCHESS_PIECE_NONE && (!is_attacks_check || add_potential_attacks)) {
-            kgchess_move_t move = move_make(x, y, x + i * dx, y + i * dy, add_potential_attacks, false, false);
-            add_move_if_legal(chess, moves, move, is_attacks_check);
-        } else if (temp_piece.player == kgchess_get_enemy_player(piece.player)) {
-            kgchess_move_t move = move_make(x, y, x + i * dx, y + i * dy, true, false, false);
-            add_move_if_legal(chess, moves, move, is_attacks_check);
-            break;
-        } else if (temp_piece.player == piece.player) {
-            break;
+static void init_start_position(kgchess_t *chess) {
+    memset(chess, 0, sizeof(kgchess_t));
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_WHITE), 0, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_WHITE), 1, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_WHITE), 2, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_QUEEN,  KGCHESS_PLAYER_WHITE), 3, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KING,   KGCHESS_PLAYER_WHITE), 4, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_WHITE), 5, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_WHITE), 6, 0);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_WHITE), 7, 0);
+
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 0, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 1, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 2, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 3, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 4, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 5, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 6, 1);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_WHITE), 7, 1);
+
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_BLACK), 0, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_BLACK), 1, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_BLACK), 2, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_QUEEN,  KGCHESS_PLAYER_BLACK), 3, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KING,   KGCHESS_PLAYER_BLACK), 4, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_BISHOP, KGCHESS_PLAYER_BLACK), 5, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_KNIGHT, KGCHESS_PLAYER_BLACK), 6, 7);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_ROOK,   KGCHESS_PLAYER_BLACK), 7, 7);
+
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 0, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 1, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 2, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 3, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 4, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 5, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 6, 6);
+    set_piece_at(chess, piece_make(KGCHESS_PIECE_PAWN, KGCHESS_PLAYER_BLACK), 7, 6);
+
+    chess->unmoved_bb = get_occupied(chess);
+    chess->current_player = KGCHESS_PLAYER_WHITE;
+    chess->move_num = 0;
+    chess->state = KGCHESS_STATE_MOVE;
+    chess->promotion_pos = KGCHESS_POS_INVALID;
+    chess->winner = KGCHESS_PLAYER_NONE;
+    chess->is_end_checked = true;
+    chess->hash = compute_hash(chess);
+    compute_attacks(chess);
+}
+
+static void init_zobrist() {
+    uint64_t seed = 0x6b676368657373ULL;
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        for (int type = KGCHESS_PIECE_KING; type <= KGCHESS_PIECE_PAWN; type++) {
+            for (int sq = 0; sq < 64; sq++) {
+                zobrist_pieces[player][type][sq] = splitmix64(&seed);
+            }
+        }
+    }
+    // Castling keys are combined from one key per right, so that losing a right flips a fixed set of bits.
+    uint64_t castling_right_keys[4];
+    for (int i = 0; i < 4; i++) {
+        castling_right_keys[i] = splitmix64(&seed);
+    }
+    for (int rights = 0; rights < 16; rights++) {
+        zobrist_castling[rights] = 0;
+        for (int i = 0; i < 4; i++) {
+            if (rights & (1 << i)) {
+                zobrist_castling[rights] ^= castling_right_keys[i];
+            }
+        }
+    }
+    for (int file = 0; file < 8; file++) {
+        zobrist_en_passant[file] = splitmix64(&seed);
+    }
+    zobrist_black_to_move = splitmix64(&seed);
+}
+
+static void init_eval(const kgchess_eval_weights_t *weights) {
+    eval_weights = *weights;
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        int sign = player == KGCHESS_PLAYER_WHITE ? 1 : -1;
+        for (int type = KGCHESS_PIECE_KING; type <= KGCHESS_PIECE_PAWN; type++) {
+            for (int sq = 0; sq < 64; sq++) {
+                int table_sq = player == KGCHESS_PLAYER_WHITE ? sq ^ 56 : sq; // tables have a8 first
+                eval_scores[0][player][type][sq] = sign * (weights->mg_values[type] + weights->mg_tables[type][table_sq]);
+                eval_scores[1][player][type][sq] = sign * (weights->eg_values[type] + weights->eg_tables[type][table_sq]);
+            }
+        }
+    }
+    const int16_t *phases = weights->phase_weights;
+    eval_max_phase = 2 * (phases[KGCHESS_PIECE_KING] + phases[KGCHESS_PIECE_QUEEN] + 2 * phases[KGCHESS_PIECE_BISHOP]
+                          + 2 * phases[KGCHESS_PIECE_KNIGHT] + 2 * phases[KGCHESS_PIECE_ROOK] + 8 * phases[KGCHESS_PIECE_PAWN]);
+}
+
+static void lock_eval_weights() {
+    while (atomic_flag_test_and_set_explicit(&eval_weights_lock, memory_order_acquire)) {
+        yield_thread();
+    }
+}
+
+static void unlock_eval_weights() {
+    atomic_flag_clear_explicit(&eval_weights_lock, memory_order_release);
+}
+
+// Waiting threads give up the CPU, the thread they wait for may need it to finish (tables take milliseconds to fill).
+static void yield_thread() {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void init_magics(magic_t *magics, const uint64_t *magic_numbers, const direction_t *directions, uint64_t **table) {
+    const uint64_t rank_1 = 0xffULL;
+    const uint64_t rank_8 = rank_1 << 56;
+    const uint64_t file_a = 0x0101010101010101ULL;
+    const uint64_t file_h = file_a << 7;
+    for (int sq = 0; sq < 64; sq++) {
+        magic_t *magic = &magics[sq];
+        uint64_t edges = ((rank_1 | rank_8) & ~(rank_1 << (SQUARE_Y(sq) * 8)))
+                       | ((file_a | file_h) & ~(file_a << SQUARE_X(sq)));
+        magic->mask = get_ray_attacks(sq, 0, directions, 4) & ~edges;
+        magic->magic = magic_numbers[sq];
+        magic->shift = 64 - bb_count(magic->mask);
+        magic->attacks = *table;
+        uint64_t subset = 0;
+        do {
+            magic->attacks[get_magic_index(magic, subset)] = get_ray_attacks(sq, subset, directions, 4);
+            subset = (subset - magic->mask) & magic->mask;
+        } while (subset);
+        *table += 1ULL << bb_count(magic->mask);
+    }
+}
+
+static uint64_t get_ray_attacks(int sq, uint64_t occupied, const direction_t *directions, int directions_count) {
+    uint64_t attacks = 0;
+    for (int i = 0; i < directions_count; i++) {
+        direction_t dir = directions[i];
+        uint64_t ray = ray_masks[dir][sq];
+        uint64_t blockers = ray & occupied;
+        if (blockers) {
+            int blocker = DIRECTION_IS_ASCENDING[dir] ? bb_lsb(blockers) : bb_msb(blockers);
+            ray &= ~ray_masks[dir][blocker];
         }
+        attacks |= ray;
     }
+    return attacks;
+}
+
+static unsigned get_magic_index(const magic_t *magic, uint64_t occupied) {
+#ifdef KGCHESS_USE_PEXT
+    return (unsigned)_pext_u64(occupied, magic->mask);
+#else
+    return (unsigned)(((occupied & magic->mask) * magic->magic) >> magic->shift);
+#endif
+}
+
+static uint64_t get_rook_attacks(int sq, uint64_t occupied) {
+    const magic_t *magic = &rook_magics[sq];
+    return magic->attacks[get_magic_index(magic, occupied)];
+}
+
+static uint64_t get_bishop_attacks(int sq, uint64_t occupied) {
+    const magic_t *magic = &bishop_magics[sq];
+    return magic->attacks[get_magic_index(magic, occupied)];
+}
+
+static uint64_t get_attackers(const kgchess_t *chess, int sq, uint64_t occupied) {
+    const uint64_t *types = chess->type_bbs;
+    const uint64_t *players = chess->player_bbs;
+    return (pawn_attacks[KGCHESS_PLAYER_BLACK][sq] & types[KGCHESS_PIECE_PAWN] & players[KGCHESS_PLAYER_WHITE])
+         | (pawn_attacks[KGCHESS_PLAYER_WHITE][sq] & types[KGCHESS_PIECE_PAWN] & players[KGCHESS_PLAYER_BLACK])
+         | (knight_attacks[sq] & types[KGCHESS_PIECE_KNIGHT])
+         | (king_attacks[sq] & types[KGCHESS_PIECE_KING])
+         | (get_bishop_attacks(sq, occupied) & (types[KGCHESS_PIECE_BISHOP] | types[KGCHESS_PIECE_QUEEN]))
+         | (get_rook_attacks(sq, occupied) & (types[KGCHESS_PIECE_ROOK] | types[KGCHESS_PIECE_QUEEN]));
+}
+
+static uint64_t get_piece_attacks(const kgchess_t *chess, int sq, uint64_t occupied) {
+    uint8_t square = chess->squares[sq];
+    switch (square & 7) {
+        case KGCHESS_PIECE_KING:   return king_attacks[sq];
+        case KGCHESS_PIECE_QUEEN:  return get_rook_attacks(sq, occupied) | get_bishop_attacks(sq, occupied);
+        case KGCHESS_PIECE_BISHOP: return get_bishop_attacks(sq, occupied);
+        case KGCHESS_PIECE_KNIGHT: return knight_attacks[sq];
+        case KGCHESS_PIECE_ROOK:   return get_rook_attacks(sq, occupied);
+        case KGCHESS_PIECE_PAWN:   return pawn_attacks[square >> 3][sq];
+        default:                   return 0;
+    }
+}
+
+static void compute_attacks(kgchess_t *chess) {
+    memset(chess->attack_counts, 0, sizeof(chess->attack_counts));
+    uint64_t occupied = get_occupied(chess);
+    uint64_t pieces = occupied;
+    while (pieces) {
+        int sq = bb_pop_lsb(&pieces);
+        add_attacks(chess, chess->squares[sq] >> 3, get_piece_attacks(chess, sq, occupied));
+    }
+}
+
+// Attack maps are updated around every change of the board: attacks of pieces on changed squares
+// and of sliders seeing them are removed before the change and added back after it.
+static uint64_t begin_attacks_update(kgchess_t *chess, uint64_t changed) {
+    uint64_t occupied = get_occupied(chess);
+    uint64_t sources = get_attack_sources(chess, changed);
+    uint64_t it = sources;
+    while (it) {
+        int sq = bb_pop_lsb(&it);
+        remove_attacks(chess, chess->squares[sq] >> 3, get_piece_attacks(chess, sq, occupied));
+    }
+    return sources;
+}
+
+// Sliders that saw a changed square before the change are still in place, so they're added back too.
+static void end_attacks_update(kgchess_t *chess, uint64_t changed, uint64_t sources) {
+    uint64_t occupied = get_occupied(chess);
+    uint64_t it = get_attack_sources(chess, changed) | (sources & ~changed);
+    while (it) {
+        int sq = bb_pop_lsb(&it);
+        add_attacks(chess, chess->squares[sq] >> 3, get_piece_attacks(chess, sq, occupied));
+    }
+}
+
+// Pieces whose attacks depend on the changed squares: the ones standing on them and sliders attacking them.
+static uint64_t get_attack_sources(const kgchess_t *chess, uint64_t changed) {
+    const uint64_t *types = chess->type_bbs;
+    uint64_t occupied = get_occupied(chess);
+    uint64_t diagonal = types[KGCHESS_PIECE_BISHOP] | types[KGCHESS_PIECE_QUEEN];
+    uint64_t straight = types[KGCHESS_PIECE_ROOK] | types[KGCHESS_PIECE_QUEEN];
+    uint64_t sources = changed & occupied;
+    while (changed) {
+        int sq = bb_pop_lsb(&changed);
+        sources |= get_bishop_attacks(sq, occupied) & diagonal;
+        sources |= get_rook_attacks(sq, occupied) & straight;
+    }
+    return sources;
+}
+
+// Counts are bit-sliced: a ripple-carry adder over ATTACK_COUNT_BITS bitboards counts all 64 squares at once.
+static void add_attacks(kgchess_t *chess, kgchess_player_t player, uint64_t attacks) {
+    uint64_t *counts = chess->attack_counts[player];
+    uint64_t carry = attacks;
+    for (int i = 0; i < ATTACK_COUNT_BITS && carry; i++) {
+        uint64_t sum = counts[i] ^ carry;
+        carry &= counts[i];
+        counts[i] = sum;
+    }
+}
+
+static void remove_attacks(kgchess_t *chess, kgchess_player_t player, uint64_t attacks) {
+    uint64_t *counts = chess->attack_counts[player];
+    uint64_t borrow = attacks;
+    for (int i = 0; i < ATTACK_COUNT_BITS && borrow; i++) {
+        uint64_t difference = counts[i] ^ borrow;
+        borrow &= ~counts[i];
+        counts[i] = difference;
+    }
+}
+
+// Squares attacked by at least one piece of player (including squares of player's own pieces).
+static uint64_t get_attacked(const kgchess_t *chess, kgchess_player_t player) {
+    const uint64_t *counts = chess->attack_counts[player];
+    uint64_t attacked = 0;
+    for (int i = 0; i < ATTACK_COUNT_BITS; i++) {
+        attacked |= counts[i];
+    }
+    return attacked;
+}
+
+static int bb_count(uint64_t bb) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(bb);
+#else
+    int count = 0;
+    while (bb) {
+        bb &= bb - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static int bb_lsb(uint64_t bb) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bb);
+#else
+    int sq = 0;
+    while (!(bb & 1)) {
+        bb >>= 1;
+        sq++;
+    }
+    return sq;
+#endif
+}
+
+static int bb_msb(uint64_t bb) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(bb);
+#else
+    int sq = 63;
+    while (!(bb & SQUARE_BIT(63))) {
+        bb <<= 1;
+        sq--;
+    }
+    return sq;
+#endif
+}
+
+static int bb_pop_lsb(uint64_t *bb) {
+    int sq = bb_lsb(*bb);
+    *bb &= *bb - 1;
+    return sq;
+}
+
+static int bb_pop_msb(uint64_t *bb) {
+    int sq = bb_msb(*bb);
+    *bb &= ~SQUARE_BIT(sq);
+    return sq;
+}
+
+#ifdef KGCHESS_USE_STATS
+static void stats_add(kgchess_stat_t stat, uint64_t cycles) {
+    stats_block_t *block = thread_stats_block;
+    if (!block) {
+        block = make_thread_stats_block();
+        if (!block) {
+            return;
+        }
+    }
+    // No other thread increments these, so a plain load and store is enough (no locked instructions).
+    uint64_t calls = atomic_load_explicit(&block->calls[stat], memory_order_relaxed);
+    atomic_store_explicit(&block->calls[stat], calls + 1, memory_order_relaxed);
+    uint64_t total_cycles = atomic_load_explicit(&block->cycles[stat], memory_order_relaxed);
+    atomic_store_explicit(&block->cycles[stat], total_cycles + cycles, memory_order_relaxed);
+}
+
+static stats_block_t* make_thread_stats_block() {
+    stats_block_t *block = malloc(sizeof(stats_block_t)); // never freed, so it doesn't come from malloc_fn
+    if (!block) {
+        return NULL;
+    }
+    for (int i = 0; i < KGCHESS_STAT_COUNT; i++) {
+        atomic_init(&block->calls[i], 0);
+        atomic_init(&block->cycles[i], 0);
+    }
+    block->next = atomic_load(&stats_blocks);
+    while (!atomic_compare_exchange_weak(&stats_blocks, &block->next, block)) {
+    }
+    thread_stats_block = block;
+    return block;
+}
+
+static uint64_t read_cycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
 }
+#endif
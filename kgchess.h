@@ -31,6 +31,7 @@ extern "C"
 } // unconfuse xcode
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -40,6 +41,10 @@ extern "C"
 
 #define KGCHESS_VERSION_STRING "0.1.0"
 
+#define KGCHESS_MAX_MOVES 218 // max number of legal moves in any chess position
+#define KGCHESS_MAX_PUSHED_MOVES 256 // pushed moves boards from kgchess_make can keep
+#define KGCHESS_MAX_FEN_LENGTH 128 // buffer size that fits any FEN written by kgchess_get_fen
+
 typedef enum {
     KGCHESS_PIECE_NONE = 0,
     KGCHESS_PIECE_KING,
@@ -63,6 +68,16 @@ typedef enum {
     KGCHESS_STATE_ENDED,
 } kgchess_state_t;
 
+typedef enum {
+    KGCHESS_END_NONE = 0,
+    KGCHESS_END_CHECKMATE,
+    KGCHESS_END_STALEMATE,
+    KGCHESS_END_REPETITION,            // same position for the third time
+    KGCHESS_END_FIFTY_MOVES,           // 100 plies without a capture or pawn move
+    KGCHESS_END_INSUFFICIENT_MATERIAL, // neither player can checkmate
+    KGCHESS_END_DECLARED,              // set with kgchess_draw or kgchess_set_winner
+} kgchess_end_reason_t;
+
 typedef struct kgchess_piece {
     kgchess_piece_type_t type;
     kgchess_player_t player;
@@ -81,29 +96,172 @@ typedef struct kgchess_move {
     bool is_en_passant;
 } kgchess_move_t;
 
+// Move packed into 16 bits: from square (bits 0-5), to square (bits 6-11) and flags (bits 12-15), squares are y * 8 + x.
+// Flags: 0 quiet, 2 castling, 4 capture, 5 en passant, 8-11 promotion to knight, bishop, rook or queen
+// (12-15 if it's a capture too). Unlike kgchess_move_t it includes the promotion piece.
+typedef uint16_t kgchess_packed_move_t;
+
+#define KGCHESS_PACKED_MOVE_NONE 0 // a1 to a1, never a legal move
+
 typedef struct kgchess_moves_array {
     kgchess_move_t items[28];
     int count;
 } kgchess_moves_array_t;
 
+// Weights of kgchess_evaluate in centipawns, indexed by kgchess_piece_type_t. Piece-square tables are seen
+// from white's side with a8 at index 0 and h1 at 63 (the way a board is printed), black uses them mirrored.
+// Phase weights say how much each piece counts towards the middlegame, so the score moves from the middlegame
+// to the endgame tables as pieces are traded.
+typedef struct kgchess_eval_weights {
+    int16_t mg_values[7];
+    int16_t eg_values[7];
+    int16_t mg_tables[7][64];
+    int16_t eg_tables[7][64];
+    int16_t phase_weights[7];
+} kgchess_eval_weights_t;
+
+// Hot paths counted when the library is compiled with KGCHESS_USE_STATS.
+typedef enum {
+    KGCHESS_STAT_GET_MOVES = 0,      // moves of one piece generated
+    KGCHESS_STAT_ILLEGAL_MOVES,      // generated moves rejected because they leave the king in check (calls only)
+    KGCHESS_STAT_APPLY_MOVE,         // moves made, pushed or popped, null moves included
+    KGCHESS_STAT_IS_IN_CHECK,
+    KGCHESS_STAT_IS_SQUARE_ATTACKED, // kgchess_is_square_attacked_by_player
+    KGCHESS_STAT_GAME_END,           // checkmate, stalemate and draw checks, kgchess_is_draw included
+    KGCHESS_STAT_COUNT,
+} kgchess_stat_t;
+
+// Cycles come from the CPU's timestamp counter (nanoseconds where there's none) and include nested counted calls.
+typedef struct kgchess_stats {
+    uint64_t calls[KGCHESS_STAT_COUNT];
+    uint64_t cycles[KGCHESS_STAT_COUNT];
+} kgchess_stats_t;
+
+#define KGCHESS_MAX_STATS_STRING_LENGTH 1024 // buffer size that fits kgchess_stats_to_string and kgchess_stats_to_json
+
 typedef struct kgchess kgchess_t;
 
+typedef void* (*kgchess_malloc_fn)(size_t size);
+typedef void (*kgchess_free_fn)(void *ptr);
+
+// Used by kgchess_make, kgchess_make_copy, kgchess_make_from_fen and kgchess_destroy (e.g. to take boards
+// from a pool), NULL restores malloc or free. Has to be called before any board is made.
+void kgchess_set_allocation_functions(kgchess_malloc_fn malloc_fun, kgchess_free_fn free_fun);
+
+// Returns NULL if allocation fails. Boards made this way come with history for KGCHESS_MAX_PUSHED_MOVES pushed moves.
 kgchess_t* kgchess_make(void);
 kgchess_t* kgchess_make_copy(const kgchess_t *chess);
+// Size of kgchess_t, so boards can be embedded in other structs, arrays or on the stack.
+size_t kgchess_sizeof(void);
+// Sets up the starting position in mem, which has to be kgchess_sizeof() bytes aligned like uint64_t.
+// Boards made this way aren't passed to kgchess_destroy and have no history until kgchess_set_history is called.
+kgchess_t* kgchess_init_at(void *mem);
+// Size of a board's history: hashes of recent positions, to find repetitions, and moves that can be popped.
+size_t kgchess_history_sizeof(int pushed_moves_capacity);
+// History is kept in mem (kgchess_history_sizeof(pushed_moves_capacity) bytes aligned like uint64_t) until it's
+// set again, so boards stay small and cheap to copy. Positions that can repeat are kept, pushed moves are dropped.
+// Without history (mem is NULL) moves can't be pushed and repetitions aren't found.
+void kgchess_set_history(kgchess_t *chess, void *mem, int pushed_moves_capacity);
+// Makes dst the same as src without allocating. dst has to be a board already and keeps its own history, positions
+// that can repeat are copied into it, pushed moves aren't.
+void kgchess_copy_to(kgchess_t *dst, const kgchess_t *src);
+// Returns NULL if fen is invalid. Halfmove clock and fullmove number are optional, so EPD lines work too.
+kgchess_t* kgchess_make_from_fen(const char *fen);
+// Replaces the position without allocating, chess is left unchanged if fen is invalid.
+bool kgchess_set_fen(kgchess_t *chess, const char *fen);
+// Writes a null-terminated FEN and returns its length, or 0 if it doesn't fit in capacity.
+int kgchess_get_fen(const kgchess_t *chess, char *out, int capacity);
 void kgchess_destroy(kgchess_t *chess);
 kgchess_piece_t kgchess_get_piece_at(const kgchess_t *chess, int x, int y);
 kgchess_moves_array_t kgchess_moves_array_make_empty(void);
 kgchess_moves_array_t kgchess_get_moves(const kgchess_t *chess, int x, int y);
+// Writes up to capacity legal moves of the current player to out and returns how many were written,
+// a buffer of KGCHESS_MAX_MOVES is always big enough.
+int kgchess_get_all_moves(const kgchess_t *chess, kgchess_move_t *out, int capacity);
+int kgchess_count_all_moves(const kgchess_t *chess);
+// Legal moves of the current player's pieces of given type that land on x, y (e.g. to resolve "Nbd7").
+// Only pieces that can reach the square are looked at.
+int kgchess_get_moves_to(const kgchess_t *chess, kgchess_piece_type_t type, int x, int y, kgchess_move_t *out, int capacity);
+// Same as kgchess_get_moves and kgchess_get_all_moves, but pawn moves to the last rank are expanded into one move
+// per promotion piece (queen, knight, rook, bishop). KGCHESS_MAX_MOVES is still big enough for all moves.
+int kgchess_get_packed_moves(const kgchess_t *chess, int x, int y, kgchess_packed_move_t *out, int capacity);
+int kgchess_get_all_packed_moves(const kgchess_t *chess, kgchess_packed_move_t *out, int capacity);
+// Only captures (en passant included) and promotions of kgchess_get_all_packed_moves, in the same order. Cheaper
+// than generating all moves where quiet ones aren't wanted, e.g. in a quiescence search.
+int kgchess_get_all_packed_captures(const kgchess_t *chess, kgchess_packed_move_t *out, int capacity);
+// promotion is ignored unless it's a queen, bishop, knight or rook. Returns KGCHESS_PACKED_MOVE_NONE for invalid positions.
+kgchess_packed_move_t kgchess_pack_move(kgchess_move_t move, kgchess_piece_type_t promotion);
+// promotion can be NULL, it's set to KGCHESS_PIECE_NONE if the move isn't a promotion.
+kgchess_move_t kgchess_unpack_move(kgchess_packed_move_t move, kgchess_piece_type_t *promotion);
 bool kgchess_move(kgchess_t *chess, kgchess_move_t move);
+// Makes the move and its promotion, if there's one.
+bool kgchess_move_packed(kgchess_t *chess, kgchess_packed_move_t move);
+// Same as kgchess_move, but the move (and a promotion that follows it) can be taken back with kgchess_pop_move.
+// Returns false when the board's history is full or it has none.
+bool kgchess_push_move(kgchess_t *chess, kgchess_move_t move);
+// Passes the turn without moving, for null move pruning in searches. Undone with kgchess_pop_move.
+bool kgchess_push_null_move(kgchess_t *chess);
+bool kgchess_push_packed_move(kgchess_t *chess, kgchess_packed_move_t move);
+bool kgchess_pop_move(kgchess_t *chess);
 kgchess_player_t kgchess_get_enemy_player(kgchess_player_t player);
+// Game ends with checkmate, stalemate, threefold repetition, the fifty-move rule or insufficient material.
+// Moves can still be made after a draw, e.g. to replay games where it wasn't claimed.
 kgchess_state_t kgchess_get_state(kgchess_t *chess);
+kgchess_end_reason_t kgchess_get_end_reason(kgchess_t *chess);
+// Plies since the last capture or pawn move.
+int kgchess_get_halfmove_clock(const kgchess_t *chess);
+// How many times the position occurred before since the last capture or pawn move (positions before the last
+// kgchess_set_fen or null move aren't known). Takes time proportional to the halfmove clock.
+int kgchess_get_repetitions_count(const kgchess_t *chess);
+// Checks a single repetition, the fifty-move rule and insufficient material without looking at legal moves,
+// so it's cheap enough to call at every node of a search.
+bool kgchess_is_draw(const kgchess_t *chess);
 kgchess_pos_t kgchess_get_promotion_position(kgchess_t *chess);
 bool kgchess_promote(kgchess_t *chess, kgchess_piece_type_t piece_type);
+// Zobrist key of the position: pieces, player to move, castling rights and en passant file.
+uint64_t kgchess_get_hash(const kgchess_t *chess);
 kgchess_player_t kgchess_get_winner(kgchess_t *chess);
 kgchess_player_t kgchess_get_current_player(kgchess_t *chess);
 void kgchess_draw(kgchess_t *chess);
 void kgchess_set_winner(kgchess_t *chess, kgchess_player_t player);
 bool kgchess_is_square_attacked_by_player(const kgchess_t *chess, int x, int y, kgchess_player_t player);
+// Number of player's pieces attacking (or defending) a square, kept up to date as moves are made.
+int kgchess_get_attackers_count(const kgchess_t *chess, int x, int y, kgchess_player_t player);
+bool kgchess_is_in_check(const kgchess_t *chess);
+// Number of pieces of given type, or all pieces of a player for KGCHESS_PIECE_NONE.
+int kgchess_get_pieces_count(const kgchess_t *chess, kgchess_player_t player, kgchess_piece_type_t type);
+// Squares (bit y * 8 + x) of player's pieces of given type. KGCHESS_PIECE_NONE gives all pieces of a player
+// and KGCHESS_PLAYER_NONE pieces of both players.
+uint64_t kgchess_get_bitboard(const kgchess_t *chess, kgchess_player_t player, kgchess_piece_type_t type);
+// Castling rights as bits: 1 white king side, 2 white queen side, 4 black king side, 8 black queen side.
+int kgchess_get_castling_rights(const kgchess_t *chess);
+// Square (y * 8 + x) a pawn has just passed over moving two squares, -1 if the last move wasn't a double push.
+int kgchess_get_en_passant_square(const kgchess_t *chess);
+// Static exchange evaluation: material won (or lost if negative) in centipawns when move starts a sequence of captures
+// on its target square, with both players recapturing with their least valuable pieces and stopping when it pays off.
+// Sliders behind other attackers join in. Pins and promotions are ignored. A quiet move gives 0 if the piece is safe.
+int kgchess_see(const kgchess_t *chess, kgchess_move_t move);
+// Material and piece-square score in centipawns from the current player's point of view, tapered between
+// middlegame and endgame weights. Its totals are updated as pieces move, so it doesn't look at the board.
+int kgchess_evaluate(const kgchess_t *chess);
+// Copies weights used by kgchess_evaluate, which start as the built-in defaults.
+void kgchess_get_eval_weights(kgchess_eval_weights_t *out);
+// Replaces weights used by kgchess_evaluate (e.g. with tuned ones loaded from a file), NULL restores the defaults.
+// Existing boards are evaluated with the new weights too, their totals are computed again when they're evaluated
+// or a move is made on them. Calls from many threads are serialized, but it shouldn't be called while other threads
+// make moves or evaluate boards.
+void kgchess_set_eval_weights(const kgchess_eval_weights_t *weights);
+// Counters of all threads added up. Every thread counts on its own, so it's cheap, but the sum can miss increments
+// made while it's computed. All zeros unless the library is compiled with KGCHESS_USE_STATS.
+kgchess_stats_t kgchess_get_stats(void);
+// Zeros counters of all threads, increments made at the same time can be lost.
+void kgchess_reset_stats(void);
+bool kgchess_is_stats_enabled(void);
+const char* kgchess_get_stat_name(kgchess_stat_t stat);
+// Write a null-terminated table (one line per counter) or JSON object and return its length, or 0 if it doesn't
+// fit in capacity.
+int kgchess_stats_to_string(const kgchess_stats_t *stats, char *out, int capacity);
+int kgchess_stats_to_json(const kgchess_stats_t *stats, char *out, int capacity);
 
 #ifdef __cplusplus
 }
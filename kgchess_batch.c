@@ -0,0 +1,555 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+
+#include "kgchess_batch.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_NAME "avx2"
+#define LANES 4
+typedef __m256i vec_t;
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define SIMD_NAME "sse4.1"
+#define LANES 2
+typedef __m128i vec_t;
+#else
+#define SIMD_NAME "scalar"
+#define LANES 1
+typedef uint64_t vec_t;
+#endif
+
+#define ALIGNMENT 32
+
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+#define RANK_1 0x00000000000000ffULL
+#define RANK_3 0x0000000000ff0000ULL
+#define SQ_A1 (1ULL << 0)
+#define SQ_B1 (1ULL << 1)
+#define SQ_C1 (1ULL << 2)
+#define SQ_D1 (1ULL << 3)
+#define SQ_E1 (1ULL << 4)
+#define SQ_F1 (1ULL << 5)
+#define SQ_G1 (1ULL << 6)
+#define SQ_H1 (1ULL << 7)
+
+// Lanes of a vector as integers, aligned for loads and stores.
+typedef union {
+    vec_t vec;
+    uint64_t lanes[LANES];
+} lanes_t;
+
+typedef enum {
+    DIRECTION_N = 0,
+    DIRECTION_S,
+    DIRECTION_W,
+    DIRECTION_E,
+    DIRECTION_NE,
+    DIRECTION_SW,
+    DIRECTION_NW,
+    DIRECTION_SE,
+} direction_t;
+
+// Pinned pieces can only move along the line they're pinned on, direction / 2 is its index.
+typedef enum {
+    AXIS_VERTICAL = 0,
+    AXIS_HORIZONTAL,
+    AXIS_DIAGONAL,
+    AXIS_ANTI_DIAGONAL,
+} axis_t;
+
+static const int DIRECTION_SHIFTS[8] = { 8, -8, -1, 1, 9, -9, 7, -7 };
+static const uint64_t DIRECTION_MASKS[8] = { ~0ULL, ~0ULL, ~FILE_H, ~FILE_A, ~FILE_A, ~FILE_H, ~FILE_H, ~FILE_A };
+static const int KNIGHT_SHIFTS[8] = { 17, 15, 10, 6, -6, -10, -15, -17 };
+static const uint64_t KNIGHT_MASKS[8] = {
+    ~FILE_A, ~FILE_H, ~(FILE_A | (FILE_A << 1)), ~(FILE_H | (FILE_H >> 1)),
+    ~(FILE_A | (FILE_A << 1)), ~(FILE_H | (FILE_H >> 1)), ~FILE_A, ~FILE_H,
+};
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+// Same operations on every lane (one position per lane).
+static inline vec_t vec_load(const uint64_t *p);
+static inline void vec_store(uint64_t *p, vec_t v);
+static inline vec_t vec_set(uint64_t x);
+static inline vec_t vec_and(vec_t a, vec_t b);
+static inline vec_t vec_or(vec_t a, vec_t b);
+static inline vec_t vec_andnot(vec_t a, vec_t b); // ~a & b
+static inline vec_t vec_add(vec_t a, vec_t b);
+static inline vec_t vec_sub(vec_t a, vec_t b);
+static inline vec_t vec_shift(vec_t v, int shift); // left if positive
+static inline vec_t vec_is_zero(vec_t v);           // all bits set in lanes that are 0
+static inline vec_t vec_select(vec_t mask, vec_t a, vec_t b); // a where mask is set, b elsewhere
+static inline vec_t vec_flip(vec_t v);              // mirrors boards vertically
+static inline vec_t vec_count(vec_t v);             // number of bits set in every lane
+
+static inline vec_t vec_step(vec_t v, direction_t direction);
+static inline vec_t vec_slide(vec_t sliders, vec_t empty, direction_t direction);
+static inline vec_t vec_knight_attacks(vec_t knights);
+static inline vec_t vec_king_attacks(vec_t kings);
+
+static void compute_lanes(kgchess_batch_t *batch, int index);
+static int count_en_passant_moves(uint64_t ep, uint64_t occupied, uint64_t pawns, uint64_t king,
+                                  uint64_t enemy_pawns, uint64_t enemy_knights, uint64_t enemy_diagonal, uint64_t enemy_orthogonal);
+static uint64_t bb_step(uint64_t bb, direction_t direction);
+static uint64_t bb_slide(uint64_t sliders, uint64_t empty, direction_t direction);
+static int bb_pop_lsb(uint64_t *bb);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_batch_t* kgchess_batch_make(int capacity) {
+    if (capacity <= 0) {
+        return NULL;
+    }
+    kgchess_batch_t *batch = malloc(sizeof(kgchess_batch_t));
+    if (!batch) {
+        return NULL;
+    }
+    memset(batch, 0, sizeof(kgchess_batch_t));
+    // padded to whole vectors, so the last positions don't need a scalar loop
+    int padded = (capacity + LANES - 1) / LANES * LANES;
+    size_t bbs_size = (size_t)padded * sizeof(uint64_t);
+    size_t size = 10 * bbs_size + (size_t)padded * (sizeof(int) + 3 * sizeof(uint8_t) + sizeof(bool)) + ALIGNMENT;
+    char *mem = calloc(1, size);
+    if (!mem) {
+        free(batch);
+        return NULL;
+    }
+    // first pointer keeps the allocation for kgchess_batch_destroy
+    char *it = (char*)(((uintptr_t)mem + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+    for (int type = KGCHESS_PIECE_KING; type <= KGCHESS_PIECE_PAWN; type++) {
+        batch->type_bbs[type] = (uint64_t*)it;
+        it += bbs_size;
+    }
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        batch->player_bbs[player] = (uint64_t*)it;
+        it += bbs_size;
+        batch->attacked_bbs[player] = (uint64_t*)it;
+        it += bbs_size;
+    }
+    batch->moves_count = (int*)it;
+    it += padded * sizeof(int);
+    batch->current_player = (uint8_t*)it;
+    it += padded;
+    batch->castling_rights = (uint8_t*)it;
+    it += padded;
+    batch->en_passant_sq = (int8_t*)it;
+    it += padded;
+    batch->in_check = (bool*)it;
+    batch->type_bbs[KGCHESS_PIECE_NONE] = (uint64_t*)mem;
+    batch->capacity = capacity;
+    return batch;
+}
+
+void kgchess_batch_destroy(kgchess_batch_t *batch) {
+    if (!batch) {
+        return;
+    }
+    free(batch->type_bbs[KGCHESS_PIECE_NONE]);
+    free(batch);
+}
+
+void kgchess_batch_clear(kgchess_batch_t *batch) {
+    batch->count = 0;
+}
+
+bool kgchess_batch_add(kgchess_batch_t *batch, const kgchess_t *chess) {
+    if (batch->count >= batch->capacity) {
+        return false;
+    }
+    int i = batch->count;
+    for (int type = KGCHESS_PIECE_KING; type <= KGCHESS_PIECE_PAWN; type++) {
+        batch->type_bbs[type][i] = kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, type);
+    }
+    for (int player = KGCHESS_PLAYER_WHITE; player <= KGCHESS_PLAYER_BLACK; player++) {
+        batch->player_bbs[player][i] = kgchess_get_bitboard(chess, player, KGCHESS_PIECE_NONE);
+    }
+    batch->current_player[i] = (uint8_t)kgchess_get_current_player((kgchess_t*)chess);
+    batch->castling_rights[i] = (uint8_t)kgchess_get_castling_rights(chess);
+    batch->en_passant_sq[i] = (int8_t)kgchess_get_en_passant_square(chess);
+    batch->count++;
+    return true;
+}
+
+void kgchess_batch_compute(kgchess_batch_t *batch) {
+    for (int i = 0; i < batch->count; i += LANES) {
+        compute_lanes(batch, i);
+    }
+}
+
+const char* kgchess_batch_get_simd_name() {
+    return SIMD_NAME;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+#if defined(__AVX2__)
+
+static inline vec_t vec_load(const uint64_t *p) { return _mm256_load_si256((const __m256i*)p); }
+static inline void vec_store(uint64_t *p, vec_t v) { _mm256_store_si256((__m256i*)p, v); }
+static inline vec_t vec_set(uint64_t x) { return _mm256_set1_epi64x((long long)x); }
+static inline vec_t vec_and(vec_t a, vec_t b) { return _mm256_and_si256(a, b); }
+static inline vec_t vec_or(vec_t a, vec_t b) { return _mm256_or_si256(a, b); }
+static inline vec_t vec_andnot(vec_t a, vec_t b) { return _mm256_andnot_si256(a, b); }
+static inline vec_t vec_add(vec_t a, vec_t b) { return _mm256_add_epi64(a, b); }
+static inline vec_t vec_sub(vec_t a, vec_t b) { return _mm256_sub_epi64(a, b); }
+static inline vec_t vec_is_zero(vec_t v) { return _mm256_cmpeq_epi64(v, _mm256_setzero_si256()); }
+static inline vec_t vec_select(vec_t mask, vec_t a, vec_t b) { return _mm256_blendv_epi8(b, a, mask); }
+
+static inline vec_t vec_shift(vec_t v, int shift) {
+    return shift > 0 ? _mm256_slli_epi64(v, shift) : _mm256_srli_epi64(v, -shift);
+}
+
+static inline vec_t vec_flip(vec_t v) {
+    const __m256i bytes = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                           7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    return _mm256_shuffle_epi8(v, bytes);
+}
+
+// Bits of every nibble are looked up in a table, then bytes are summed per lane.
+static inline vec_t vec_count(vec_t v) {
+    const __m256i counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_shuffle_epi8(counts, _mm256_and_si256(v, low_nibbles));
+    __m256i high = _mm256_shuffle_epi8(counts, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+#elif defined(__SSE4_1__)
+
+static inline vec_t vec_load(const uint64_t *p) { return _mm_load_si128((const __m128i*)p); }
+static inline void vec_store(uint64_t *p, vec_t v) { _mm_store_si128((__m128i*)p, v); }
+static inline vec_t vec_set(uint64_t x) { return _mm_set1_epi64x((long long)x); }
+static inline vec_t vec_and(vec_t a, vec_t b) { return _mm_and_si128(a, b); }
+static inline vec_t vec_or(vec_t a, vec_t b) { return _mm_or_si128(a, b); }
+static inline vec_t vec_andnot(vec_t a, vec_t b) { return _mm_andnot_si128(a, b); }
+static inline vec_t vec_add(vec_t a, vec_t b) { return _mm_add_epi64(a, b); }
+static inline vec_t vec_sub(vec_t a, vec_t b) { return _mm_sub_epi64(a, b); }
+static inline vec_t vec_is_zero(vec_t v) { return _mm_cmpeq_epi64(v, _mm_setzero_si128()); }
+static inline vec_t vec_select(vec_t mask, vec_t a, vec_t b) { return _mm_blendv_epi8(b, a, mask); }
+
+static inline vec_t vec_shift(vec_t v, int shift) {
+    return shift > 0 ? _mm_slli_epi64(v, shift) : _mm_srli_epi64(v, -shift);
+}
+
+static inline vec_t vec_flip(vec_t v) {
+    const __m128i bytes = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    return _mm_shuffle_epi8(v, bytes);
+}
+
+// Bits of every nibble are looked up in a table, then bytes are summed per lane.
+static inline vec_t vec_count(vec_t v) {
+    const __m128i counts = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_nibbles = _mm_set1_epi8(0x0f);
+    __m128i low = _mm_shuffle_epi8(counts, _mm_and_si128(v, low_nibbles));
+    __m128i high = _mm_shuffle_epi8(counts, _mm_and_si128(_mm_srli_epi16(v, 4), low_nibbles));
+    return _mm_sad_epu8(_mm_add_epi8(low, high), _mm_setzero_si128());
+}
+
+#else
+
+static inline vec_t vec_load(const uint64_t *p) { return *p; }
+static inline void vec_store(uint64_t *p, vec_t v) { *p = v; }
+static inline vec_t vec_set(uint64_t x) { return x; }
+static inline vec_t vec_and(vec_t a, vec_t b) { return a & b; }
+static inline vec_t vec_or(vec_t a, vec_t b) { return a | b; }
+static inline vec_t vec_andnot(vec_t a, vec_t b) { return ~a & b; }
+static inline vec_t vec_add(vec_t a, vec_t b) { return a + b; }
+static inline vec_t vec_sub(vec_t a, vec_t b) { return a - b; }
+static inline vec_t vec_is_zero(vec_t v) { return v == 0 ? ~0ULL : 0; }
+static inline vec_t vec_select(vec_t mask, vec_t a, vec_t b) { return (a & mask) | (b & ~mask); }
+static inline vec_t vec_shift(vec_t v, int shift) { return shift > 0 ? v << shift : v >> -shift; }
+
+static inline vec_t vec_flip(vec_t v) {
+    v = ((v >> 8) & 0x00ff00ff00ff00ffULL) | ((v & 0x00ff00ff00ff00ffULL) << 8);
+    v = ((v >> 16) & 0x0000ffff0000ffffULL) | ((v & 0x0000ffff0000ffffULL) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+static inline vec_t vec_count(vec_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (vec_t)__builtin_popcountll(v);
+#else
+    vec_t count = 0;
+    while (v) {
+        v &= v - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+#endif
+
+static inline vec_t vec_step(vec_t v, direction_t direction) {
+    return vec_and(vec_shift(v, DIRECTION_SHIFTS[direction]), vec_set(DIRECTION_MASKS[direction]));
+}
+
+// Kogge-Stone fill: squares sliders attack in a direction, stopping at (and including) the first occupied square.
+static inline vec_t vec_slide(vec_t sliders, vec_t empty, direction_t direction) {
+    int shift = DIRECTION_SHIFTS[direction];
+    vec_t mask = vec_set(DIRECTION_MASKS[direction]);
+    vec_t propagators = vec_and(empty, mask);
+    sliders = vec_or(sliders, vec_and(propagators, vec_shift(sliders, shift)));
+    propagators = vec_and(propagators, vec_shift(propagators, shift));
+    sliders = vec_or(sliders, vec_and(propagators, vec_shift(sliders, shift * 2)));
+    propagators = vec_and(propagators, vec_shift(propagators, shift * 2));
+    sliders = vec_or(sliders, vec_and(propagators, vec_shift(sliders, shift * 4)));
+    return vec_and(vec_shift(sliders, shift), mask);
+}
+
+static inline vec_t vec_knight_attacks(vec_t knights) {
+    vec_t attacks = vec_set(0);
+    for (int i = 0; i < 8; i++) {
+        attacks = vec_or(attacks, vec_and(vec_shift(knights, KNIGHT_SHIFTS[i]), vec_set(KNIGHT_MASKS[i])));
+    }
+    return attacks;
+}
+
+static inline vec_t vec_king_attacks(vec_t kings) {
+    vec_t attacks = vec_set(0);
+    for (int dir = 0; dir < 8; dir++) {
+        attacks = vec_or(attacks, vec_step(kings, dir));
+    }
+    return attacks;
+}
+
+// Boards where black is to move are mirrored first, so the player to move always plays up the board from rank 1.
+static void compute_lanes(kgchess_batch_t *batch, int index) {
+    lanes_t flip_masks;
+    lanes_t castling_bbs;
+    for (int lane = 0; lane < LANES; lane++) {
+        int i = index + lane;
+        int rights = batch->castling_rights[i];
+        flip_masks.lanes[lane] = batch->current_player[i] == KGCHESS_PLAYER_BLACK ? ~0ULL : 0;
+        castling_bbs.lanes[lane] = ((rights & 1) ? SQ_H1 : 0) | ((rights & 2) ? SQ_A1 : 0)
+                           | ((rights & 4) ? SQ_H1 << 56 : 0) | ((rights & 8) ? SQ_A1 << 56 : 0);
+    }
+    vec_t flip = flip_masks.vec;
+    vec_t white = vec_load(batch->player_bbs[KGCHESS_PLAYER_WHITE] + index);
+    vec_t black = vec_load(batch->player_bbs[KGCHESS_PLAYER_BLACK] + index);
+    vec_t own = vec_select(flip, vec_flip(black), white);
+    vec_t enemy = vec_select(flip, vec_flip(white), black);
+    vec_t types[7];
+    for (int type = KGCHESS_PIECE_KING; type <= KGCHESS_PIECE_PAWN; type++) {
+        vec_t bb = vec_load(batch->type_bbs[type] + index);
+        types[type] = vec_select(flip, vec_flip(bb), bb);
+    }
+    vec_t castling = castling_bbs.vec;
+    castling = vec_select(flip, vec_flip(castling), castling);
+
+    vec_t occupied = vec_or(own, enemy);
+    vec_t empty = vec_andnot(occupied, vec_set(~0ULL));
+    vec_t queens = types[KGCHESS_PIECE_QUEEN];
+    vec_t diagonal = vec_or(types[KGCHESS_PIECE_BISHOP], queens);
+    vec_t orthogonal = vec_or(types[KGCHESS_PIECE_ROOK], queens);
+    vec_t king = vec_and(types[KGCHESS_PIECE_KING], own);
+    vec_t pawns = vec_and(types[KGCHESS_PIECE_PAWN], own);
+    vec_t knights = vec_and(types[KGCHESS_PIECE_KNIGHT], own);
+    vec_t own_diagonal = vec_and(diagonal, own);
+    vec_t own_orthogonal = vec_and(orthogonal, own);
+    vec_t enemy_pawns = vec_and(types[KGCHESS_PIECE_PAWN], enemy);
+    vec_t enemy_knights = vec_and(types[KGCHESS_PIECE_KNIGHT], enemy);
+    vec_t enemy_diagonal = vec_and(diagonal, enemy);
+    vec_t enemy_orthogonal = vec_and(orthogonal, enemy);
+
+    // Enemy attacks are also computed as if the king wasn't there, so it can't step back along a slider's line.
+    vec_t own_attacks = vec_or(vec_or(vec_step(pawns, DIRECTION_NE), vec_step(pawns, DIRECTION_NW)),
+                               vec_or(vec_knight_attacks(knights), vec_king_attacks(king)));
+    vec_t enemy_attacks = vec_or(vec_or(vec_step(enemy_pawns, DIRECTION_SE), vec_step(enemy_pawns, DIRECTION_SW)),
+                                 vec_or(vec_knight_attacks(enemy_knights), vec_king_attacks(vec_and(types[KGCHESS_PIECE_KING], enemy))));
+    vec_t king_danger = enemy_attacks;
+    vec_t empty_without_king = vec_or(empty, king);
+
+    vec_t checkers = vec_or(vec_and(vec_knight_attacks(king), enemy_knights),
+                            vec_and(vec_or(vec_step(king, DIRECTION_NE), vec_step(king, DIRECTION_NW)), enemy_pawns));
+    vec_t check_rays = vec_set(0);
+    vec_t pinned_on_axis[4] = { vec_set(0), vec_set(0), vec_set(0), vec_set(0) };
+    for (int dir = 0; dir < 8; dir++) {
+        bool is_diagonal = dir >= DIRECTION_NE;
+        vec_t own_sliders = is_diagonal ? own_diagonal : own_orthogonal;
+        vec_t enemy_sliders = is_diagonal ? enemy_diagonal : enemy_orthogonal;
+        own_attacks = vec_or(own_attacks, vec_slide(own_sliders, empty, dir));
+        enemy_attacks = vec_or(enemy_attacks, vec_slide(enemy_sliders, empty, dir));
+        king_danger = vec_or(king_danger, vec_slide(enemy_sliders, empty_without_king, dir));
+
+        // A ray from the king that ends on an enemy slider is a check, if it ends on an own piece and
+        // continues to an enemy slider that piece is pinned.
+        vec_t ray = vec_slide(king, empty, dir);
+        vec_t hit = vec_and(ray, enemy_sliders);
+        vec_t is_hit = vec_andnot(vec_is_zero(hit), vec_set(~0ULL));
+        checkers = vec_or(checkers, hit);
+        check_rays = vec_or(check_rays, vec_and(is_hit, ray));
+        vec_t blocker = vec_and(ray, own);
+        vec_t xray = vec_andnot(ray, vec_slide(king, vec_or(empty, blocker), dir));
+        vec_t is_pin = vec_andnot(vec_is_zero(vec_and(xray, enemy_sliders)), vec_set(~0ULL));
+        pinned_on_axis[dir / 2] = vec_or(pinned_on_axis[dir / 2], vec_and(is_pin, blocker));
+    }
+    vec_t pinned = vec_or(vec_or(pinned_on_axis[0], pinned_on_axis[1]), vec_or(pinned_on_axis[2], pinned_on_axis[3]));
+
+    // Non-king moves have to land on check_mask: anywhere without check, on the checker or between it and
+    // the king in single check, nowhere in double check.
+    vec_t not_in_check = vec_is_zero(checkers);
+    vec_t is_single_check = vec_is_zero(vec_and(checkers, vec_sub(checkers, vec_set(1))));
+    vec_t check_mask = vec_select(not_in_check, vec_set(~0ULL), vec_and(is_single_check, vec_or(checkers, check_rays)));
+    vec_t targets = vec_andnot(own, check_mask);
+
+    vec_t count = vec_count(vec_andnot(vec_or(own, king_danger), vec_king_attacks(king)));
+
+    vec_t free_knights = vec_andnot(pinned, knights);
+    for (int i = 0; i < 8; i++) {
+        vec_t attacks = vec_and(vec_shift(free_knights, KNIGHT_SHIFTS[i]), vec_set(KNIGHT_MASKS[i]));
+        count = vec_add(count, vec_count(vec_and(attacks, targets)));
+    }
+
+    for (int dir = 0; dir < 8; dir++) {
+        vec_t sliders = dir >= DIRECTION_NE ? own_diagonal : own_orthogonal;
+        sliders = vec_andnot(vec_andnot(pinned_on_axis[dir / 2], pinned), sliders);
+        count = vec_add(count, vec_count(vec_and(vec_slide(sliders, empty, dir), targets)));
+    }
+
+    // A promotion is one move, the piece is picked after it (as in kgchess_count_all_moves).
+    vec_t pushing = vec_andnot(vec_andnot(pinned_on_axis[AXIS_VERTICAL], pinned), pawns);
+    vec_t single_pushes = vec_and(vec_shift(pushing, 8), empty);
+    vec_t double_pushes = vec_and(vec_shift(vec_and(single_pushes, vec_set(RANK_3)), 8), empty);
+    count = vec_add(count, vec_add(vec_count(vec_and(single_pushes, check_mask)), vec_count(vec_and(double_pushes, check_mask))));
+    const direction_t capture_dirs[2] = { DIRECTION_NE, DIRECTION_NW };
+    for (int i = 0; i < 2; i++) {
+        direction_t dir = capture_dirs[i];
+        vec_t capturing = vec_andnot(vec_andnot(pinned_on_axis[dir / 2], pinned), pawns);
+        vec_t captures = vec_and(vec_step(capturing, dir), vec_and(enemy, check_mask));
+        count = vec_add(count, vec_count(captures));
+    }
+
+    // Castling needs an unmoved king and rook, empty squares between them and a king that isn't in check
+    // and doesn't pass or land on an attacked square.
+    vec_t castling_rooks = vec_and(castling, vec_and(orthogonal, vec_and(own, vec_set(RANK_1))));
+    vec_t has_castling_king = vec_andnot(vec_is_zero(vec_and(king, vec_set(SQ_E1))), not_in_check);
+    vec_t king_side = vec_and(has_castling_king, vec_andnot(vec_is_zero(vec_and(castling_rooks, vec_set(SQ_H1))),
+        vec_is_zero(vec_or(vec_and(occupied, vec_set(SQ_F1 | SQ_G1)), vec_and(king_danger, vec_set(SQ_F1 | SQ_G1))))));
+    vec_t queen_side = vec_and(has_castling_king, vec_andnot(vec_is_zero(vec_and(castling_rooks, vec_set(SQ_A1))),
+        vec_is_zero(vec_or(vec_and(occupied, vec_set(SQ_B1 | SQ_C1 | SQ_D1)), vec_and(king_danger, vec_set(SQ_C1 | SQ_D1))))));
+    count = vec_add(count, vec_add(vec_and(king_side, vec_set(1)), vec_and(queen_side, vec_set(1))));
+
+    lanes_t counts;
+    lanes_t checks;
+    counts.vec = count;
+    checks.vec = not_in_check;
+    vec_store(batch->attacked_bbs[KGCHESS_PLAYER_WHITE] + index, vec_select(flip, vec_flip(enemy_attacks), own_attacks));
+    vec_store(batch->attacked_bbs[KGCHESS_PLAYER_BLACK] + index, vec_select(flip, vec_flip(own_attacks), enemy_attacks));
+
+    // En passant is rare and has its own pins (both pawns leave the rank), it's done position by position.
+    lanes_t ep_bbs[7];
+    ep_bbs[0].vec = occupied;
+    ep_bbs[1].vec = pawns;
+    ep_bbs[2].vec = king;
+    ep_bbs[3].vec = enemy_pawns;
+    ep_bbs[4].vec = enemy_knights;
+    ep_bbs[5].vec = enemy_diagonal;
+    ep_bbs[6].vec = enemy_orthogonal;
+    for (int lane = 0; lane < LANES; lane++) {
+        int i = index + lane;
+        if (i >= batch->count) {
+            break;
+        }
+        batch->moves_count[i] = (int)counts.lanes[lane];
+        batch->in_check[i] = checks.lanes[lane] == 0;
+        int ep_sq = batch->en_passant_sq[i];
+        if (ep_sq >= 0) {
+            if (flip_masks.lanes[lane]) {
+                ep_sq ^= 56;
+            }
+            batch->moves_count[i] += count_en_passant_moves(1ULL << ep_sq, ep_bbs[0].lanes[lane], ep_bbs[1].lanes[lane],
+                                                            ep_bbs[2].lanes[lane], ep_bbs[3].lanes[lane], ep_bbs[4].lanes[lane],
+                                                            ep_bbs[5].lanes[lane], ep_bbs[6].lanes[lane]);
+        }
+    }
+}
+
+// ep is the square behind an enemy pawn that has just moved two squares, on the 6th rank.
+static int count_en_passant_moves(uint64_t ep, uint64_t occupied, uint64_t pawns, uint64_t king,
+                                  uint64_t enemy_pawns, uint64_t enemy_knights, uint64_t enemy_diagonal, uint64_t enemy_orthogonal) {
+    uint64_t captured = ep >> 8;
+    if ((captured & enemy_pawns) == 0 || (ep & occupied)) {
+        return 0;
+    }
+    uint64_t capturing = pawns & (bb_step(ep, DIRECTION_SE) | bb_step(ep, DIRECTION_SW));
+    int count = 0;
+    while (capturing) {
+        uint64_t from = 1ULL << bb_pop_lsb(&capturing);
+        uint64_t empty = ~((occupied ^ from ^ captured) | ep);
+        uint64_t attackers = (bb_step(king, DIRECTION_NE) | bb_step(king, DIRECTION_NW)) & enemy_pawns & ~captured;
+        for (int i = 0; i < 8; i++) {
+            attackers |= (KNIGHT_SHIFTS[i] > 0 ? king << KNIGHT_SHIFTS[i] : king >> -KNIGHT_SHIFTS[i]) & KNIGHT_MASKS[i] & enemy_knights;
+        }
+        for (int dir = 0; dir < 8; dir++) {
+            attackers |= bb_slide(king, empty, dir) & (dir >= DIRECTION_NE ? enemy_diagonal : enemy_orthogonal);
+        }
+        if (attackers == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static uint64_t bb_step(uint64_t bb, direction_t direction) {
+    int shift = DIRECTION_SHIFTS[direction];
+    return (shift > 0 ? bb << shift : bb >> -shift) & DIRECTION_MASKS[direction];
+}
+
+static uint64_t bb_slide(uint64_t sliders, uint64_t empty, direction_t direction) {
+    uint64_t attacks = 0;
+    uint64_t bb = sliders;
+    while (bb) {
+        bb = bb_step(bb, direction);
+        attacks |= bb;
+        bb &= empty;
+    }
+    return attacks;
+}
+
+static int bb_pop_lsb(uint64_t *bb) {
+    uint64_t b = *bb;
+#if defined(__GNUC__) || defined(__clang__)
+    int sq = __builtin_ctzll(b);
+#else
+    int sq = 0;
+    while (!(b & (1ULL << sq))) {
+        sq++;
+    }
+#endif
+    *bb = b & (b - 1);
+    return sq;
+}
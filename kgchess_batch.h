@@ -0,0 +1,75 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_batch_h
+#define kgchess_batch_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+
+// Positions laid out as structure of arrays: the same bitboard of consecutive positions is contiguous, so
+// kgchess_batch_compute can process several positions at once with SIMD (AVX2 or SSE4.1 when compiled with
+// -mavx2 or -msse4.1, one position at a time otherwise). Arrays can be filled directly or with kgchess_batch_add.
+typedef struct kgchess_batch {
+    int count;
+    int capacity;
+
+    // Input, bit index is y * 8 + x.
+    uint64_t *type_bbs[7];        // indexed by kgchess_piece_type_t, [KGCHESS_PIECE_NONE] is NULL
+    uint64_t *player_bbs[3];      // indexed by kgchess_player_t, [KGCHESS_PLAYER_NONE] is NULL
+    uint8_t *current_player;      // kgchess_player_t
+    uint8_t *castling_rights;     // same bits as kgchess_get_castling_rights
+    int8_t *en_passant_sq;        // same as kgchess_get_en_passant_square
+
+    // Output of kgchess_batch_compute.
+    int *moves_count;             // same as kgchess_count_all_moves
+    bool *in_check;               // same as kgchess_is_in_check
+    uint64_t *attacked_bbs[3];    // squares attacked or defended by a player, indexed by kgchess_player_t
+} kgchess_batch_t;
+
+kgchess_batch_t* kgchess_batch_make(int capacity);
+void kgchess_batch_destroy(kgchess_batch_t *batch);
+void kgchess_batch_clear(kgchess_batch_t *batch);
+// Copies the position to the end of the batch, returns false if the batch is full.
+bool kgchess_batch_add(kgchess_batch_t *batch, const kgchess_t *chess);
+// Fills the output arrays for all positions in the batch. Positions have to be legal (one king per player,
+// player who isn't moving not in check).
+void kgchess_batch_compute(kgchess_batch_t *batch);
+// "avx2", "sse4.1" or "scalar".
+const char* kgchess_batch_get_simd_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_batch_h
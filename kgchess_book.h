@@ -0,0 +1,86 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_book_h
+#define kgchess_book_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+#include "kgchess_pgn.h"
+
+// Opening book in Polyglot .bin format: 16-byte big-endian entries (key, move, weight, learn) sorted by key.
+// The file is memory-mapped read-only and entries are decoded where they are, so many threads can use one book.
+typedef struct kgchess_book kgchess_book_t;
+
+typedef struct kgchess_book_move {
+    kgchess_move_t move;
+    kgchess_piece_type_t promotion;
+    int weight;
+} kgchess_book_move_t;
+
+// Collects moves from games and writes them as a book.
+typedef struct kgchess_book_builder kgchess_book_builder_t;
+
+// Returns NULL if the file can't be read or its size isn't a multiple of the entry size.
+kgchess_book_t* kgchess_book_open(const char *path);
+void kgchess_book_close(kgchess_book_t *book);
+int kgchess_book_get_entries_count(const kgchess_book_t *book);
+// Polyglot key of a position. En passant is only part of it if a pawn of the current player can take.
+uint64_t kgchess_book_get_key(const kgchess_t *chess);
+// Writes up to capacity legal book moves for the position to out, by weight from the highest, and returns how many
+// were written. Entries that don't match a legal move are skipped.
+int kgchess_book_get_moves(const kgchess_book_t *book, const kgchess_t *chess, kgchess_book_move_t *out, int capacity);
+// Picks a book move with probability proportional to its weight, random is any uniformly distributed number
+// (so the caller decides where randomness comes from). Returns false if the position isn't in the book.
+bool kgchess_book_pick_move(const kgchess_book_t *book, const kgchess_t *chess, uint64_t random, kgchess_book_move_t *out);
+
+// Moves are taken from the first max_plies plies of every game.
+kgchess_book_builder_t* kgchess_book_builder_make(int max_plies);
+void kgchess_book_builder_destroy(kgchess_book_builder_t *builder);
+// Adds moves of the game's main line, weighted like in Polyglot: 2 for the winner's moves, 1 for draws (or games
+// without a result) and 0 for the loser's. Returns false if a move can't be played, moves before it are kept.
+bool kgchess_book_builder_add_game(kgchess_book_builder_t *builder, const kgchess_pgn_game_t *game);
+// Adds all games from PGN text and returns how many of them were added whole.
+int kgchess_book_builder_add_pgn(kgchess_book_builder_t *builder, const char *data, size_t size);
+// Number of distinct position and move pairs collected so far.
+int kgchess_book_builder_get_entries_count(kgchess_book_builder_t *builder);
+// Writes moves played in at least min_games games and with weight above 0, sorted by key, weights are scaled down
+// if they don't fit in 16 bits. Returns false if the file can't be written.
+bool kgchess_book_builder_write(kgchess_book_builder_t *builder, const char *path, int min_games);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_book_h
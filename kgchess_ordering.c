@@ -0,0 +1,215 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#include "kgchess_ordering.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define MOVE_SQUARES(move) ((move) & 0xfff) // from and to squares of a packed move
+#define HISTORY_MAX 16384
+#define MAX_HISTORY_BONUS 1200
+
+#define HASH_MOVE_SCORE 4000000
+#define CAPTURE_SCORE 2000000
+#define KILLER_SCORE 1000000
+#define COUNTERMOVE_SCORE 900000
+#define LOSING_CAPTURE_SCORE -100000
+#define UNDERPROMOTION_SCORE -1000000
+
+typedef struct kgchess_ordering {
+    kgchess_packed_move_t killers[KGCHESS_ORDERING_MAX_PLY][2];
+    kgchess_packed_move_t countermoves[4096]; // indexed by MOVE_SQUARES of the previous move
+    int history[3][4096];                     // indexed by player and MOVE_SQUARES, within +-HISTORY_MAX
+} kgchess_ordering_t;
+
+static const int PIECE_VALUES[] = {
+    [KGCHESS_PIECE_NONE] = 0,
+    [KGCHESS_PIECE_KING] = 0,
+    [KGCHESS_PIECE_QUEEN] = 900,
+    [KGCHESS_PIECE_BISHOP] = 330,
+    [KGCHESS_PIECE_KNIGHT] = 320,
+    [KGCHESS_PIECE_ROOK] = 500,
+    [KGCHESS_PIECE_PAWN] = 100,
+};
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+static int score_move(const kgchess_t *chess, const kgchess_ordering_t *ordering, kgchess_packed_move_t move,
+                      kgchess_packed_move_t hash_move, kgchess_packed_move_t previous_move, int ply);
+static void update_history(int *history, int bonus);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_ordering_t* kgchess_ordering_make() {
+    kgchess_ordering_t *ordering = malloc(sizeof(kgchess_ordering_t));
+    if (!ordering) {
+        return NULL;
+    }
+    kgchess_ordering_clear(ordering);
+    return ordering;
+}
+
+void kgchess_ordering_destroy(kgchess_ordering_t *ordering) {
+    free(ordering);
+}
+
+void kgchess_ordering_clear(kgchess_ordering_t *ordering) {
+    memset(ordering, 0, sizeof(kgchess_ordering_t));
+}
+
+void kgchess_ordering_new_search(kgchess_ordering_t *ordering) {
+    memset(ordering->killers, 0, sizeof(ordering->killers));
+    for (int player = 0; player < 3; player++) {
+        for (int i = 0; i < 4096; i++) {
+            ordering->history[player][i] /= 2;
+        }
+    }
+}
+
+bool kgchess_ordering_is_quiet(kgchess_packed_move_t move) {
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    kgchess_move_t unpacked = kgchess_unpack_move(move, &promotion);
+    return !unpacked.is_attack && promotion == KGCHESS_PIECE_NONE;
+}
+
+void kgchess_ordering_update(kgchess_ordering_t *ordering, const kgchess_t *chess, kgchess_packed_move_t move,
+                             kgchess_packed_move_t previous_move, int ply, int depth,
+                             const kgchess_packed_move_t *failed_quiets, int failed_quiets_count)
+{
+    if (!kgchess_ordering_is_quiet(move)) {
+        return;
+    }
+    if (ply >= 0 && ply < KGCHESS_ORDERING_MAX_PLY && ordering->killers[ply][0] != move) {
+        ordering->killers[ply][1] = ordering->killers[ply][0];
+        ordering->killers[ply][0] = move;
+    }
+    if (previous_move != KGCHESS_PACKED_MOVE_NONE) {
+        ordering->countermoves[MOVE_SQUARES(previous_move)] = move;
+    }
+    int bonus = depth * depth;
+    bonus = bonus > MAX_HISTORY_BONUS ? MAX_HISTORY_BONUS : bonus;
+    int *history = ordering->history[kgchess_get_current_player((kgchess_t*)chess)];
+    update_history(&history[MOVE_SQUARES(move)], bonus);
+    for (int i = 0; i < failed_quiets_count; i++) {
+        update_history(&history[MOVE_SQUARES(failed_quiets[i])], -bonus);
+    }
+}
+
+int kgchess_move_picker_init(kgchess_move_picker_t *picker, const kgchess_t *chess, const kgchess_ordering_t *ordering,
+                             kgchess_packed_move_t hash_move, kgchess_packed_move_t previous_move, int ply)
+{
+    picker->count = kgchess_get_all_packed_moves(chess, picker->moves, KGCHESS_MAX_MOVES);
+    picker->index = 0;
+    for (int i = 0; i < picker->count; i++) {
+        picker->scores[i] = score_move(chess, ordering, picker->moves[i], hash_move, previous_move, ply);
+    }
+    return picker->count;
+}
+
+int kgchess_move_picker_init_captures(kgchess_move_picker_t *picker, const kgchess_t *chess) {
+    picker->count = kgchess_get_all_packed_captures(chess, picker->moves, KGCHESS_MAX_MOVES);
+    picker->index = 0;
+    for (int i = 0; i < picker->count; i++) {
+        picker->scores[i] = score_move(chess, NULL, picker->moves[i], KGCHESS_PACKED_MOVE_NONE, KGCHESS_PACKED_MOVE_NONE, 0);
+    }
+    return picker->count;
+}
+
+kgchess_packed_move_t kgchess_move_picker_next(kgchess_move_picker_t *picker) {
+    int index = picker->index;
+    if (index >= picker->count) {
+        return KGCHESS_PACKED_MOVE_NONE;
+    }
+    int best_index = index;
+    for (int i = index + 1; i < picker->count; i++) {
+        if (picker->scores[i] > picker->scores[best_index]) {
+            best_index = i;
+        }
+    }
+    kgchess_packed_move_t best_move = picker->moves[best_index];
+    int best_score = picker->scores[best_index];
+    picker->moves[best_index] = picker->moves[index];
+    picker->scores[best_index] = picker->scores[index];
+    picker->moves[index] = best_move;
+    picker->scores[index] = best_score;
+    picker->index++;
+    return best_move;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+static int score_move(const kgchess_t *chess, const kgchess_ordering_t *ordering, kgchess_packed_move_t move,
+                      kgchess_packed_move_t hash_move, kgchess_packed_move_t previous_move, int ply)
+{
+    if (move == hash_move) {
+        return HASH_MOVE_SCORE;
+    }
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    kgchess_move_t unpacked = kgchess_unpack_move(move, &promotion);
+    if (promotion != KGCHESS_PIECE_NONE && promotion != KGCHESS_PIECE_QUEEN) {
+        return UNDERPROMOTION_SCORE + PIECE_VALUES[promotion];
+    }
+    if (unpacked.is_attack || promotion != KGCHESS_PIECE_NONE) {
+        int score = CAPTURE_SCORE + PIECE_VALUES[promotion];
+        if (unpacked.is_attack) {
+            kgchess_piece_t piece = kgchess_get_piece_at(chess, unpacked.from.x, unpacked.from.y);
+            kgchess_piece_t victim = kgchess_get_piece_at(chess, unpacked.to.x, unpacked.to.y);
+            int victim_value = unpacked.is_en_passant ? PIECE_VALUES[KGCHESS_PIECE_PAWN] : PIECE_VALUES[victim.type];
+            int mvv_lva = victim_value * 10 - PIECE_VALUES[piece.type] / 10;
+            // Capturing a less valuable piece is only good if the exchange that follows doesn't lose material.
+            if (victim_value < PIECE_VALUES[piece.type] && kgchess_see(chess, unpacked) < 0) {
+                return LOSING_CAPTURE_SCORE + mvv_lva;
+            }
+            score += mvv_lva;
+        }
+        return score;
+    }
+    if (!ordering) {
+        return 0;
+    }
+    if (ply >= 0 && ply < KGCHESS_ORDERING_MAX_PLY) {
+        if (move == ordering->killers[ply][0]) {
+            return KILLER_SCORE + 1;
+        } else if (move == ordering->killers[ply][1]) {
+            return KILLER_SCORE;
+        }
+    }
+    if (previous_move != KGCHESS_PACKED_MOVE_NONE && move == ordering->countermoves[MOVE_SQUARES(previous_move)]) {
+        return COUNTERMOVE_SCORE;
+    }
+    kgchess_player_t player = kgchess_get_current_player((kgchess_t*)chess);
+    return ordering->history[player][MOVE_SQUARES(move)];
+}
+
+// History gravity: scores move towards +-HISTORY_MAX more slowly the closer they get, so they never overflow and
+// recent cutoffs weigh more than old ones.
+static void update_history(int *history, int bonus) {
+    *history += bonus - *history * abs(bonus) / HISTORY_MAX;
+}
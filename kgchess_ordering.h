@@ -0,0 +1,86 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_ordering_h
+#define kgchess_ordering_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+
+#define KGCHESS_ORDERING_MAX_PLY 128 // killer moves are kept for plies below it
+
+// What a search learns about quiet moves: killer moves of every ply, history scores of moves that caused
+// cutoffs and the countermove that refuted each move. Tables aren't shared, every search thread needs its own.
+typedef struct kgchess_ordering kgchess_ordering_t;
+
+// Legal moves of one position, handed out best first by kgchess_move_picker_next.
+typedef struct kgchess_move_picker {
+    kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+    int scores[KGCHESS_MAX_MOVES];
+    int count;
+    int index; // number of moves already picked
+} kgchess_move_picker_t;
+
+kgchess_ordering_t* kgchess_ordering_make(void);
+void kgchess_ordering_destroy(kgchess_ordering_t *ordering);
+void kgchess_ordering_clear(kgchess_ordering_t *ordering);
+// Forgets killer moves and halves history scores, so the next search starts from what was learned but adapts quickly.
+void kgchess_ordering_new_search(kgchess_ordering_t *ordering);
+// Captures and promotions aren't quiet, only quiet moves are kept in killer, history and countermove tables.
+bool kgchess_ordering_is_quiet(kgchess_packed_move_t move);
+// Call when move causes a beta cutoff at ply, after it's taken back (chess is the position it was made in).
+// previous_move is the move that led to chess (KGCHESS_PACKED_MOVE_NONE after a null move or at the root).
+// A quiet move becomes a killer of ply and the countermove of previous_move, and gets a history bonus growing with
+// depth. Quiet moves that were searched before it without a cutoff (failed_quiets) get the same amount taken away.
+void kgchess_ordering_update(kgchess_ordering_t *ordering, const kgchess_t *chess, kgchess_packed_move_t move,
+                             kgchess_packed_move_t previous_move, int ply, int depth,
+                             const kgchess_packed_move_t *failed_quiets, int failed_quiets_count);
+
+// Generates legal moves of chess and scores them so they're picked in this order: hash_move, captures and queen
+// promotions by most valuable victim then least valuable attacker, killer moves of ply, the countermove of
+// previous_move, other quiet moves by history, captures losing material by kgchess_see and underpromotions last.
+// ordering can be NULL, then quiet moves keep generation order. Returns the number of moves.
+int kgchess_move_picker_init(kgchess_move_picker_t *picker, const kgchess_t *chess, const kgchess_ordering_t *ordering,
+                             kgchess_packed_move_t hash_move, kgchess_packed_move_t previous_move, int ply);
+// Same as kgchess_move_picker_init without an ordering or hash move, but only captures and promotions are generated
+// (kgchess_get_all_packed_captures), so quiescence searches don't pay for quiet moves. Returns the number of moves.
+int kgchess_move_picker_init_captures(kgchess_move_picker_t *picker, const kgchess_t *chess);
+// Returns the best move that hasn't been picked yet or KGCHESS_PACKED_MOVE_NONE after the last one. Moves are
+// selected one at a time, so the ones after a cutoff are never sorted.
+kgchess_packed_move_t kgchess_move_picker_next(kgchess_move_picker_t *picker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_ordering_h
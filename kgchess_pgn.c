@@ -0,0 +1,629 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // madvise
+#endif
+
+#include "kgchess_pgn.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+typedef struct kgchess_pgn_file {
+    const char *data;
+    size_t size;
+    bool is_mmapped;
+} kgchess_pgn_file_t;
+
+static const char SAN_PIECE_CHARS[] = {
+    [KGCHESS_PIECE_NONE] = '\0',
+    [KGCHESS_PIECE_KING] = 'K',
+    [KGCHESS_PIECE_QUEEN] = 'Q',
+    [KGCHESS_PIECE_BISHOP] = 'B',
+    [KGCHESS_PIECE_KNIGHT] = 'N',
+    [KGCHESS_PIECE_ROOK] = 'R',
+    [KGCHESS_PIECE_PAWN] = '\0',
+};
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+static bool is_space(char c);
+static bool is_line_start(const char *data, size_t pos);
+static size_t skip_line(const char *data, size_t size, size_t pos);
+static size_t skip_space(const char *data, size_t size, size_t pos);
+static bool is_tag_block_start(const char *data, size_t pos);
+static const char* skip_comment(const char *it, const char *end);
+static const char* skip_variation(const char *it, const char *end);
+static bool is_token_end(char c);
+static bool is_result(const char *token, size_t size);
+static kgchess_piece_type_t get_san_piece_type(char c);
+static size_t trim_san(const char *san, size_t size);
+static bool resolve_castling(const kgchess_t *chess, bool is_queen_side, kgchess_move_t *move);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_pgn_file_t* kgchess_pgn_file_open(const char *path) {
+    kgchess_pgn_file_t *file = malloc(sizeof(kgchess_pgn_file_t));
+    if (!file) {
+        return NULL;
+    }
+    memset(file, 0, sizeof(kgchess_pgn_file_t));
+    file->data = "";
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(file);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        free(file);
+        return NULL;
+    }
+    if (st.st_size > 0) {
+        void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mem != MAP_FAILED) {
+            madvise(mem, (size_t)st.st_size, MADV_SEQUENTIAL);
+            file->data = mem;
+            file->size = (size_t)st.st_size;
+            file->is_mmapped = true;
+            close(fd);
+            return file;
+        }
+    } else {
+        close(fd);
+        return file;
+    }
+    close(fd);
+#endif
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        free(file);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return file;
+    }
+    char *data = malloc((size_t)size);
+    if (!data || fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        free(file);
+        return NULL;
+    }
+    fclose(fp);
+    file->data = data;
+    file->size = (size_t)size;
+    return file;
+}
+
+void kgchess_pgn_file_close(kgchess_pgn_file_t *file) {
+    if (!file) {
+        return;
+    }
+#ifndef _WIN32
+    if (file->is_mmapped) {
+        munmap((void*)file->data, file->size);
+        free(file);
+        return;
+    }
+#endif
+    if (file->size > 0) {
+        free((void*)file->data);
+    }
+    free(file);
+}
+
+const char* kgchess_pgn_file_get_data(const kgchess_pgn_file_t *file) {
+    return file->data;
+}
+
+size_t kgchess_pgn_file_get_size(const kgchess_pgn_file_t *file) {
+    return file->size;
+}
+
+void kgchess_pgn_reader_init(kgchess_pgn_reader_t *reader, const char *data, size_t size) {
+    reader->data = data;
+    reader->size = size;
+    reader->pos = 0;
+}
+
+// A game is its tag pairs followed by movetext, which lasts until a line starting with '[' outside of a comment.
+bool kgchess_pgn_read_game(kgchess_pgn_reader_t *reader, kgchess_pgn_game_t *game) {
+    const char *data = reader->data;
+    size_t size = reader->size;
+    size_t pos = skip_space(data, size, reader->pos);
+    while (pos < size && data[pos] == '%' && is_line_start(data, pos)) {
+        pos = skip_space(data, size, skip_line(data, size, pos));
+    }
+    if (pos >= size) {
+        reader->pos = size;
+        return false;
+    }
+
+    game->offset = pos;
+    game->tags = data + pos;
+    size_t tags_end = pos;
+    while (pos < size && data[pos] == '[') {
+        pos = skip_line(data, size, pos);
+        tags_end = pos;
+        pos = skip_space(data, size, pos);
+    }
+    game->tags_size = tags_end - game->offset;
+
+    game->movetext = data + pos;
+    size_t movetext_end = pos;
+    while (pos < size) {
+        char c = data[pos];
+        if (c == '[' && is_line_start(data, pos)) {
+            break;
+        } else if (c == '{') {
+            const char *it = skip_comment(data + pos, data + size);
+            pos = it - data;
+        } else if (c == ';' || (c == '%' && is_line_start(data, pos))) {
+            pos = skip_line(data, size, pos);
+        } else {
+            pos++;
+        }
+        if (!is_space(data[pos - 1])) {
+            movetext_end = pos;
+        }
+    }
+    game->movetext_size = movetext_end > (size_t)(game->movetext - data) ? movetext_end - (game->movetext - data) : 0;
+    reader->pos = pos;
+    return true;
+}
+
+size_t kgchess_pgn_find_game_start(const char *data, size_t size, size_t pos) {
+    if (pos > size) {
+        return size;
+    }
+    if (!is_line_start(data, pos)) {
+        pos = skip_line(data, size, pos);
+    }
+    while (pos < size) {
+        if (data[pos] == '[' && is_tag_block_start(data, pos)) {
+            return pos;
+        }
+        pos = skip_line(data, size, pos);
+    }
+    return size;
+}
+
+bool kgchess_pgn_get_tag(const kgchess_pgn_game_t *game, const char *name, const char **value, size_t *value_size) {
+    size_t name_size = strlen(name);
+    const char *it = game->tags;
+    const char *end = game->tags + game->tags_size;
+    while (it < end) {
+        const char *line_end = memchr(it, '\n', end - it);
+        if (!line_end) {
+            line_end = end;
+        }
+        if (*it == '[' && (size_t)(line_end - it) > name_size + 1
+            && memcmp(it + 1, name, name_size) == 0 && is_space(it[1 + name_size])) {
+            const char *value_start = memchr(it, '"', line_end - it);
+            if (!value_start) {
+                return false;
+            }
+            value_start++;
+            const char *value_end = value_start;
+            while (value_end < line_end && *value_end != '"') {
+                value_end += *value_end == '\\' ? 2 : 1;
+            }
+            if (value_end > line_end) {
+                value_end = line_end;
+            }
+            *value = value_start;
+            *value_size = value_end - value_start;
+            return true;
+        }
+        it = line_end + 1;
+    }
+    return false;
+}
+
+int kgchess_pgn_replay(const kgchess_pgn_game_t *game, kgchess_t *chess, kgchess_pgn_on_move_fn on_move, void *data) {
+    const char *fen = NULL;
+    size_t fen_size = 0;
+    if (kgchess_pgn_get_tag(game, "FEN", &fen, &fen_size)) {
+        char fen_buf[KGCHESS_MAX_FEN_LENGTH];
+        if (fen_size >= sizeof(fen_buf)) {
+            return -1;
+        }
+        memcpy(fen_buf, fen, fen_size);
+        fen_buf[fen_size] = '\0';
+        if (!kgchess_set_fen(chess, fen_buf)) {
+            return -1;
+        }
+    } else {
+        kgchess_set_fen(chess, START_FEN);
+    }
+
+    int moves_count = 0;
+    const char *it = game->movetext;
+    const char *end = game->movetext + game->movetext_size;
+    while (it < end) {
+        char c = *it;
+        if (is_space(c) || c == ')') {
+            it++;
+            continue;
+        } else if (c == '{') {
+            it = skip_comment(it, end);
+            continue;
+        } else if (c == ';' || c == '%') {
+            while (it < end && *it != '\n') {
+                it++;
+            }
+            continue;
+        } else if (c == '(') {
+            it = skip_variation(it, end);
+            continue;
+        } else if (c == '*') {
+            break;
+        }
+
+        const char *token = it;
+        while (it < end && !is_token_end(*it)) {
+            it++;
+        }
+        size_t token_size = it - token;
+        if (token[0] == '$') {
+            continue;
+        }
+        if (is_result(token, token_size)) {
+            break;
+        }
+        // move numbers, also when they're glued to the move ("12.e4", "12...Nf6")
+        if (token[0] >= '1' && token[0] <= '9') {
+            while (token_size > 0 && ((*token >= '0' && *token <= '9') || *token == '.')) {
+                token++;
+                token_size--;
+            }
+        }
+        if (token_size == 0 || (token_size == 4 && memcmp(token, "e.p.", 4) == 0)) {
+            continue;
+        }
+
+        kgchess_move_t move;
+        kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+        if (!kgchess_san_to_move(chess, token, token_size, &move, &promotion)) {
+            return -1;
+        }
+        kgchess_move(chess, move);
+        if (promotion != KGCHESS_PIECE_NONE) {
+            kgchess_promote(chess, promotion);
+        }
+        moves_count++;
+        if (on_move) {
+            on_move(chess, move, promotion, data);
+        }
+    }
+    return moves_count;
+}
+
+bool kgchess_san_to_move(const kgchess_t *chess, const char *san, size_t san_size,
+                         kgchess_move_t *move, kgchess_piece_type_t *promotion) {
+    size_t size = trim_san(san, san_size);
+    *promotion = KGCHESS_PIECE_NONE;
+    if (size < 2) {
+        return false;
+    }
+
+    if (san[0] == 'O' || san[0] == '0') {
+        char c = san[0];
+        if (size == 3 && san[1] == '-' && san[2] == c) {
+            return resolve_castling(chess, false, move);
+        } else if (size == 5 && san[1] == '-' && san[2] == c && san[3] == '-' && san[4] == c) {
+            return resolve_castling(chess, true, move);
+        }
+        return false;
+    }
+
+    kgchess_piece_type_t type = get_san_piece_type(san[0]);
+    size_t i = 0;
+    if (type == KGCHESS_PIECE_NONE) {
+        type = KGCHESS_PIECE_PAWN;
+    } else {
+        i = 1;
+    }
+
+    if (type == KGCHESS_PIECE_PAWN) {
+        kgchess_piece_type_t promotion_type = get_san_piece_type(san[size - 1]);
+        if (promotion_type != KGCHESS_PIECE_NONE && promotion_type != KGCHESS_PIECE_KING) {
+            *promotion = promotion_type;
+            size--;
+            if (size > 0 && san[size - 1] == '=') {
+                size--;
+            }
+        }
+    }
+
+    if (size < i + 2) {
+        return false;
+    }
+    char to_file = san[size - 2];
+    char to_rank = san[size - 1];
+    if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') {
+        return false;
+    }
+
+    int from_x = -1;
+    int from_y = -1;
+    for (; i < size - 2; i++) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h') {
+            from_x = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            from_y = c - '1';
+        } else if (c != 'x' && c != ':' && c != '-') {
+            return false;
+        }
+    }
+
+    kgchess_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_moves_to(chess, type, to_file - 'a', to_rank - '1', moves, KGCHESS_MAX_MOVES);
+    int found_count = 0;
+    for (int j = 0; j < moves_count; j++) {
+        if ((from_x == -1 || moves[j].from.x == from_x) && (from_y == -1 || moves[j].from.y == from_y)) {
+            *move = moves[j];
+            found_count++;
+        }
+    }
+    if (found_count != 1) {
+        return false;
+    }
+
+    bool is_promotion = type == KGCHESS_PIECE_PAWN && (move->to.y == 0 || move->to.y == 7);
+    if (is_promotion && *promotion == KGCHESS_PIECE_NONE) {
+        *promotion = KGCHESS_PIECE_QUEEN;
+    } else if (!is_promotion && *promotion != KGCHESS_PIECE_NONE) {
+        return false;
+    }
+    return true;
+}
+
+bool kgchess_play_san(kgchess_t *chess, const char *san, size_t san_size) {
+    kgchess_move_t move;
+    kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+    if (!kgchess_san_to_move(chess, san, san_size, &move, &promotion)) {
+        return false;
+    }
+    kgchess_move(chess, move);
+    if (promotion != KGCHESS_PIECE_NONE) {
+        kgchess_promote(chess, promotion);
+    }
+    return true;
+}
+
+int kgchess_move_to_san(kgchess_t *chess, kgchess_move_t move, kgchess_piece_type_t promotion, char *out, int capacity) {
+    char buf[KGCHESS_MAX_SAN_LENGTH];
+    int len = 0;
+    kgchess_piece_t piece = kgchess_get_piece_at(chess, move.from.x, move.from.y);
+    if (move.is_castling) {
+        const char *castling = move.to.x == 2 ? "O-O-O" : "O-O";
+        len = (int)strlen(castling);
+        memcpy(buf, castling, len);
+    } else {
+        if (piece.type == KGCHESS_PIECE_PAWN) {
+            if (move.is_attack) {
+                buf[len++] = (char)('a' + move.from.x);
+            }
+        } else {
+            buf[len++] = SAN_PIECE_CHARS[piece.type];
+            kgchess_move_t others[KGCHESS_MAX_MOVES];
+            int others_count = kgchess_get_moves_to(chess, piece.type, move.to.x, move.to.y, others, KGCHESS_MAX_MOVES);
+            bool is_ambiguous = false;
+            bool is_file_shared = false;
+            bool is_rank_shared = false;
+            for (int i = 0; i < others_count; i++) {
+                if (others[i].from.x == move.from.x && others[i].from.y == move.from.y) {
+                    continue;
+                }
+                is_ambiguous = true;
+                is_file_shared = is_file_shared || others[i].from.x == move.from.x;
+                is_rank_shared = is_rank_shared || others[i].from.y == move.from.y;
+            }
+            if (is_ambiguous) {
+                if (!is_file_shared) {
+                    buf[len++] = (char)('a' + move.from.x);
+                } else if (!is_rank_shared) {
+                    buf[len++] = (char)('1' + move.from.y);
+                } else {
+                    buf[len++] = (char)('a' + move.from.x);
+                    buf[len++] = (char)('1' + move.from.y);
+                }
+            }
+        }
+        if (move.is_attack) {
+            buf[len++] = 'x';
+        }
+        buf[len++] = (char)('a' + move.to.x);
+        buf[len++] = (char)('1' + move.to.y);
+        if (piece.type == KGCHESS_PIECE_PAWN && (move.to.y == 0 || move.to.y == 7)) {
+            if (promotion == KGCHESS_PIECE_NONE) {
+                promotion = KGCHESS_PIECE_QUEEN;
+            }
+            buf[len++] = '=';
+            buf[len++] = SAN_PIECE_CHARS[promotion];
+        }
+    }
+
+    if (kgchess_push_move(chess, move)) {
+        if (kgchess_get_state(chess) == KGCHESS_STATE_PROMOTION) {
+            kgchess_promote(chess, promotion);
+        }
+        if (kgchess_is_in_check(chess)) {
+            buf[len++] = kgchess_count_all_moves(chess) == 0 ? '#' : '+';
+        }
+        kgchess_pop_move(chess);
+    }
+
+    if (len >= capacity) {
+        return 0;
+    }
+    memcpy(out, buf, len);
+    out[len] = '\0';
+    return len;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool is_line_start(const char *data, size_t pos) {
+    return pos == 0 || data[pos - 1] == '\n';
+}
+
+// Position after the end of line at pos.
+static size_t skip_line(const char *data, size_t size, size_t pos) {
+    const char *line_end = memchr(data + pos, '\n', size - pos);
+    return line_end ? (size_t)(line_end - data) + 1 : size;
+}
+
+static size_t skip_space(const char *data, size_t size, size_t pos) {
+    while (pos < size && is_space(data[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+// First tag of a game: the line before it (skipping empty ones) isn't a tag too.
+static bool is_tag_block_start(const char *data, size_t pos) {
+    size_t it = pos;
+    while (it > 0 && is_space(data[it - 1])) {
+        it--;
+    }
+    if (it == 0) {
+        return true;
+    }
+    while (it > 0 && data[it - 1] != '\n') {
+        it--;
+    }
+    return data[it] != '[';
+}
+
+// it points at '{', returns position after the matching '}'.
+static const char* skip_comment(const char *it, const char *end) {
+    const char *comment_end = memchr(it, '}', end - it);
+    return comment_end ? comment_end + 1 : end;
+}
+
+// it points at '(', returns position after the matching ')'. Variations can nest and contain comments.
+static const char* skip_variation(const char *it, const char *end) {
+    int depth = 0;
+    while (it < end) {
+        char c = *it;
+        if (c == '{') {
+            it = skip_comment(it, end);
+            continue;
+        } else if (c == ';') {
+            while (it < end && *it != '\n') {
+                it++;
+            }
+            continue;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+            if (depth == 0) {
+                return it + 1;
+            }
+        }
+        it++;
+    }
+    return end;
+}
+
+static bool is_token_end(char c) {
+    return is_space(c) || c == '{' || c == '(' || c == ')' || c == ';';
+}
+
+static bool is_result(const char *token, size_t size) {
+    return (size == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0))
+        || (size == 7 && memcmp(token, "1/2-1/2", 7) == 0);
+}
+
+static kgchess_piece_type_t get_san_piece_type(char c) {
+    switch (c) {
+        case 'K': return KGCHESS_PIECE_KING;
+        case 'Q': return KGCHESS_PIECE_QUEEN;
+        case 'B': return KGCHESS_PIECE_BISHOP;
+        case 'N': return KGCHESS_PIECE_KNIGHT;
+        case 'R': return KGCHESS_PIECE_ROOK;
+        default:  return KGCHESS_PIECE_NONE;
+    }
+}
+
+// Size without check, mate and annotation suffixes ("+", "#", "!?") and a glued "e.p.".
+static size_t trim_san(const char *san, size_t size) {
+    while (size > 0) {
+        char c = san[size - 1];
+        if (c == '+' || c == '#' || c == '!' || c == '?') {
+            size--;
+        } else if (size > 4 && memcmp(san + size - 4, "e.p.", 4) == 0) {
+            size -= 4;
+        } else {
+            break;
+        }
+    }
+    return size;
+}
+
+static bool resolve_castling(const kgchess_t *chess, bool is_queen_side, kgchess_move_t *move) {
+    int y = kgchess_get_current_player((kgchess_t*)chess) == KGCHESS_PLAYER_WHITE ? 0 : 7;
+    kgchess_move_t moves[8];
+    int moves_count = kgchess_get_moves_to(chess, KGCHESS_PIECE_KING, is_queen_side ? 2 : 6, y, moves, 8);
+    for (int i = 0; i < moves_count; i++) {
+        if (moves[i].is_castling) {
+            *move = moves[i];
+            return true;
+        }
+    }
+    return false;
+}
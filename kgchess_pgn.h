@@ -0,0 +1,93 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_pgn_h
+#define kgchess_pgn_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+
+#define KGCHESS_MAX_SAN_LENGTH 16 // buffer size that fits any SAN written by kgchess_move_to_san
+
+// Whole file in memory, mapped where the system supports it.
+typedef struct kgchess_pgn_file kgchess_pgn_file_t;
+
+// Reads games one by one from a buffer, games point into it so nothing is copied or allocated.
+typedef struct kgchess_pgn_reader {
+    const char *data;
+    size_t size;
+    size_t pos;
+} kgchess_pgn_reader_t;
+
+typedef struct kgchess_pgn_game {
+    const char *tags; // tag pairs section, e.g. [Event "..."]
+    size_t tags_size;
+    const char *movetext;
+    size_t movetext_size;
+    size_t offset;    // of the game in reader's data
+} kgchess_pgn_game_t;
+
+// Called for every move of the main line, after it's made.
+typedef void (*kgchess_pgn_on_move_fn)(const kgchess_t *chess, kgchess_move_t move, kgchess_piece_type_t promotion, void *data);
+
+kgchess_pgn_file_t* kgchess_pgn_file_open(const char *path);
+void kgchess_pgn_file_close(kgchess_pgn_file_t *file);
+const char* kgchess_pgn_file_get_data(const kgchess_pgn_file_t *file);
+size_t kgchess_pgn_file_get_size(const kgchess_pgn_file_t *file);
+
+void kgchess_pgn_reader_init(kgchess_pgn_reader_t *reader, const char *data, size_t size);
+bool kgchess_pgn_read_game(kgchess_pgn_reader_t *reader, kgchess_pgn_game_t *game);
+// Offset of the first game starting at or after pos, or size if there's none. Used to split a file between threads.
+size_t kgchess_pgn_find_game_start(const char *data, size_t size, size_t pos);
+// Value of a tag without quotes (escapes are left as they are), false if the game doesn't have it.
+bool kgchess_pgn_get_tag(const kgchess_pgn_game_t *game, const char *name, const char **value, size_t *value_size);
+// Sets up chess from the FEN tag (or the starting position) and plays the main line, skipping comments,
+// variations and annotations. Returns the number of moves played, or -1 if a move is invalid.
+int kgchess_pgn_replay(const kgchess_pgn_game_t *game, kgchess_t *chess, kgchess_pgn_on_move_fn on_move, void *data);
+
+// Resolves a move in standard algebraic notation (e.g. "Nbd7", "exd6 e.p.", "O-O", "e8=Q+") for the current player.
+// Only pieces that can reach the destination are looked at, not all legal moves.
+bool kgchess_san_to_move(const kgchess_t *chess, const char *san, size_t san_size,
+                         kgchess_move_t *move, kgchess_piece_type_t *promotion);
+// Same as kgchess_san_to_move followed by kgchess_move and kgchess_promote.
+bool kgchess_play_san(kgchess_t *chess, const char *san, size_t san_size);
+// Writes a null-terminated SAN of a legal move and returns its length, or 0 if it doesn't fit in capacity.
+// chess is only changed temporarily to find out whether the move gives check.
+int kgchess_move_to_san(kgchess_t *chess, kgchess_move_t move, kgchess_piece_type_t promotion, char *out, int capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_pgn_h
@@ -0,0 +1,616 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // clock_gettime
+#endif
+
+#include "kgchess_search.h"
+#include "kgchess_ordering.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define MAX_PLY KGCHESS_SEARCH_MAX_PLY
+#define INFINITE_SCORE (KGCHESS_SEARCH_MATE_SCORE + 1)
+#define MATE_BOUND (KGCHESS_SEARCH_MATE_SCORE - MAX_PLY)
+#define DEFAULT_TT_SIZE_MB 16
+#define NODES_BETWEEN_STOP_CHECKS 2048
+#define MAX_THREADS 256
+#define TB_WIN_SCORE (MATE_BOUND - 1) // minus ply, so tablebase wins are below mate scores
+#define MAX_PUSHED_MOVES (MAX_PLY + 2 * KGCHESS_TB_MAX_PIECES) // tablebase probes push captures below the last ply
+
+// State shared by all threads of one search.
+typedef struct {
+    kgchess_tt_t *tt;
+    kgchess_search_limits_t limits;
+    uint64_t start_time_ms;
+    _Atomic bool stop;
+    _Atomic uint64_t nodes; // every thread adds its nodes in batches of NODES_BETWEEN_STOP_CHECKS
+    _Atomic uint64_t tb_hits;
+    kgchess_packed_move_t root_moves[KGCHESS_MAX_MOVES]; // moves searched at the root if root_moves_count > 0
+    int root_moves_count;
+} shared_t;
+
+// Each thread has its own searcher with its own copy of the position.
+typedef struct {
+    shared_t *shared;
+    int thread_index; // 0 is the main thread
+    kgchess_search_result_t *result; // only set for the main thread
+    kgchess_t *chess;
+    kgchess_tt_t *tt;
+    kgchess_ordering_t *ordering;
+    uint64_t nodes;
+    bool stopped;
+    kgchess_packed_move_t played_moves[MAX_PLY + 1]; // move made at every ply, KGCHESS_PACKED_MOVE_NONE for null moves
+    kgchess_packed_move_t pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pv_length[MAX_PLY + 1];
+} searcher_t;
+
+// Helper threads skip some depths so they don't search in lockstep with the main thread.
+// Helper i skips SKIP_SIZES[j] out of every 2 * SKIP_SIZES[j] depths, shifted by SKIP_PHASES[j] (j = (i - 1) % 20).
+static const int SKIP_SIZES[] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+static const int SKIP_PHASES[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+static kgchess_t* make_search_board(const kgchess_t *chess);
+static void* search_thread(void *data);
+static void iterative_deepening(searcher_t *searcher);
+static bool is_depth_skipped(int thread_index, int depth);
+static int negamax(searcher_t *searcher, int depth, int ply, int alpha, int beta, bool is_null_move_allowed);
+static bool probe_tb(searcher_t *searcher, int depth, int ply, int alpha, int beta, uint64_t key, int *score);
+static bool is_root_move(const shared_t *shared, kgchess_packed_move_t move);
+static int quiescence(searcher_t *searcher, int ply, int alpha, int beta);
+static bool make_move(searcher_t *searcher, kgchess_packed_move_t move, int ply);
+static void unmake_move(searcher_t *searcher);
+static int evaluate(const kgchess_t *chess);
+static bool has_non_pawn_material(const kgchess_t *chess);
+static int score_to_tt(int score, int ply);
+static int score_from_tt(int score, int ply);
+static bool should_stop(searcher_t *searcher);
+static void fill_result(const searcher_t *searcher, int depth, int score, kgchess_search_result_t *result);
+static uint64_t get_total_nodes(const searcher_t *searcher);
+static uint64_t get_time_ms(void);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_search_limits_t kgchess_search_limits_make_empty() {
+    kgchess_search_limits_t limits;
+    memset(&limits, 0, sizeof(kgchess_search_limits_t));
+    return limits;
+}
+
+bool kgchess_search(const kgchess_t *chess, kgchess_search_limits_t limits, kgchess_search_result_t *result) {
+    memset(result, 0, sizeof(kgchess_search_result_t));
+    if (kgchess_count_all_moves(chess) == 0) {
+        return false;
+    }
+
+    int threads_count = limits.threads > 1 ? limits.threads : 1;
+    if (threads_count > MAX_THREADS) {
+        threads_count = MAX_THREADS;
+    }
+
+    shared_t shared;
+    shared.limits = limits;
+    shared.tt = limits.tt;
+    if (!shared.tt) {
+        shared.tt = kgchess_tt_make(DEFAULT_TT_SIZE_MB);
+        if (!shared.tt) {
+            return false;
+        }
+    }
+    shared.start_time_ms = get_time_ms();
+    atomic_init(&shared.stop, false);
+    atomic_init(&shared.nodes, 0);
+    atomic_init(&shared.tb_hits, 0);
+    shared.root_moves_count = 0;
+    kgchess_tt_new_search(shared.tt);
+
+    searcher_t *searchers = calloc(threads_count, sizeof(searcher_t));
+    pthread_t *threads = calloc(threads_count, sizeof(pthread_t));
+    bool ok = searchers != NULL && threads != NULL;
+    for (int i = 0; ok && i < threads_count; i++) {
+        searchers[i].shared = &shared;
+        searchers[i].thread_index = i;
+        searchers[i].tt = shared.tt;
+        searchers[i].chess = make_search_board(chess);
+        if (limits.orderings) {
+            searchers[i].ordering = limits.orderings[i];
+            kgchess_ordering_new_search(searchers[i].ordering);
+        } else {
+            searchers[i].ordering = kgchess_ordering_make();
+        }
+        ok = searchers[i].chess != NULL && searchers[i].ordering != NULL;
+    }
+
+    // With tablebases only moves keeping the best result are searched, the search picks one that converts it.
+    if (ok && limits.tb) {
+        int moves_count = kgchess_get_all_packed_moves(chess, shared.root_moves, KGCHESS_MAX_MOVES);
+        int kept_count = kgchess_tb_filter_packed_moves(limits.tb, searchers[0].chess, shared.root_moves, moves_count);
+        shared.root_moves_count = kept_count > 0 ? kept_count : 0;
+    }
+
+    if (ok) {
+        searchers[0].result = result;
+        // If a helper thread can't be started the search runs with fewer threads.
+        int started_count = 1;
+        while (started_count < threads_count) {
+            if (pthread_create(&threads[started_count], NULL, search_thread, &searchers[started_count]) != 0) {
+                break;
+            }
+            started_count++;
+        }
+        iterative_deepening(&searchers[0]);
+        atomic_store(&shared.stop, true);
+        for (int i = 1; i < started_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        result->nodes = atomic_load(&shared.nodes);
+        for (int i = 0; i < started_count; i++) {
+            result->nodes += searchers[i].nodes % NODES_BETWEEN_STOP_CHECKS;
+        }
+        result->time_ms = (int)(get_time_ms() - shared.start_time_ms);
+        result->nps = result->time_ms > 0 ? result->nodes * 1000 / result->time_ms : result->nodes * 1000;
+        result->tb_hits = atomic_load(&shared.tb_hits);
+    }
+
+    for (int i = 0; searchers && i < threads_count; i++) {
+        free(searchers[i].chess);
+        if (!limits.orderings) {
+            kgchess_ordering_destroy(searchers[i].ordering);
+        }
+    }
+    free(searchers);
+    free(threads);
+    if (!limits.tt) {
+        kgchess_tt_destroy(shared.tt);
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+// Boards are kept together with their history in memory owned by the search, it only needs as many pushed moves
+// as the search goes deep.
+static kgchess_t* make_search_board(const kgchess_t *chess) {
+    char *mem = malloc(kgchess_sizeof() + kgchess_history_sizeof(MAX_PUSHED_MOVES));
+    if (!mem) {
+        return NULL;
+    }
+    kgchess_t *board = kgchess_init_at(mem);
+    kgchess_set_history(board, mem + kgchess_sizeof(), MAX_PUSHED_MOVES);
+    kgchess_copy_to(board, chess);
+    return board;
+}
+
+static void* search_thread(void *data) {
+    iterative_deepening(data);
+    return NULL;
+}
+
+// Only the main thread reports results, helpers just fill the shared transposition table.
+static void iterative_deepening(searcher_t *searcher) {
+    const kgchess_search_limits_t *limits = &searcher->shared->limits;
+    kgchess_search_result_t *result = searcher->result;
+    int max_depth = limits->depth > 0 && limits->depth < MAX_PLY ? limits->depth : MAX_PLY;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        if (is_depth_skipped(searcher->thread_index, depth)) {
+            continue;
+        }
+        int score = negamax(searcher, depth, 0, -INFINITE_SCORE, INFINITE_SCORE, false);
+        if (searcher->stopped && (!result || result->depth > 0)) {
+            break;
+        }
+        if (!result) {
+            continue;
+        }
+        fill_result(searcher, depth, score, result);
+        if (limits->on_iteration) {
+            limits->on_iteration(result, limits->on_iteration_data);
+        }
+        if (searcher->stopped || abs(score) >= MATE_BOUND) {
+            break;
+        }
+    }
+}
+
+static bool is_depth_skipped(int thread_index, int depth) {
+    if (thread_index == 0) {
+        return false;
+    }
+    int i = (thread_index - 1) % 20;
+    return ((depth + SKIP_PHASES[i]) / SKIP_SIZES[i]) % 2 != 0;
+}
+
+static int negamax(searcher_t *searcher, int depth, int ply, int alpha, int beta, bool is_null_move_allowed) {
+    kgchess_t *chess = searcher->chess;
+    searcher->pv_length[ply] = 0;
+    if (should_stop(searcher)) {
+        return 0;
+    }
+    searcher->nodes++;
+    if (ply > 0 && kgchess_is_draw(chess)) {
+        return 0;
+    }
+
+    bool in_check = kgchess_is_in_check(chess);
+    if (in_check) {
+        depth++;
+    }
+    if (depth <= 0 || ply >= MAX_PLY) {
+        return quiescence(searcher, ply, alpha, beta);
+    }
+
+    bool is_pv = beta - alpha > 1;
+    uint64_t key = kgchess_get_hash(chess);
+    kgchess_packed_move_t tt_move = KGCHESS_PACKED_MOVE_NONE;
+    kgchess_tt_entry_t tt_entry;
+    if (kgchess_tt_probe(searcher->tt, key, &tt_entry)) {
+        tt_move = tt_entry.move;
+        if (!is_pv && ply > 0 && tt_entry.depth >= depth) {
+            int tt_score = score_from_tt(tt_entry.score, ply);
+            if (tt_entry.bound == KGCHESS_TT_BOUND_EXACT
+                || (tt_entry.bound == KGCHESS_TT_BOUND_LOWER && tt_score >= beta)
+                || (tt_entry.bound == KGCHESS_TT_BOUND_UPPER && tt_score <= alpha)) {
+                return tt_score;
+            }
+        }
+    }
+
+    int tb_score = 0;
+    if (ply > 0 && probe_tb(searcher, depth, ply, alpha, beta, key, &tb_score)) {
+        return tb_score;
+    }
+
+    // Null move pruning: if passing the turn still fails high, a real move almost certainly does too.
+    // Skipped without pieces other than pawns, where zugzwang makes passing unrealistically good.
+    if (is_null_move_allowed && !is_pv && !in_check && depth >= 3
+        && has_non_pawn_material(chess) && evaluate(chess) >= beta) {
+        int reduction = 2 + depth / 6;
+        if (kgchess_push_null_move(chess)) {
+            searcher->played_moves[ply] = KGCHESS_PACKED_MOVE_NONE;
+            int score = -negamax(searcher, depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+            kgchess_pop_move(chess);
+            if (searcher->stopped) {
+                return 0;
+            }
+            if (score >= beta) {
+                return score >= MATE_BOUND ? beta : score;
+            }
+        }
+    }
+
+    kgchess_packed_move_t previous_move = ply > 0 ? searcher->played_moves[ply - 1] : KGCHESS_PACKED_MOVE_NONE;
+    kgchess_move_picker_t picker;
+    if (kgchess_move_picker_init(&picker, chess, searcher->ordering, tt_move, previous_move, ply) == 0) {
+        return in_check ? -KGCHESS_SEARCH_MATE_SCORE + ply : 0;
+    }
+
+    int original_alpha = alpha;
+    int best_score = -INFINITE_SCORE;
+    kgchess_packed_move_t best_move = picker.moves[0];
+    kgchess_packed_move_t failed_quiets[KGCHESS_MAX_MOVES];
+    int failed_quiets_count = 0;
+    kgchess_packed_move_t move = KGCHESS_PACKED_MOVE_NONE;
+    bool is_first_move = true;
+    while ((move = kgchess_move_picker_next(&picker)) != KGCHESS_PACKED_MOVE_NONE) {
+        if (ply == 0 && !is_root_move(searcher->shared, move)) {
+            continue;
+        }
+        if (!make_move(searcher, move, ply)) {
+            continue;
+        }
+        int score = 0;
+        if (is_first_move) {
+            score = -negamax(searcher, depth - 1, ply + 1, -beta, -alpha, true);
+        } else {
+            // Principal variation search: prove the move is worse with a null window, re-search if it isn't.
+            score = -negamax(searcher, depth - 1, ply + 1, -alpha - 1, -alpha, true);
+            if (score > alpha && score < beta) {
+                score = -negamax(searcher, depth - 1, ply + 1, -beta, -alpha, true);
+            }
+        }
+        is_first_move = false;
+        unmake_move(searcher);
+        if (searcher->stopped) {
+            return 0;
+        }
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+            if (score > alpha) {
+                alpha = score;
+                searcher->pv[ply][0] = move;
+                memcpy(&searcher->pv[ply][1], searcher->pv[ply + 1], searcher->pv_length[ply + 1] * sizeof(kgchess_packed_move_t));
+                searcher->pv_length[ply] = searcher->pv_length[ply + 1] + 1;
+                if (alpha >= beta) {
+                    kgchess_ordering_update(searcher->ordering, chess, move, previous_move, ply, depth,
+                                            failed_quiets, failed_quiets_count);
+                    break;
+                }
+            }
+        }
+        if (kgchess_ordering_is_quiet(move)) {
+            failed_quiets[failed_quiets_count++] = move;
+        }
+    }
+
+    kgchess_tt_entry_t entry;
+    entry.move = best_move;
+    entry.score = (int16_t)score_to_tt(best_score, ply);
+    entry.eval = 0;
+    entry.depth = (int8_t)depth;
+    if (best_score >= beta) {
+        entry.bound = KGCHESS_TT_BOUND_LOWER;
+    } else if (best_score > original_alpha) {
+        entry.bound = KGCHESS_TT_BOUND_EXACT;
+    } else {
+        entry.bound = KGCHESS_TT_BOUND_UPPER;
+    }
+    kgchess_tt_store(searcher->tt, key, entry);
+
+    return best_score;
+}
+
+// Positions right after a capture or pawn move with few enough pieces are looked up in the tablebases (later
+// ones have a halfmove clock the tables don't know about). Returns true if the result cuts the node off.
+static bool probe_tb(searcher_t *searcher, int depth, int ply, int alpha, int beta, uint64_t key, int *score) {
+    kgchess_t *chess = searcher->chess;
+    const kgchess_tb_t *tb = searcher->shared->limits.tb;
+    if (!tb || kgchess_get_halfmove_clock(chess) != 0) {
+        return false;
+    }
+    int pieces_count = kgchess_get_pieces_count(chess, KGCHESS_PLAYER_WHITE, KGCHESS_PIECE_NONE)
+                     + kgchess_get_pieces_count(chess, KGCHESS_PLAYER_BLACK, KGCHESS_PIECE_NONE);
+    kgchess_tb_wdl_t wdl = KGCHESS_TB_DRAW;
+    if (pieces_count > kgchess_tb_get_max_pieces(tb) || !kgchess_tb_probe_wdl(tb, chess, &wdl)) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&searcher->shared->tb_hits, 1, memory_order_relaxed);
+
+    // Wins and losses the fifty-move rule turns into draws are scored just off a draw.
+    kgchess_tt_bound_t bound = KGCHESS_TT_BOUND_EXACT;
+    if (wdl == KGCHESS_TB_WIN) {
+        *score = TB_WIN_SCORE - ply;
+        bound = KGCHESS_TT_BOUND_LOWER;
+    } else if (wdl == KGCHESS_TB_LOSS) {
+        *score = -TB_WIN_SCORE + ply;
+        bound = KGCHESS_TT_BOUND_UPPER;
+    } else {
+        *score = (int)wdl;
+    }
+    if (bound == KGCHESS_TT_BOUND_LOWER && *score < beta) {
+        return false;
+    } else if (bound == KGCHESS_TT_BOUND_UPPER && *score > alpha) {
+        return false;
+    }
+    kgchess_tt_entry_t entry;
+    entry.move = KGCHESS_PACKED_MOVE_NONE;
+    entry.score = (int16_t)*score;
+    entry.eval = 0;
+    entry.depth = (int8_t)(depth + 6 < MAX_PLY ? depth + 6 : MAX_PLY - 1);
+    entry.bound = bound;
+    kgchess_tt_store(searcher->tt, key, entry);
+    return true;
+}
+
+static bool is_root_move(const shared_t *shared, kgchess_packed_move_t move) {
+    if (shared->root_moves_count == 0) {
+        return true;
+    }
+    for (int i = 0; i < shared->root_moves_count; i++) {
+        if (shared->root_moves[i] == move) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Searches only captures and queen promotions until the position is quiet, so the static evaluation isn't taken
+// in the middle of an exchange. Captures that lose material by static exchange evaluation are skipped. In check
+// all evasions are searched, since standing pat isn't an option.
+static int quiescence(searcher_t *searcher, int ply, int alpha, int beta) {
+    kgchess_t *chess = searcher->chess;
+    searcher->pv_length[ply] = 0;
+    if (should_stop(searcher)) {
+        return 0;
+    }
+    searcher->nodes++;
+
+    bool in_check = kgchess_is_in_check(chess);
+    int best_score = -INFINITE_SCORE;
+    if (!in_check) {
+        best_score = evaluate(chess);
+        if (best_score >= beta || ply >= MAX_PLY) {
+            return best_score;
+        }
+        if (best_score > alpha) {
+            alpha = best_score;
+        }
+    } else if (ply >= MAX_PLY) {
+        return evaluate(chess);
+    }
+
+    // Out of check only captures and promotions are generated, which leaves out most moves.
+    kgchess_move_picker_t picker;
+    if (in_check) {
+        if (kgchess_move_picker_init(&picker, chess, NULL, KGCHESS_PACKED_MOVE_NONE, KGCHESS_PACKED_MOVE_NONE, ply) == 0) {
+            return -KGCHESS_SEARCH_MATE_SCORE + ply;
+        }
+    } else if (kgchess_move_picker_init_captures(&picker, chess) == 0) {
+        return best_score;
+    }
+    kgchess_packed_move_t move = KGCHESS_PACKED_MOVE_NONE;
+    while ((move = kgchess_move_picker_next(&picker)) != KGCHESS_PACKED_MOVE_NONE) {
+        if (!in_check) {
+            kgchess_piece_type_t promotion = KGCHESS_PIECE_NONE;
+            kgchess_move_t unpacked = kgchess_unpack_move(move, &promotion);
+            bool is_tactical = unpacked.is_attack || promotion == KGCHESS_PIECE_QUEEN;
+            if (!is_tactical) {
+                break; // captures and queen promotions are picked before other moves
+            }
+            if (unpacked.is_attack && kgchess_see(chess, unpacked) < 0) {
+                continue;
+            }
+        }
+        if (!make_move(searcher, move, ply)) {
+            continue;
+        }
+        int score = -quiescence(searcher, ply + 1, -beta, -alpha);
+        unmake_move(searcher);
+        if (searcher->stopped) {
+            return 0;
+        }
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+    return best_score;
+}
+
+static bool make_move(searcher_t *searcher, kgchess_packed_move_t move, int ply) {
+    searcher->played_moves[ply] = move;
+    return kgchess_push_packed_move(searcher->chess, move);
+}
+
+static void unmake_move(searcher_t *searcher) {
+    kgchess_pop_move(searcher->chess);
+}
+
+static int evaluate(const kgchess_t *chess) {
+    return kgchess_evaluate(chess);
+}
+
+static bool has_non_pawn_material(const kgchess_t *chess) {
+    kgchess_player_t player = kgchess_get_current_player((kgchess_t*)chess);
+    int pieces_count = kgchess_get_pieces_count(chess, player, KGCHESS_PIECE_NONE);
+    int pawns_count = kgchess_get_pieces_count(chess, player, KGCHESS_PIECE_PAWN);
+    return pieces_count - pawns_count > 1;
+}
+
+// Mate scores are stored relative to the node, so they stay correct when the position is reached at another ply.
+static int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) {
+        return score + ply;
+    } else if (score <= -MATE_BOUND) {
+        return score - ply;
+    }
+    return score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) {
+        return score - ply;
+    } else if (score <= -MATE_BOUND) {
+        return score + ply;
+    }
+    return score;
+}
+
+static bool should_stop(searcher_t *searcher) {
+    if (searcher->stopped) {
+        return true;
+    }
+    if (searcher->nodes == 0 || searcher->nodes % NODES_BETWEEN_STOP_CHECKS != 0) {
+        return false;
+    }
+    shared_t *shared = searcher->shared;
+    uint64_t total_nodes = atomic_fetch_add_explicit(&shared->nodes, NODES_BETWEEN_STOP_CHECKS, memory_order_relaxed);
+    total_nodes += NODES_BETWEEN_STOP_CHECKS;
+    const kgchess_search_limits_t *limits = &shared->limits;
+    if (atomic_load_explicit(&shared->stop, memory_order_relaxed)) {
+        searcher->stopped = true;
+    } else if (limits->stop && atomic_load_explicit(limits->stop, memory_order_relaxed)) {
+        searcher->stopped = true;
+    } else if (limits->nodes > 0 && total_nodes >= limits->nodes) {
+        searcher->stopped = true;
+    } else if (limits->time_ms > 0 && get_time_ms() - shared->start_time_ms >= (uint64_t)limits->time_ms) {
+        searcher->stopped = true;
+    }
+    if (searcher->stopped) {
+        atomic_store_explicit(&shared->stop, true, memory_order_relaxed);
+    }
+    return searcher->stopped;
+}
+
+static void fill_result(const searcher_t *searcher, int depth, int score, kgchess_search_result_t *result) {
+    result->depth = depth;
+    result->score = score;
+    result->mate_in = 0;
+    if (score >= MATE_BOUND) {
+        result->mate_in = (KGCHESS_SEARCH_MATE_SCORE - score + 1) / 2;
+    } else if (score <= -MATE_BOUND) {
+        result->mate_in = -(KGCHESS_SEARCH_MATE_SCORE + score) / 2;
+    }
+    result->pv_length = searcher->pv_length[0];
+    for (int i = 0; i < result->pv_length; i++) {
+        result->pv[i] = kgchess_unpack_move(searcher->pv[0][i], &result->pv_promotions[i]);
+    }
+    // Stopped before any root move got a score, the first one is played rather than none.
+    if (result->pv_length == 0) {
+        const shared_t *shared = searcher->shared;
+        kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+        int moves_count = kgchess_get_all_packed_moves(searcher->chess, moves, KGCHESS_MAX_MOVES);
+        kgchess_packed_move_t move = shared->root_moves_count > 0 ? shared->root_moves[0] : moves[0];
+        if (shared->root_moves_count > 0 || moves_count > 0) {
+            result->pv[0] = kgchess_unpack_move(move, &result->pv_promotions[0]);
+            result->pv_length = 1;
+        }
+    }
+    if (result->pv_length > 0) {
+        result->best_move = result->pv[0];
+        result->best_move_promotion = result->pv_promotions[0];
+    }
+    result->nodes = get_total_nodes(searcher);
+    result->time_ms = (int)(get_time_ms() - searcher->shared->start_time_ms);
+    result->nps = result->time_ms > 0 ? result->nodes * 1000 / result->time_ms : result->nodes * 1000;
+    result->tb_hits = atomic_load_explicit(&searcher->shared->tb_hits, memory_order_relaxed);
+}
+
+// Nodes of other threads are only counted up to their last batch.
+static uint64_t get_total_nodes(const searcher_t *searcher) {
+    return atomic_load_explicit(&searcher->shared->nodes, memory_order_relaxed) + searcher->nodes % NODES_BETWEEN_STOP_CHECKS;
+}
+
+static uint64_t get_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
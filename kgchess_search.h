@@ -0,0 +1,86 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_search_h
+#define kgchess_search_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+#include "kgchess_tt.h"
+#include "kgchess_tb.h"
+#include "kgchess_ordering.h"
+
+#define KGCHESS_SEARCH_MAX_PLY 64
+#define KGCHESS_SEARCH_MATE_SCORE 32000
+
+typedef struct kgchess_search_result {
+    kgchess_move_t best_move;
+    kgchess_piece_type_t best_move_promotion; // piece to pass to kgchess_promote after best_move, or KGCHESS_PIECE_NONE
+    int score;   // centipawns, from the current player's point of view
+    int mate_in; // moves until mate, negative if the current player gets mated, 0 if no mate was found
+    int depth;
+    kgchess_move_t pv[KGCHESS_SEARCH_MAX_PLY];
+    kgchess_piece_type_t pv_promotions[KGCHESS_SEARCH_MAX_PLY];
+    int pv_length;
+    uint64_t nodes;
+    int time_ms;
+    uint64_t nps;
+    uint64_t tb_hits; // successful tablebase probes
+} kgchess_search_result_t;
+
+typedef struct kgchess_search_limits {
+    int depth;                 // 0 for no limit
+    uint64_t nodes;            // 0 for no limit
+    int time_ms;               // 0 for no limit
+    const _Atomic bool *stop;  // optional, search returns soon after another thread sets it to true
+    kgchess_tt_t *tt;          // optional, a temporary table is used when NULL
+    int threads;               // 0 or 1 searches on the calling thread only, more adds helper threads
+    kgchess_ordering_t **orderings; // optional, one per thread kept between searches, temporary ones are used when NULL
+    const kgchess_tb_t *tb;    // optional, endgame tablebases to limit root moves and score positions with few pieces
+    void (*on_iteration)(const kgchess_search_result_t *result, void *data); // optional, called after every depth
+    void *on_iteration_data;
+} kgchess_search_limits_t;
+
+kgchess_search_limits_t kgchess_search_limits_make_empty(void);
+// Runs an iterative deepening alpha-beta search from the position of chess (which isn't modified).
+// Helper threads (limits.threads) search the same position and share their results through the transposition table.
+// Orderings given in limits start with kgchess_ordering_new_search, so a game's searches build on what earlier ones
+// learned, clear them with kgchess_ordering_clear before a new game.
+// Returns false if the current player has no legal moves.
+bool kgchess_search(const kgchess_t *chess, kgchess_search_limits_t limits, kgchess_search_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_search_h
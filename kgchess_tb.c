@@ -0,0 +1,1503 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // madvise
+#endif
+
+#include "kgchess_tb.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Probing follows the Syzygy file format as read by Stockfish and Fathom: every table is split into blocks of
+// canonical Huffman codes, each code standing for a pair of symbols (recursive pairing) that expand to the values.
+
+#define MAX_PIECES KGCHESS_TB_MAX_PIECES
+#define MAX_PATHS 16
+#define MAX_PATH_LENGTH 1024
+#define MAX_CODE_LENGTHS 32
+#define MAX_DTZ (1 << 18)
+#define ENTRIES_HASH_SIZE 8192 // enough for both keys of every table with up to 7 pieces
+#define SIDES_COUNT 252        // piece sets of up to 5 pieces besides the king
+
+#ifdef _WIN32
+#define PATHS_SEPARATOR ';'
+#else
+#define PATHS_SEPARATOR ':'
+#endif
+
+#define FLAG_STM 1
+#define FLAG_MAPPED 2
+#define FLAG_WIN_PLIES 4
+#define FLAG_LOSS_PLIES 8
+#define FLAG_WIDE 16
+#define FLAG_SINGLE_VALUE 128
+
+#define FILE_FLAG_SPLIT 1
+#define FILE_FLAG_HAS_PAWNS 2
+
+typedef enum {
+    TABLE_WDL = 0,
+    TABLE_DTZ,
+} table_type_t;
+
+typedef enum {
+    PROBE_FAIL = 0,
+    PROBE_OK,
+    PROBE_CHANGE_STM,        // DTZ table only has the other player to move
+    PROBE_ZEROING_BEST_MOVE, // best move is a capture or pawn move, the table can't be trusted
+} probe_state_t;
+
+// Indexing and decompression data of one table in a file, pointers point into the mapped file.
+typedef struct {
+    uint8_t flags;
+    uint8_t min_code_length;
+    uint8_t max_code_length;
+    uint32_t blocks_count;
+    uint64_t block_size;
+    uint64_t span;                    // there's a sparse index entry every span values
+    const uint8_t *lowest_symbols;    // uint16 per code length, symbol of the lowest code of that length
+    const uint8_t *btree;             // 3 bytes per symbol, 12-bit left and right symbols it expands to
+    const uint8_t *block_lengths;     // uint16 per block, values in the block minus one
+    uint32_t block_lengths_size;
+    const uint8_t *sparse_index;      // 6 bytes per entry, uint32 block and uint16 offset in the block
+    uint64_t sparse_index_size;
+    const uint8_t *data;
+    uint64_t base64[MAX_CODE_LENGTHS]; // lowest code of every length padded to 64 bits
+    uint8_t *symbol_sizes;            // values represented by a symbol minus one
+    int symbols_count;
+    uint8_t pieces[MAX_PIECES];       // order in which pieces are encoded, 1-6 pawn to king, +8 for black
+    uint64_t group_idx[MAX_PIECES + 1];
+    int group_len[MAX_PIECES + 1];    // zero-terminated
+    uint32_t map_idx[4];              // offsets of DTZ value maps of win, loss, cursed win and blessed loss
+} pairs_t;
+
+typedef struct {
+    _Atomic bool is_ready; // set once the file was looked for, whether it was found or not
+    table_type_t type;
+    const uint8_t *base;
+    size_t size;
+    bool is_mmapped;
+    const uint8_t *dtz_map;
+    pairs_t pairs[2][4]; // [player to move][file of the leading pawn, 0 without pawns]
+} table_t;
+
+typedef struct {
+    char name[MAX_PIECES + 2]; // e.g. "KRPvKR", the first side is white in the tables
+    uint64_t key;              // material with the first side as white
+    uint64_t key2;             // and as black
+    int pieces_count;
+    bool has_pawns;
+    bool has_unique_pieces;
+    uint8_t pawns_count[2];    // of the leading pawns' side and of the other one
+    table_t wdl;
+    table_t dtz;
+} entry_t;
+
+typedef struct {
+    uint64_t key;
+    int entry_index; // -1 for empty slots
+} entry_slot_t;
+
+typedef struct kgchess_tb {
+    char *paths_buffer;
+    const char *paths[MAX_PATHS];
+    int paths_count;
+    entry_t *entries;
+    int entries_count;
+    int entries_capacity;
+    entry_slot_t slots[ENTRIES_HASH_SIZE];
+    int max_pieces;
+    pthread_mutex_t mutex;
+} kgchess_tb_t;
+
+static const uint8_t MAGICS[2][4] = {
+    [TABLE_WDL] = { 0x71, 0xe8, 0x23, 0x5d },
+    [TABLE_DTZ] = { 0xd7, 0x66, 0x0c, 0xa5 },
+};
+
+static const uint8_t TB_PIECES[] = {
+    [KGCHESS_PIECE_NONE] = 0,
+    [KGCHESS_PIECE_KING] = 6,
+    [KGCHESS_PIECE_QUEEN] = 5,
+    [KGCHESS_PIECE_BISHOP] = 3,
+    [KGCHESS_PIECE_KNIGHT] = 2,
+    [KGCHESS_PIECE_ROOK] = 4,
+    [KGCHESS_PIECE_PAWN] = 1,
+};
+
+static const char NAME_CHARS[] = "QRBNP"; // pieces besides the king in the order they appear in file names
+
+static const kgchess_piece_type_t NAME_PIECES[] = {
+    KGCHESS_PIECE_QUEEN, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_BISHOP, KGCHESS_PIECE_KNIGHT, KGCHESS_PIECE_PAWN
+};
+
+static const kgchess_piece_type_t PROMOTION_PIECES[] = {
+    KGCHESS_PIECE_QUEEN, KGCHESS_PIECE_ROOK, KGCHESS_PIECE_BISHOP, KGCHESS_PIECE_KNIGHT
+};
+
+static const int WDL_RANKS[] = { -MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ };
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static int map_pawns[64];
+static int map_b1h1h7[64];
+static int map_a1d1d4[64];
+static int map_kk[10][64];
+static int binomial[MAX_PIECES][64];
+static int lead_pawn_idx[6][64];
+static int lead_pawns_size[6][4];
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+static void init_tables(void);
+static void fill_tables(void);
+static int generate_sides(char sides[][MAX_PIECES], char *side, int length, int max_length, int first_piece, int count);
+static void add_entry(kgchess_tb_t *tb, const char *name);
+static bool file_exists(const kgchess_tb_t *tb, const char *name, const char *extension);
+static entry_t* find_entry(const kgchess_tb_t *tb, uint64_t key);
+static void insert_entry(kgchess_tb_t *tb, uint64_t key, int entry_index);
+static uint64_t get_material_key(const int counts[2][7]);
+static uint64_t get_position_key(const kgchess_t *chess);
+
+static bool can_probe(const kgchess_tb_t *tb, const kgchess_t *chess);
+static kgchess_tb_wdl_t probe_wdl(const kgchess_tb_t *tb, kgchess_t *chess, probe_state_t *state);
+static int probe_dtz(const kgchess_tb_t *tb, kgchess_t *chess, probe_state_t *state);
+static kgchess_tb_wdl_t search_zeroing_moves(const kgchess_tb_t *tb, kgchess_t *chess, bool with_pawn_moves, probe_state_t *state);
+static bool get_root_ranks(const kgchess_tb_t *tb, kgchess_t *chess, const kgchess_packed_move_t *moves, int count, int *ranks);
+static bool get_dtz_rank(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t move, int *rank);
+static bool get_wdl_rank(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t move, int *rank);
+static bool is_pawn_move(const kgchess_t *chess, kgchess_move_t move);
+static bool is_mated(kgchess_t *chess);
+static int get_dtz_before_zeroing(kgchess_tb_wdl_t wdl);
+static int sign_of(int value);
+
+static int probe_table(const kgchess_tb_t *tb, const kgchess_t *chess, table_type_t type, kgchess_tb_wdl_t wdl, probe_state_t *state);
+static int probe_mapped_table(const entry_t *entry, const table_t *table, const kgchess_t *chess, kgchess_tb_wdl_t wdl, probe_state_t *state);
+static uint64_t encode_leading_pieces(const entry_t *entry, const int *squares);
+static int map_score(const table_t *table, const pairs_t *d, int value, kgchess_tb_wdl_t wdl);
+static int decompress_pairs(const pairs_t *d, uint64_t idx);
+static const pairs_t* get_pairs(const entry_t *entry, const table_t *table, int stm, int file);
+static uint8_t get_tb_piece(const kgchess_t *chess, int sq);
+
+static bool map_table(const kgchess_tb_t *tb, entry_t *entry, table_t *table);
+static bool open_table_file(table_t *table, const char *path);
+static void close_table_file(table_t *table);
+static bool init_table(entry_t *entry, table_t *table);
+static void set_groups(const entry_t *entry, pairs_t *d, const int order[2], int file);
+static const uint8_t* set_sizes(pairs_t *d, const uint8_t *data, const uint8_t *end);
+static uint8_t set_symbol_size(pairs_t *d, int sym, uint8_t *visited);
+static const uint8_t* set_dtz_map(const entry_t *entry, table_t *table, const uint8_t *data);
+
+static int get_left_symbol(const pairs_t *d, int sym);
+static int get_right_symbol(const pairs_t *d, int sym);
+static uint16_t read_le16(const uint8_t *p);
+static uint32_t read_le32(const uint8_t *p);
+static uint32_t read_be32(const uint8_t *p);
+static uint64_t read_be64(const uint8_t *p);
+static int off_a1h8(int sq);
+static void sort_squares(int *squares, int count, const int *values);
+static int bb_count(uint64_t bb);
+static int bb_pop_lsb(uint64_t *bb);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_tb_t* kgchess_tb_make(const char *paths) {
+    init_tables();
+
+    kgchess_tb_t *tb = malloc(sizeof(kgchess_tb_t));
+    if (!tb) {
+        return NULL;
+    }
+    memset(tb, 0, sizeof(kgchess_tb_t));
+    for (int i = 0; i < ENTRIES_HASH_SIZE; i++) {
+        tb->slots[i].entry_index = -1;
+    }
+    pthread_mutex_init(&tb->mutex, NULL);
+
+    size_t paths_length = paths ? strlen(paths) : 0;
+    tb->paths_buffer = malloc(paths_length + 1);
+    if (!tb->paths_buffer) {
+        kgchess_tb_destroy(tb);
+        return NULL;
+    }
+    memcpy(tb->paths_buffer, paths ? paths : "", paths_length + 1);
+    char *path = tb->paths_buffer;
+    while (path && tb->paths_count < MAX_PATHS) {
+        char *separator = strchr(path, PATHS_SEPARATOR);
+        if (separator) {
+            *separator = '\0';
+        }
+        if (*path != '\0') {
+            tb->paths[tb->paths_count++] = path;
+        }
+        path = separator ? separator + 1 : NULL;
+    }
+    if (tb->paths_count == 0) {
+        return tb;
+    }
+
+    // Names are tried for every split of up to MAX_PIECES pieces between both sides, only one order of the sides exists.
+    char sides[SIDES_COUNT][MAX_PIECES];
+    char side[MAX_PIECES];
+    int sides_count = generate_sides(sides, side, 0, MAX_PIECES - 2, 0, 0);
+    for (int i = 0; i < sides_count; i++) {
+        for (int j = 0; j < sides_count; j++) {
+            int pieces_count = 2 + (int)strlen(sides[i]) + (int)strlen(sides[j]);
+            if (pieces_count < 3 || pieces_count > MAX_PIECES) {
+                continue;
+            }
+            char name[MAX_PIECES + 2];
+            snprintf(name, sizeof(name), "K%svK%s", sides[i], sides[j]);
+            add_entry(tb, name);
+        }
+    }
+    return tb;
+}
+
+void kgchess_tb_destroy(kgchess_tb_t *tb) {
+    if (!tb) {
+        return;
+    }
+    for (int i = 0; i < tb->entries_count; i++) {
+        close_table_file(&tb->entries[i].wdl);
+        close_table_file(&tb->entries[i].dtz);
+    }
+    pthread_mutex_destroy(&tb->mutex);
+    free(tb->entries);
+    free(tb->paths_buffer);
+    free(tb);
+}
+
+int kgchess_tb_get_tables_count(const kgchess_tb_t *tb) {
+    return tb->entries_count;
+}
+
+int kgchess_tb_get_max_pieces(const kgchess_tb_t *tb) {
+    return tb->max_pieces;
+}
+
+bool kgchess_tb_probe_wdl(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_tb_wdl_t *out_wdl) {
+    if (!can_probe(tb, chess)) {
+        return false;
+    }
+    probe_state_t state = PROBE_OK;
+    kgchess_tb_wdl_t wdl = probe_wdl(tb, chess, &state);
+    if (state == PROBE_FAIL) {
+        return false;
+    }
+    *out_wdl = wdl;
+    return true;
+}
+
+bool kgchess_tb_probe_dtz(const kgchess_tb_t *tb, kgchess_t *chess, int *out_dtz) {
+    if (!can_probe(tb, chess)) {
+        return false;
+    }
+    probe_state_t state = PROBE_OK;
+    int dtz = probe_dtz(tb, chess, &state);
+    if (state == PROBE_FAIL) {
+        return false;
+    }
+    *out_dtz = dtz;
+    return true;
+}
+
+int kgchess_tb_filter_packed_moves(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t *moves, int count) {
+    if (!can_probe(tb, chess) || count > KGCHESS_MAX_MOVES) {
+        return -1;
+    }
+    int ranks[KGCHESS_MAX_MOVES];
+    if (!get_root_ranks(tb, chess, moves, count, ranks)) {
+        return -1;
+    }
+    int best_rank = -MAX_DTZ - 1;
+    for (int i = 0; i < count; i++) {
+        if (ranks[i] > best_rank) {
+            best_rank = ranks[i];
+        }
+    }
+    int kept_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (ranks[i] == best_rank) {
+            moves[kept_count++] = moves[i];
+        }
+    }
+    return kept_count;
+}
+
+int kgchess_tb_filter_moves(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_move_t *moves, int count) {
+    if (!can_probe(tb, chess)) {
+        return -1;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+    kgchess_packed_move_t packed[KGCHESS_MAX_MOVES];
+    int owners[KGCHESS_MAX_MOVES];
+    int packed_count = 0;
+    for (int i = 0; i < count; i++) {
+        bool is_promotion = is_pawn_move(chess, moves[i]) && (moves[i].to.y == 0 || moves[i].to.y == 7);
+        int pieces_count = is_promotion ? 4 : 1;
+        if (packed_count + pieces_count > KGCHESS_MAX_MOVES) {
+            return -1;
+        }
+        for (int j = 0; j < pieces_count; j++) {
+            owners[packed_count] = i;
+            packed[packed_count++] = kgchess_pack_move(moves[i], is_promotion ? PROMOTION_PIECES[j] : KGCHESS_PIECE_NONE);
+        }
+    }
+    int packed_ranks[KGCHESS_MAX_MOVES];
+    if (!get_root_ranks(tb, chess, packed, packed_count, packed_ranks)) {
+        return -1;
+    }
+    int ranks[KGCHESS_MAX_MOVES];
+    int best_rank = -MAX_DTZ - 1;
+    for (int i = 0; i < count; i++) {
+        ranks[i] = -MAX_DTZ - 1;
+    }
+    for (int i = 0; i < packed_count; i++) {
+        int owner = owners[i];
+        if (packed_ranks[i] > ranks[owner]) {
+            ranks[owner] = packed_ranks[i];
+        }
+        if (packed_ranks[i] > best_rank) {
+            best_rank = packed_ranks[i];
+        }
+    }
+    int kept_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (ranks[i] == best_rank) {
+            moves[kept_count++] = moves[i];
+        }
+    }
+    return kept_count;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+static void init_tables() {
+    pthread_once(&tables_once, fill_tables);
+}
+
+// Tables mapping squares and piece placements to indices, the same for every file.
+static void fill_tables() {
+
+    // Squares below the a1-h8 diagonal to 0..27.
+    int code = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (off_a1h8(sq) < 0) {
+            map_b1h1h7[sq] = code++;
+        }
+    }
+
+    // Squares of the a1-d1-d4 triangle to 0..9, the ones on the diagonal last.
+    static const int TRIANGLE[] = { 0, 1, 2, 3, 9, 10, 11, 18, 19, 27 };
+    int diagonal[4];
+    int diagonal_count = 0;
+    code = 0;
+    for (int i = 0; i < 10; i++) {
+        int sq = TRIANGLE[i];
+        if (off_a1h8(sq) < 0) {
+            map_a1d1d4[sq] = code++;
+        } else if (off_a1h8(sq) == 0) {
+            diagonal[diagonal_count++] = sq;
+        }
+    }
+    for (int i = 0; i < diagonal_count; i++) {
+        map_a1d1d4[diagonal[i]] = code++;
+    }
+
+    // The 462 legal placements of two kings with the first one in the a1-d1-d4 triangle. If the first one is on
+    // the diagonal, the second one isn't above it. Placements with both kings on the diagonal come last.
+    int both_on_diagonal[32][2];
+    int both_on_diagonal_count = 0;
+    code = 0;
+    for (int idx = 0; idx < 10; idx++) {
+        for (int s1 = 0; s1 <= 27; s1++) {
+            if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1)) {
+                continue;
+            }
+            for (int s2 = 0; s2 < 64; s2++) {
+                int dx = abs((s1 & 7) - (s2 & 7));
+                int dy = abs((s1 >> 3) - (s2 >> 3));
+                if (dx <= 1 && dy <= 1) {
+                    continue;
+                } else if (off_a1h8(s1) == 0 && off_a1h8(s2) > 0) {
+                    continue;
+                } else if (off_a1h8(s1) == 0 && off_a1h8(s2) == 0) {
+                    both_on_diagonal[both_on_diagonal_count][0] = idx;
+                    both_on_diagonal[both_on_diagonal_count][1] = s2;
+                    both_on_diagonal_count++;
+                } else {
+                    map_kk[idx][s2] = code++;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < both_on_diagonal_count; i++) {
+        map_kk[both_on_diagonal[i][0]][both_on_diagonal[i][1]] = code++;
+    }
+
+    // binomial[k][n] ways to choose k squares out of n.
+    binomial[0][0] = 1;
+    for (int n = 1; n < 64; n++) {
+        for (int k = 0; k < MAX_PIECES && k <= n; k++) {
+            binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+        }
+    }
+
+    // Pawn squares a2-h7 to 47..0, going from the edges towards the center and from rank 2 up, so the leading pawn
+    // (the one with the highest value) is the one closest to the edge and then the lowest one. Leading pawns are
+    // encoded per file of the leading one, after mirroring it to files a-d.
+    int available_squares = 47;
+    for (int lead_pawns_count = 1; lead_pawns_count <= 5; lead_pawns_count++) {
+        for (int file = 0; file < 4; file++) {
+            int idx = 0;
+            for (int rank = 1; rank < 7; rank++) {
+                int sq = rank * 8 + file;
+                if (lead_pawns_count == 1) {
+                    map_pawns[sq] = available_squares--;
+                    map_pawns[sq ^ 7] = available_squares--;
+                }
+                lead_pawn_idx[lead_pawns_count][sq] = idx;
+                idx += binomial[lead_pawns_count - 1][map_pawns[sq]];
+            }
+            lead_pawns_size[lead_pawns_count][file] = idx;
+        }
+    }
+}
+
+// Writes every set of up to max_length pieces besides the king, in file name order (e.g. "QRR"), returns the new count.
+static int generate_sides(char sides[][MAX_PIECES], char *side, int length, int max_length, int first_piece, int count) {
+    side[length] = '\0';
+    memcpy(sides[count++], side, length + 1);
+    if (length == max_length) {
+        return count;
+    }
+    for (int i = first_piece; i < 5; i++) {
+        side[length] = NAME_CHARS[i];
+        count = generate_sides(sides, side, length + 1, max_length, i, count);
+    }
+    return count;
+}
+
+static void add_entry(kgchess_tb_t *tb, const char *name) {
+    if (!file_exists(tb, name, ".rtbw")) {
+        return;
+    }
+
+    int counts[2][7];
+    memset(counts, 0, sizeof(counts));
+    int side = 0;
+    int pieces_count = 0;
+    for (const char *c = name; *c != '\0'; c++) {
+        if (*c == 'v') {
+            side = 1;
+            continue;
+        }
+        pieces_count++;
+        const char *piece_char = strchr(NAME_CHARS, *c);
+        if (piece_char) {
+            counts[side][NAME_PIECES[piece_char - NAME_CHARS]]++;
+        }
+    }
+    int swapped_counts[2][7];
+    memcpy(swapped_counts[0], counts[1], sizeof(counts[1]));
+    memcpy(swapped_counts[1], counts[0], sizeof(counts[0]));
+    uint64_t key = get_material_key(counts);
+    if (find_entry(tb, key)) {
+        return;
+    }
+
+    if (tb->entries_count == tb->entries_capacity) {
+        int new_capacity = tb->entries_capacity > 0 ? tb->entries_capacity * 2 : 64;
+        entry_t *new_entries = realloc(tb->entries, new_capacity * sizeof(entry_t));
+        if (!new_entries) {
+            return;
+        }
+        tb->entries = new_entries;
+        tb->entries_capacity = new_capacity;
+    }
+    entry_t *entry = &tb->entries[tb->entries_count];
+    memset(entry, 0, sizeof(entry_t));
+    strcpy(entry->name, name);
+    entry->key = key;
+    entry->key2 = get_material_key(swapped_counts);
+    entry->pieces_count = pieces_count;
+    entry->has_pawns = counts[0][KGCHESS_PIECE_PAWN] + counts[1][KGCHESS_PIECE_PAWN] > 0;
+    for (int i = 0; i < 2; i++) {
+        for (int type = KGCHESS_PIECE_QUEEN; type <= KGCHESS_PIECE_PAWN; type++) {
+            if (counts[i][type] == 1) {
+                entry->has_unique_pieces = true;
+            }
+        }
+    }
+    // Pawns of the side with fewer of them lead, which compresses better.
+    int white_pawns = counts[0][KGCHESS_PIECE_PAWN];
+    int black_pawns = counts[1][KGCHESS_PIECE_PAWN];
+    bool is_white_leading = black_pawns == 0 || (white_pawns > 0 && black_pawns >= white_pawns);
+    entry->pawns_count[0] = (uint8_t)(is_white_leading ? white_pawns : black_pawns);
+    entry->pawns_count[1] = (uint8_t)(is_white_leading ? black_pawns : white_pawns);
+    entry->wdl.type = TABLE_WDL;
+    entry->dtz.type = TABLE_DTZ;
+    atomic_init(&entry->wdl.is_ready, false);
+    atomic_init(&entry->dtz.is_ready, false);
+
+    insert_entry(tb, entry->key, tb->entries_count);
+    insert_entry(tb, entry->key2, tb->entries_count);
+    tb->entries_count++;
+    if (pieces_count > tb->max_pieces) {
+        tb->max_pieces = pieces_count;
+    }
+}
+
+static bool file_exists(const kgchess_tb_t *tb, const char *name, const char *extension) {
+    char path[MAX_PATH_LENGTH];
+    for (int i = 0; i < tb->paths_count; i++) {
+        snprintf(path, sizeof(path), "%s/%s%s", tb->paths[i], name, extension);
+        FILE *fp = fopen(path, "rb");
+        if (fp) {
+            fclose(fp);
+            return true;
+        }
+    }
+    return false;
+}
+
+static entry_t* find_entry(const kgchess_tb_t *tb, uint64_t key) {
+    unsigned slot = (unsigned)((key * 0x9e3779b97f4a7c15ULL) >> 51) & (ENTRIES_HASH_SIZE - 1);
+    while (tb->slots[slot].entry_index >= 0) {
+        if (tb->slots[slot].key == key) {
+            return &tb->entries[tb->slots[slot].entry_index];
+        }
+        slot = (slot + 1) & (ENTRIES_HASH_SIZE - 1);
+    }
+    return NULL;
+}
+
+static void insert_entry(kgchess_tb_t *tb, uint64_t key, int entry_index) {
+    unsigned slot = (unsigned)((key * 0x9e3779b97f4a7c15ULL) >> 51) & (ENTRIES_HASH_SIZE - 1);
+    while (tb->slots[slot].entry_index >= 0) {
+        if (tb->slots[slot].key == key) {
+            return; // symmetric tables have both keys equal
+        }
+        slot = (slot + 1) & (ENTRIES_HASH_SIZE - 1);
+    }
+    tb->slots[slot].key = key;
+    tb->slots[slot].entry_index = entry_index;
+}
+
+// Counts of pieces besides kings, [white, black][kgchess_piece_type_t], 4 bits each.
+static uint64_t get_material_key(const int counts[2][7]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 2; i++) {
+        for (int type = KGCHESS_PIECE_QUEEN; type <= KGCHESS_PIECE_PAWN; type++) {
+            key |= (uint64_t)(counts[i][type] & 15) << (4 * (i * 7 + type));
+        }
+    }
+    return key;
+}
+
+static uint64_t get_position_key(const kgchess_t *chess) {
+    int counts[2][7];
+    memset(counts, 0, sizeof(counts));
+    for (int type = KGCHESS_PIECE_QUEEN; type <= KGCHESS_PIECE_PAWN; type++) {
+        counts[0][type] = kgchess_get_pieces_count(chess, KGCHESS_PLAYER_WHITE, type);
+        counts[1][type] = kgchess_get_pieces_count(chess, KGCHESS_PLAYER_BLACK, type);
+    }
+    return get_material_key(counts);
+}
+
+static bool can_probe(const kgchess_tb_t *tb, const kgchess_t *chess) {
+    if (!tb || tb->max_pieces == 0 || kgchess_get_castling_rights(chess) != 0) {
+        return false;
+    }
+    int pieces_count = bb_count(kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_NONE));
+    return pieces_count <= tb->max_pieces;
+}
+
+static kgchess_tb_wdl_t probe_wdl(const kgchess_tb_t *tb, kgchess_t *chess, probe_state_t *state) {
+    *state = PROBE_OK;
+    return search_zeroing_moves(tb, chess, false, state);
+}
+
+// DTZ tables only store positions of one player to move and don't store draws, the rest comes from a search.
+static int probe_dtz(const kgchess_tb_t *tb, kgchess_t *chess, probe_state_t *state) {
+    *state = PROBE_OK;
+    kgchess_tb_wdl_t wdl = search_zeroing_moves(tb, chess, true, state);
+    if (*state == PROBE_FAIL || wdl == KGCHESS_TB_DRAW) {
+        return 0;
+    }
+    if (*state == PROBE_ZEROING_BEST_MOVE) {
+        return get_dtz_before_zeroing(wdl);
+    }
+
+    int dtz = probe_table(tb, chess, TABLE_DTZ, wdl, state);
+    if (*state == PROBE_FAIL) {
+        return 0;
+    }
+    if (*state != PROBE_CHANGE_STM) {
+        bool is_cursed = wdl == KGCHESS_TB_CURSED_WIN || wdl == KGCHESS_TB_BLESSED_LOSS;
+        return (dtz + (is_cursed ? 100 : 0)) * sign_of(wdl);
+    }
+
+    // The table has the other player to move, so the result is the best DTZ after one move.
+    kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_all_packed_moves(chess, moves, KGCHESS_MAX_MOVES);
+    int min_dtz = 0xffff;
+    for (int i = 0; i < moves_count; i++) {
+        kgchess_move_t move = kgchess_unpack_move(moves[i], NULL);
+        bool is_zeroing = move.is_attack || is_pawn_move(chess, move);
+        if (!kgchess_push_packed_move(chess, moves[i])) {
+            *state = PROBE_FAIL;
+            return 0;
+        }
+        // After a zeroing move only the sign of the result matters, its DTZ is the one just before it.
+        if (is_zeroing) {
+            dtz = -get_dtz_before_zeroing(search_zeroing_moves(tb, chess, false, state));
+        } else {
+            dtz = -probe_dtz(tb, chess, state);
+        }
+        if (dtz == 1 && is_mated(chess)) {
+            min_dtz = 1;
+        }
+        if (!is_zeroing) {
+            dtz += sign_of(dtz);
+        }
+        if (dtz < min_dtz && sign_of(dtz) == sign_of(wdl)) {
+            min_dtz = dtz;
+        }
+        kgchess_pop_move(chess);
+        if (*state == PROBE_FAIL) {
+            return 0;
+        }
+    }
+    return min_dtz == 0xffff ? -1 : min_dtz;
+}
+
+// Tables may store any value for positions where a capture (or a pawn move for DTZ) is the best move, since
+// the generator knew it would be searched, so these moves are tried before the table is trusted.
+static kgchess_tb_wdl_t search_zeroing_moves(const kgchess_tb_t *tb, kgchess_t *chess, bool with_pawn_moves, probe_state_t *state) {
+    kgchess_packed_move_t moves[KGCHESS_MAX_MOVES];
+    int moves_count = kgchess_get_all_packed_moves(chess, moves, KGCHESS_MAX_MOVES);
+    int searched_count = 0;
+    kgchess_tb_wdl_t best_value = KGCHESS_TB_LOSS;
+    for (int i = 0; i < moves_count; i++) {
+        kgchess_move_t move = kgchess_unpack_move(moves[i], NULL);
+        if (!move.is_attack && (!with_pawn_moves || !is_pawn_move(chess, move))) {
+            continue;
+        }
+        searched_count++;
+        if (!kgchess_push_packed_move(chess, moves[i])) {
+            *state = PROBE_FAIL;
+            return KGCHESS_TB_DRAW;
+        }
+        kgchess_tb_wdl_t value = -search_zeroing_moves(tb, chess, false, state);
+        kgchess_pop_move(chess);
+        if (*state == PROBE_FAIL) {
+            return KGCHESS_TB_DRAW;
+        }
+        if (value > best_value) {
+            best_value = value;
+            if (value >= KGCHESS_TB_WIN) {
+                *state = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // If every legal move was searched (e.g. only captures are possible) the table isn't needed.
+    bool is_all_searched = searched_count > 0 && searched_count == moves_count;
+    kgchess_tb_wdl_t value = best_value;
+    if (!is_all_searched) {
+        value = probe_table(tb, chess, TABLE_WDL, KGCHESS_TB_DRAW, state);
+        if (*state == PROBE_FAIL) {
+            return KGCHESS_TB_DRAW;
+        }
+    }
+    if (best_value >= value) {
+        *state = best_value > KGCHESS_TB_DRAW || is_all_searched ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return best_value;
+    }
+    *state = PROBE_OK;
+    return value;
+}
+
+// Ranks are higher for better moves: certain wins rank the same, wins and losses the fifty-move rule may turn
+// into draws by how close they're to it. Falls back to WDL tables if DTZ ones are missing.
+static bool get_root_ranks(const kgchess_tb_t *tb, kgchess_t *chess, const kgchess_packed_move_t *moves, int count, int *ranks) {
+    bool ok = true;
+    for (int i = 0; ok && i < count; i++) {
+        ok = get_dtz_rank(tb, chess, moves[i], &ranks[i]);
+    }
+    if (ok) {
+        return true;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!get_wdl_rank(tb, chess, moves[i], &ranks[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool get_dtz_rank(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t move, int *rank) {
+    int halfmove_clock = kgchess_get_halfmove_clock(chess);
+    bool is_repeated = kgchess_get_repetitions_count(chess) > 0;
+    if (!kgchess_push_packed_move(chess, move)) {
+        return false;
+    }
+    probe_state_t state = PROBE_OK;
+    int dtz = 0;
+    if (kgchess_get_halfmove_clock(chess) == 0) {
+        dtz = get_dtz_before_zeroing(-probe_wdl(tb, chess, &state));
+    } else {
+        dtz = -probe_dtz(tb, chess, &state);
+        dtz += sign_of(dtz);
+    }
+    if (dtz == 2 && is_mated(chess)) {
+        dtz = 1;
+    }
+    kgchess_pop_move(chess);
+    if (state == PROBE_FAIL) {
+        return false;
+    }
+    if (dtz > 0) {
+        *rank = dtz + halfmove_clock <= 99 && !is_repeated ? MAX_DTZ : MAX_DTZ - (dtz + halfmove_clock);
+    } else if (dtz < 0) {
+        *rank = -dtz * 2 + halfmove_clock < 100 ? -MAX_DTZ : -MAX_DTZ + (-dtz + halfmove_clock);
+    } else {
+        *rank = 0;
+    }
+    return true;
+}
+
+static bool get_wdl_rank(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t move, int *rank) {
+    if (!kgchess_push_packed_move(chess, move)) {
+        return false;
+    }
+    probe_state_t state = PROBE_OK;
+    kgchess_tb_wdl_t wdl = -probe_wdl(tb, chess, &state);
+    kgchess_pop_move(chess);
+    if (state == PROBE_FAIL) {
+        return false;
+    }
+    *rank = WDL_RANKS[wdl + 2];
+    return true;
+}
+
+static bool is_pawn_move(const kgchess_t *chess, kgchess_move_t move) {
+    return kgchess_get_piece_at(chess, move.from.x, move.from.y).type == KGCHESS_PIECE_PAWN;
+}
+
+static bool is_mated(kgchess_t *chess) {
+    return kgchess_is_in_check(chess) && kgchess_count_all_moves(chess) == 0;
+}
+
+// DTZ of a winning (losing) position where the best move is a capture or pawn move.
+static int get_dtz_before_zeroing(kgchess_tb_wdl_t wdl) {
+    switch (wdl) {
+        case KGCHESS_TB_WIN: return 1;
+        case KGCHESS_TB_CURSED_WIN: return 101;
+        case KGCHESS_TB_BLESSED_LOSS: return -101;
+        case KGCHESS_TB_LOSS: return -1;
+        default: return 0;
+    }
+}
+
+static int sign_of(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static int probe_table(const kgchess_tb_t *tb, const kgchess_t *chess, table_type_t type, kgchess_tb_wdl_t wdl, probe_state_t *state) {
+    if (bb_count(kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_NONE)) == 2) {
+        return KGCHESS_TB_DRAW;
+    }
+    entry_t *entry = find_entry(tb, get_position_key(chess));
+    if (!entry) {
+        *state = PROBE_FAIL;
+        return 0;
+    }
+    table_t *table = type == TABLE_WDL ? &entry->wdl : &entry->dtz;
+    if (!map_table(tb, entry, table)) {
+        *state = PROBE_FAIL;
+        return 0;
+    }
+    return probe_mapped_table(entry, table, chess, wdl, state);
+}
+
+// Tables have the stronger side (the first one in the name) as white, so the position is flipped if black is
+// stronger, or if both sides have the same pieces and black is to move, as such tables only store white to move.
+// Then pieces are put in the order the table encodes them and mirrored so that the leading piece is in the
+// a1-d1-d4 triangle (leading pawn on files a-d), and the position index is a sum of indices of piece groups.
+static int probe_mapped_table(const entry_t *entry, const table_t *table, const kgchess_t *chess, kgchess_tb_wdl_t wdl, probe_state_t *state) {
+    int squares[MAX_PIECES] = { 0 };
+    uint8_t pieces[MAX_PIECES] = { 0 };
+    int size = 0;
+    int lead_pawns_count = 0;
+    uint64_t lead_pawns = 0;
+    int tb_file = 0;
+
+    bool is_black_to_move = kgchess_get_current_player((kgchess_t*)chess) == KGCHESS_PLAYER_BLACK;
+    bool is_flipped = (entry->key == entry->key2 && is_black_to_move) || get_position_key(chess) != entry->key;
+    int flip_color = is_flipped ? 8 : 0;
+    int flip_squares = is_flipped ? 56 : 0;
+    int stm = is_flipped ^ is_black_to_move;
+
+    if (entry->has_pawns) {
+        uint8_t lead_pawn = get_pairs(entry, table, 0, 0)->pieces[0] ^ flip_color;
+        kgchess_player_t lead_player = lead_pawn & 8 ? KGCHESS_PLAYER_BLACK : KGCHESS_PLAYER_WHITE;
+        lead_pawns = kgchess_get_bitboard(chess, lead_player, KGCHESS_PIECE_PAWN);
+        uint64_t bb = lead_pawns;
+        while (bb && size < MAX_PIECES) {
+            squares[size++] = bb_pop_lsb(&bb) ^ flip_squares;
+        }
+        lead_pawns_count = size;
+        int lead_index = 0;
+        for (int i = 1; i < lead_pawns_count; i++) {
+            if (map_pawns[squares[i]] > map_pawns[squares[lead_index]]) {
+                lead_index = i;
+            }
+        }
+        int tmp = squares[0];
+        squares[0] = squares[lead_index];
+        squares[lead_index] = tmp;
+        int file = squares[0] & 7;
+        tb_file = file < 4 ? file : 7 - file;
+    }
+
+    if (table->type == TABLE_DTZ) {
+        const pairs_t *d = get_pairs(entry, table, 0, tb_file);
+        bool is_stm_stored = (d->flags & FLAG_STM) == stm || (entry->key == entry->key2 && !entry->has_pawns);
+        if (!is_stm_stored) {
+            *state = PROBE_CHANGE_STM;
+            return 0;
+        }
+    }
+
+    uint64_t bb = kgchess_get_bitboard(chess, KGCHESS_PLAYER_NONE, KGCHESS_PIECE_NONE) ^ lead_pawns;
+    while (bb && size < MAX_PIECES) {
+        int sq = bb_pop_lsb(&bb);
+        squares[size] = sq ^ flip_squares;
+        pieces[size++] = get_tb_piece(chess, sq) ^ flip_color;
+    }
+
+    const pairs_t *d = get_pairs(entry, table, stm, tb_file);
+    for (int i = lead_pawns_count; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (d->pieces[i] == pieces[j]) {
+                uint8_t tmp_piece = pieces[i];
+                pieces[i] = pieces[j];
+                pieces[j] = tmp_piece;
+                int tmp_sq = squares[i];
+                squares[i] = squares[j];
+                squares[j] = tmp_sq;
+                break;
+            }
+        }
+    }
+
+    if ((squares[0] & 7) > 3) {
+        for (int i = 0; i < size; i++) {
+            squares[i] ^= 7;
+        }
+    }
+
+    uint64_t idx = 0;
+    if (entry->has_pawns) {
+        idx = lead_pawn_idx[lead_pawns_count][squares[0]];
+        sort_squares(squares + 1, lead_pawns_count - 1, map_pawns);
+        for (int i = 1; i < lead_pawns_count; i++) {
+            idx += binomial[i][map_pawns[squares[i]]];
+        }
+    } else {
+        if ((squares[0] >> 3) > 3) {
+            for (int i = 0; i < size; i++) {
+                squares[i] ^= 56;
+            }
+        }
+        // The first piece of the leading group that's off the a1-h8 diagonal has to be below it.
+        for (int i = 0; i < d->group_len[0]; i++) {
+            if (off_a1h8(squares[i]) == 0) {
+                continue;
+            }
+            if (off_a1h8(squares[i]) > 0) {
+                for (int j = i; j < size; j++) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+        idx = encode_leading_pieces(entry, squares);
+    }
+
+    // Remaining groups, pieces of one type and color each. Squares are counted without the ones taken by earlier
+    // groups, and the other side's pawns can't be on the first or last rank.
+    idx *= d->group_idx[0];
+    int group_start = d->group_len[0];
+    bool is_remaining_pawns = entry->has_pawns && entry->pawns_count[1] > 0;
+    for (int next = 1; d->group_len[next] != 0; next++) {
+        int *group_squares = squares + group_start;
+        int group_len = d->group_len[next];
+        sort_squares(group_squares, group_len, NULL);
+        uint64_t n = 0;
+        for (int i = 0; i < group_len; i++) {
+            int adjust = 0;
+            for (int j = 0; j < group_start; j++) {
+                adjust += group_squares[i] > squares[j];
+            }
+            n += binomial[i + 1][group_squares[i] - adjust - (is_remaining_pawns ? 8 : 0)];
+        }
+        is_remaining_pawns = false;
+        idx += n * d->group_idx[next];
+        group_start += group_len;
+    }
+
+    return map_score(table, get_pairs(entry, table, 0, tb_file), decompress_pairs(d, idx), wdl);
+}
+
+// Three unique pieces are encoded together (31332 placements), otherwise only the kings (462 placements).
+static uint64_t encode_leading_pieces(const entry_t *entry, const int *squares) {
+    if (!entry->has_unique_pieces) {
+        return map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+    int s0 = squares[0];
+    int s1 = squares[1];
+    int s2 = squares[2];
+    int adjust1 = s1 > s0;
+    int adjust2 = (s2 > s0) + (s2 > s1);
+    if (off_a1h8(s0) != 0) {
+        return ((uint64_t)map_a1d1d4[s0] * 63 + (s1 - adjust1)) * 62 + s2 - adjust2;
+    } else if (off_a1h8(s1) != 0) {
+        return (6 * 63 + (s0 >> 3) * 28 + map_b1h1h7[s1]) * 62 + s2 - adjust2;
+    } else if (off_a1h8(s2) != 0) {
+        return 6 * 63 * 62 + 4 * 28 * 62 + (s0 >> 3) * 7 * 28 + ((s1 >> 3) - adjust1) * 28 + map_b1h1h7[s2];
+    }
+    return 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (s0 >> 3) * 7 * 6 + ((s1 >> 3) - adjust1) * 6 + ((s2 >> 3) - adjust2);
+}
+
+// WDL values are stored as 0..4. DTZ values are numbered by frequency separately for each WDL result and
+// may be stored in moves instead of plies.
+static int map_score(const table_t *table, const pairs_t *d, int value, kgchess_tb_wdl_t wdl) {
+    if (table->type == TABLE_WDL) {
+        return value - 2;
+    }
+    static const int WDL_MAP[] = { 1, 3, 0, 2, 0 };
+    if (d->flags & FLAG_MAPPED) {
+        uint32_t offset = d->map_idx[WDL_MAP[wdl + 2]];
+        if (d->flags & FLAG_WIDE) {
+            value = read_le16(table->dtz_map + offset + 2 * value);
+        } else {
+            value = table->dtz_map[offset + value];
+        }
+    }
+    if ((wdl == KGCHESS_TB_WIN && !(d->flags & FLAG_WIN_PLIES))
+        || (wdl == KGCHESS_TB_LOSS && !(d->flags & FLAG_LOSS_PLIES))
+        || wdl == KGCHESS_TB_CURSED_WIN || wdl == KGCHESS_TB_BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+// Finds the block holding value idx through the sparse index, then decodes Huffman codes from the start of the
+// block, skipping whole symbols until the one covering idx, and expands that symbol's pairs down to the value.
+static int decompress_pairs(const pairs_t *d, uint64_t idx) {
+    if (d->flags & FLAG_SINGLE_VALUE) {
+        return d->min_code_length; // the only value is stored there
+    }
+
+    // Sparse entry k points at value k * span + span / 2.
+    uint64_t k = idx / d->span;
+    const uint8_t *sparse_entry = d->sparse_index + k * 6;
+    uint32_t block = read_le32(sparse_entry);
+    int offset = read_le16(sparse_entry + 4);
+    offset += (int)(idx % d->span) - (int)(d->span / 2);
+    while (offset < 0) {
+        block--;
+        offset += read_le16(d->block_lengths + block * 2) + 1;
+    }
+    while (offset > read_le16(d->block_lengths + block * 2)) {
+        offset -= read_le16(d->block_lengths + block * 2) + 1;
+        block++;
+    }
+
+    // Codes of one length are consecutive numbers, and longer codes are lower, so a code's length is found by
+    // comparing the next 64 bits with the lowest code of every length.
+    const uint8_t *ptr = d->data + (uint64_t)block * d->block_size;
+    uint64_t buf64 = read_be64(ptr);
+    ptr += 8;
+    int buf64_size = 64;
+    uint16_t sym = 0;
+    for (;;) {
+        int len = 0;
+        while (buf64 < d->base64[len]) {
+            len++;
+        }
+        sym = (uint16_t)((buf64 - d->base64[len]) >> (64 - len - d->min_code_length));
+        sym = (uint16_t)(sym + read_le16(d->lowest_symbols + len * 2));
+        if (offset < d->symbol_sizes[sym] + 1) {
+            break;
+        }
+        offset -= d->symbol_sizes[sym] + 1;
+        len += d->min_code_length;
+        buf64 <<= len;
+        buf64_size -= len;
+        if (buf64_size <= 32) {
+            buf64_size += 32;
+            buf64 |= (uint64_t)read_be32(ptr) << (64 - buf64_size);
+            ptr += 4;
+        }
+    }
+
+    while (d->symbol_sizes[sym] != 0) {
+        int left = get_left_symbol(d, sym);
+        if (offset < d->symbol_sizes[left] + 1) {
+            sym = (uint16_t)left;
+        } else {
+            offset -= d->symbol_sizes[left] + 1;
+            sym = (uint16_t)get_right_symbol(d, sym);
+        }
+    }
+    return get_left_symbol(d, sym);
+}
+
+// WDL files have a table per player to move (unless both sides have the same pieces), DTZ files only one.
+static const pairs_t* get_pairs(const entry_t *entry, const table_t *table, int stm, int file) {
+    int sides = table->type == TABLE_WDL ? 2 : 1;
+    return &table->pairs[stm % sides][entry->has_pawns ? file : 0];
+}
+
+static uint8_t get_tb_piece(const kgchess_t *chess, int sq) {
+    kgchess_piece_t piece = kgchess_get_piece_at(chess, sq & 7, sq >> 3);
+    return TB_PIECES[piece.type] | (piece.player == KGCHESS_PLAYER_BLACK ? 8 : 0);
+}
+
+// Files are looked for and mapped on the first probe that needs them, under a lock so it happens once.
+static bool map_table(const kgchess_tb_t *tb, entry_t *entry, table_t *table) {
+    if (atomic_load_explicit(&table->is_ready, memory_order_acquire)) {
+        return table->base != NULL;
+    }
+    pthread_mutex_t *mutex = (pthread_mutex_t*)&tb->mutex;
+    pthread_mutex_lock(mutex);
+    if (!atomic_load_explicit(&table->is_ready, memory_order_relaxed)) {
+        const char *extension = table->type == TABLE_WDL ? ".rtbw" : ".rtbz";
+        char path[MAX_PATH_LENGTH];
+        for (int i = 0; i < tb->paths_count; i++) {
+            snprintf(path, sizeof(path), "%s/%s%s", tb->paths[i], entry->name, extension);
+            if (open_table_file(table, path)) {
+                break;
+            }
+        }
+        if (table->base) {
+            bool is_valid = table->size > 5 && memcmp(table->base, MAGICS[table->type], 4) == 0;
+            if (!is_valid || !init_table(entry, table)) {
+                fprintf(stderr, "Corrupted table: %s%s\n", entry->name, extension);
+                close_table_file(table);
+            }
+        }
+        atomic_store_explicit(&table->is_ready, true, memory_order_release);
+    }
+    pthread_mutex_unlock(mutex);
+    return table->base != NULL;
+}
+
+static bool open_table_file(table_t *table, const char *path) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem != MAP_FAILED) {
+        madvise(mem, (size_t)st.st_size, MADV_RANDOM);
+        table->base = mem;
+        table->size = (size_t)st.st_size;
+        table->is_mmapped = true;
+        return true;
+    }
+#endif
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (!data || fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    table->base = data;
+    table->size = (size_t)size;
+    table->is_mmapped = false;
+    return true;
+}
+
+static void close_table_file(table_t *table) {
+    for (int i = 0; i < 2; i++) {
+        for (int file = 0; file < 4; file++) {
+            free(table->pairs[i][file].symbol_sizes);
+            table->pairs[i][file].symbol_sizes = NULL;
+        }
+    }
+    if (!table->base) {
+        return;
+    }
+#ifndef _WIN32
+    if (table->is_mmapped) {
+        munmap((void*)table->base, table->size);
+    } else {
+        free((void*)table->base);
+    }
+#else
+    free((void*)table->base);
+#endif
+    table->base = NULL;
+    table->size = 0;
+}
+
+// Reads the header: piece order and group order of every table, then sizes, DTZ maps, sparse indices, block
+// lengths and data of all tables one after another. Offsets are aligned relative to the start of the file.
+static bool init_table(entry_t *entry, table_t *table) {
+    const uint8_t *base = table->base;
+    const uint8_t *end = base + table->size;
+    const uint8_t *data = base + 4;
+    bool has_pawns = (*data & FILE_FLAG_HAS_PAWNS) != 0;
+    if (has_pawns != entry->has_pawns) {
+        return false;
+    }
+    data++;
+
+    int sides = table->type == TABLE_WDL && entry->key != entry->key2 ? 2 : 1;
+    int max_file = entry->has_pawns ? 3 : 0;
+    bool pp = entry->has_pawns && entry->pawns_count[1] > 0; // pawns on both sides
+    memset(table->pairs, 0, sizeof(table->pairs));
+
+    for (int file = 0; file <= max_file; file++) {
+        if (data + 1 + pp + entry->pieces_count > end) {
+            return false;
+        }
+        int order[2][2] = {
+            { data[0] & 15, pp ? data[1] & 15 : 15 },
+            { data[0] >> 4, pp ? data[1] >> 4 : 15 },
+        };
+        data += 1 + pp;
+        for (int k = 0; k < entry->pieces_count; k++, data++) {
+            for (int i = 0; i < sides; i++) {
+                table->pairs[i][file].pieces[k] = i ? *data >> 4 : *data & 15;
+            }
+        }
+        for (int i = 0; i < sides; i++) {
+            set_groups(entry, &table->pairs[i][file], order[i], file);
+        }
+    }
+    data += (data - base) & 1;
+
+    for (int file = 0; file <= max_file; file++) {
+        for (int i = 0; i < sides; i++) {
+            data = set_sizes(&table->pairs[i][file], data, end);
+            if (!data) {
+                return false;
+            }
+        }
+    }
+
+    if (table->type == TABLE_DTZ) {
+        data = set_dtz_map(entry, table, data);
+    }
+
+    for (int file = 0; file <= max_file; file++) {
+        for (int i = 0; i < sides; i++) {
+            pairs_t *d = &table->pairs[i][file];
+            d->sparse_index = data;
+            data += d->sparse_index_size * 6;
+        }
+    }
+    for (int file = 0; file <= max_file; file++) {
+        for (int i = 0; i < sides; i++) {
+            pairs_t *d = &table->pairs[i][file];
+            d->block_lengths = data;
+            data += d->block_lengths_size * 2;
+        }
+    }
+    for (int file = 0; file <= max_file; file++) {
+        for (int i = 0; i < sides; i++) {
+            pairs_t *d = &table->pairs[i][file];
+            data = base + (((size_t)(data - base) + 63) & ~(size_t)63);
+            d->data = data;
+            data += d->blocks_count * d->block_size;
+        }
+    }
+    return data <= end;
+}
+
+// Pieces encoded together: the leading group (three unique pieces, both kings or the leading pawns), then
+// groups of pieces of the same type and color. order says in which order groups' indices are combined,
+// order[0] being the leading group and order[1] the other side's pawns.
+static void set_groups(const entry_t *entry, pairs_t *d, const int order[2], int file) {
+    int n = 0;
+    int first_len = entry->has_pawns ? 0 : entry->has_unique_pieces ? 3 : 2;
+    d->group_len[n] = 1;
+    for (int i = 1; i < entry->pieces_count; i++) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->group_len[n]++;
+        } else {
+            d->group_len[++n] = 1;
+        }
+    }
+    d->group_len[++n] = 0;
+
+    bool pp = entry->has_pawns && entry->pawns_count[1] > 0;
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= entry->has_pawns ? lead_pawns_size[d->group_len[0]][file] : entry->has_unique_pieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= binomial[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= binomial[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+}
+
+static const uint8_t* set_sizes(pairs_t *d, const uint8_t *data, const uint8_t *end) {
+    if (data + 1 > end) {
+        return NULL;
+    }
+    d->flags = *data++;
+    if (d->flags & FLAG_SINGLE_VALUE) {
+        d->blocks_count = 0;
+        d->span = 0;
+        d->sparse_index_size = 0;
+        d->min_code_length = *data++;
+        return data;
+    }
+    if (data + 10 > end) {
+        return NULL;
+    }
+
+    int groups_count = 0;
+    while (d->group_len[groups_count] != 0) {
+        groups_count++;
+    }
+    uint64_t tb_size = d->group_idx[groups_count];
+    d->block_size = 1ULL << *data++;
+    d->span = 1ULL << *data++;
+    d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+    uint8_t padding = *data++;
+    d->blocks_count = read_le32(data);
+    data += 4;
+    d->block_lengths_size = d->blocks_count + padding;
+    d->max_code_length = *data++;
+    d->min_code_length = *data++;
+    int lengths_count = d->max_code_length - d->min_code_length + 1;
+    if (d->min_code_length == 0 || lengths_count <= 0 || lengths_count > MAX_CODE_LENGTHS
+        || data + lengths_count * 2 + 2 > end) {
+        return NULL;
+    }
+    d->lowest_symbols = data;
+
+    // Canonical Huffman codes: lowest code of every length from the lowest symbols, going from the longest
+    // codes (lowest values) up, then padded to 64 bits.
+    d->base64[lengths_count - 1] = 0;
+    for (int i = lengths_count - 2; i >= 0; i--) {
+        d->base64[i] = (d->base64[i + 1] + read_le16(d->lowest_symbols + i * 2) - read_le16(d->lowest_symbols + (i + 1) * 2)) / 2;
+    }
+    for (int i = 0; i < lengths_count; i++) {
+        d->base64[i] <<= 64 - i - d->min_code_length;
+    }
+    data += lengths_count * 2;
+
+    d->symbols_count = read_le16(data);
+    data += 2;
+    d->btree = data;
+    if (data + d->symbols_count * 3 > end) {
+        return NULL;
+    }
+    d->symbol_sizes = calloc(d->symbols_count > 0 ? d->symbols_count : 1, 1);
+    uint8_t *visited = calloc(d->symbols_count > 0 ? d->symbols_count : 1, 1);
+    if (!d->symbol_sizes || !visited) {
+        free(visited);
+        return NULL;
+    }
+    for (int sym = 0; sym < d->symbols_count; sym++) {
+        if (!visited[sym]) {
+            d->symbol_sizes[sym] = set_symbol_size(d, sym, visited);
+        }
+    }
+    free(visited);
+    return data + d->symbols_count * 3 + (d->symbols_count & 1);
+}
+
+// Number of values a symbol expands to (minus one), symbols without a right one are values themselves.
+static uint8_t set_symbol_size(pairs_t *d, int sym, uint8_t *visited) {
+    visited[sym] = 1;
+    int right = get_right_symbol(d, sym);
+    if (right == 0xfff) {
+        return 0;
+    }
+    int left = get_left_symbol(d, sym);
+    if (left >= d->symbols_count || right >= d->symbols_count) {
+        return 0;
+    }
+    if (!visited[left]) {
+        d->symbol_sizes[left] = set_symbol_size(d, left, visited);
+    }
+    if (!visited[right]) {
+        d->symbol_sizes[right] = set_symbol_size(d, right, visited);
+    }
+    return (uint8_t)(d->symbol_sizes[left] + d->symbol_sizes[right] + 1);
+}
+
+// Maps from stored DTZ values to real ones, four per table (one for every WDL result other than draw).
+static const uint8_t* set_dtz_map(const entry_t *entry, table_t *table, const uint8_t *data) {
+    table->dtz_map = data;
+    int max_file = entry->has_pawns ? 3 : 0;
+    for (int file = 0; file <= max_file; file++) {
+        pairs_t *d = &table->pairs[0][file];
+        if (!(d->flags & FLAG_MAPPED)) {
+            continue;
+        }
+        if (d->flags & FLAG_WIDE) {
+            data += (data - table->base) & 1;
+            for (int i = 0; i < 4; i++) {
+                d->map_idx[i] = (uint32_t)(data - table->dtz_map) + 2;
+                data += 2 * read_le16(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; i++) {
+                d->map_idx[i] = (uint32_t)(data - table->dtz_map) + 1;
+                data += *data + 1;
+            }
+        }
+    }
+    data += (data - table->base) & 1;
+    return data;
+}
+
+// Pair of symbols as 3 bytes, the left symbol in the lower 12 bits. A value is stored as the left symbol.
+static int get_left_symbol(const pairs_t *d, int sym) {
+    const uint8_t *lr = d->btree + sym * 3;
+    return ((lr[1] & 15) << 8) | lr[0];
+}
+
+static int get_right_symbol(const pairs_t *d, int sym) {
+    const uint8_t *lr = d->btree + sym * 3;
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t read_be64(const uint8_t *p) {
+    return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+// Positive above the a1-h8 diagonal, negative below it.
+static int off_a1h8(int sq) {
+    return (sq >> 3) - (sq & 7);
+}
+
+// Insertion sort by values[square], or by square if values is NULL.
+static void sort_squares(int *squares, int count, const int *values) {
+    for (int i = 1; i < count; i++) {
+        int sq = squares[i];
+        int key = values ? values[sq] : sq;
+        int j = i - 1;
+        while (j >= 0 && (values ? values[squares[j]] : squares[j]) > key) {
+            squares[j + 1] = squares[j];
+            j--;
+        }
+        squares[j + 1] = sq;
+    }
+}
+
+static int bb_count(uint64_t bb) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(bb);
+#else
+    int count = 0;
+    while (bb) {
+        bb &= bb - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static int bb_pop_lsb(uint64_t *bb) {
+    uint64_t b = *bb;
+#if defined(__GNUC__) || defined(__clang__)
+    int sq = __builtin_ctzll(b);
+#else
+    int sq = 0;
+    while (!(b & (1ULL << sq))) {
+        sq++;
+    }
+#endif
+    *bb = b & (b - 1);
+    return sq;
+}
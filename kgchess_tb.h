@@ -0,0 +1,83 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_tb_h
+#define kgchess_tb_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "kgchess.h"
+
+#define KGCHESS_TB_MAX_PIECES 7 // kings included
+
+// Result of a position with perfect play, from the current player's point of view.
+typedef enum {
+    KGCHESS_TB_LOSS = -2,
+    KGCHESS_TB_BLESSED_LOSS = -1, // lost, but drawn by the fifty-move rule
+    KGCHESS_TB_DRAW = 0,
+    KGCHESS_TB_CURSED_WIN = 1,    // won, but drawn by the fifty-move rule
+    KGCHESS_TB_WIN = 2,
+} kgchess_tb_wdl_t;
+
+// Syzygy endgame tablebases found in one or more directories. Files are memory-mapped the first time a probe
+// needs them and stay mapped (read-only) until the set is destroyed, so many threads can probe one set at once.
+typedef struct kgchess_tb kgchess_tb_t;
+
+// Looks for WDL (.rtbw) files in paths, directories separated with ':' (';' on Windows). DTZ (.rtbz) files
+// are expected next to them or in another of the directories. Returns NULL only if allocation fails.
+kgchess_tb_t* kgchess_tb_make(const char *paths);
+void kgchess_tb_destroy(kgchess_tb_t *tb);
+int kgchess_tb_get_tables_count(const kgchess_tb_t *tb);
+// Most pieces (kings included) of positions that can be probed, 0 if no tables were found.
+int kgchess_tb_get_max_pieces(const kgchess_tb_t *tb);
+
+// Probes fail for positions with castling rights, more pieces than the tables have or a missing table.
+// chess is only changed temporarily: captures (and pawn moves for DTZ) are tried with kgchess_push_packed_move.
+
+// Win, draw or loss assuming the halfmove clock is 0, so it's exact right after a capture or pawn move.
+bool kgchess_tb_probe_wdl(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_tb_wdl_t *out_wdl);
+// Plies to the next capture or pawn move (DTZ) on the way to the result, positive if the current player wins,
+// negative if it loses and 0 for draws. Values over 100 (under -100) are wins (losses) drawn by the fifty-move
+// rule, -1 means the current player is mated. It can be off by one ply, except right after a capture or pawn move.
+bool kgchess_tb_probe_dtz(const kgchess_tb_t *tb, kgchess_t *chess, int *out_dtz);
+// Leaves only moves that keep the best result according to the tables, taking the halfmove clock and repetitions
+// into account, and returns how many are left (moves are kept in order). DTZ tables are used when available,
+// WDL tables otherwise. Returns -1 and leaves moves unchanged if the position can't be probed.
+int kgchess_tb_filter_packed_moves(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_packed_move_t *moves, int count);
+// Same for moves from kgchess_get_moves or kgchess_get_all_moves, a promotion is kept if its best piece is.
+int kgchess_tb_filter_moves(const kgchess_tb_t *tb, kgchess_t *chess, kgchess_move_t *moves, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_tb_h
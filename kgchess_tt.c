@@ -0,0 +1,260 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#endif
+
+#include "kgchess_tt.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define ENTRIES_PER_BUCKET 4
+#define AGE_BITS 6
+#define AGE_MASK ((1 << AGE_BITS) - 1)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Entries are stored as (key ^ data, data), a reader that sees halves of two different stores
+// gets a key that doesn't match and treats the entry as empty.
+typedef struct {
+    _Atomic uint64_t key_xor_data;
+    _Atomic uint64_t data;
+} entry_t;
+
+typedef struct {
+    entry_t entries[ENTRIES_PER_BUCKET];
+} bucket_t;
+
+typedef struct kgchess_tt {
+    bucket_t *buckets;
+    uint64_t buckets_mask;
+    size_t size;
+    uint8_t age;
+    bool is_mmapped;
+    bool is_using_huge_pages;
+} kgchess_tt_t;
+
+//-----------------------------------------------------------------------------
+// Private declarations
+//-----------------------------------------------------------------------------
+
+static uint64_t pack_entry(kgchess_tt_entry_t entry, uint8_t age);
+static kgchess_tt_entry_t unpack_entry(uint64_t data);
+static uint8_t get_data_age(uint64_t data);
+static int get_data_depth(uint64_t data);
+static bool alloc_buckets(kgchess_tt_t *tt, size_t size);
+static void free_buckets(kgchess_tt_t *tt);
+
+//-----------------------------------------------------------------------------
+// Public definitions
+//-----------------------------------------------------------------------------
+
+kgchess_tt_t* kgchess_tt_make(size_t size_mb) {
+    size_t max_size = size_mb * 1024 * 1024;
+    size_t size = sizeof(bucket_t);
+    while (size * 2 <= max_size) {
+        size *= 2;
+    }
+
+    kgchess_tt_t *tt = malloc(sizeof(kgchess_tt_t));
+    if (!tt) {
+        return NULL;
+    }
+    memset(tt, 0, sizeof(kgchess_tt_t));
+    tt->size = size;
+    if (!alloc_buckets(tt, size)) {
+        free(tt);
+        return NULL;
+    }
+    tt->buckets_mask = size / sizeof(bucket_t) - 1;
+    return tt;
+}
+
+void kgchess_tt_destroy(kgchess_tt_t *tt) {
+    if (!tt) {
+        return;
+    }
+    free_buckets(tt);
+    free(tt);
+}
+
+void kgchess_tt_clear(kgchess_tt_t *tt) {
+    memset(tt->buckets, 0, tt->size);
+    tt->age = 0;
+}
+
+void kgchess_tt_new_search(kgchess_tt_t *tt) {
+    tt->age = (tt->age + 1) & AGE_MASK;
+}
+
+bool kgchess_tt_probe(const kgchess_tt_t *tt, uint64_t key, kgchess_tt_entry_t *out_entry) {
+    bucket_t *bucket = &tt->buckets[key & tt->buckets_mask];
+    for (int i = 0; i < ENTRIES_PER_BUCKET; i++) {
+        entry_t *entry = &bucket->entries[i];
+        uint64_t data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+        uint64_t key_xor_data = atomic_load_explicit(&entry->key_xor_data, memory_order_relaxed);
+        if ((key_xor_data ^ data) == key && data != 0) {
+            *out_entry = unpack_entry(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void kgchess_tt_store(kgchess_tt_t *tt, uint64_t key, kgchess_tt_entry_t entry) {
+    bucket_t *bucket = &tt->buckets[key & tt->buckets_mask];
+    entry_t *replaced = NULL;
+    int replaced_worth = 0;
+    for (int i = 0; i < ENTRIES_PER_BUCKET; i++) {
+        entry_t *candidate = &bucket->entries[i];
+        uint64_t data = atomic_load_explicit(&candidate->data, memory_order_relaxed);
+        uint64_t key_xor_data = atomic_load_explicit(&candidate->key_xor_data, memory_order_relaxed);
+        if ((key_xor_data ^ data) == key || data == 0) {
+            if (data != 0) {
+                kgchess_tt_entry_t old_entry = unpack_entry(data);
+                // Keep a deeper result of the current search unless the new one is exact.
+                if (entry.bound != KGCHESS_TT_BOUND_EXACT
+                    && get_data_age(data) == tt->age
+                    && entry.depth + 2 < old_entry.depth) {
+                    return;
+                }
+                if (entry.move == 0) {
+                    entry.move = old_entry.move;
+                }
+            }
+            replaced = candidate;
+            break;
+        }
+        // Prefer replacing entries from older searches, then shallower ones.
+        int age_diff = (tt->age - get_data_age(data)) & AGE_MASK;
+        int worth = get_data_depth(data) - 8 * age_diff;
+        if (!replaced || worth < replaced_worth) {
+            replaced = candidate;
+            replaced_worth = worth;
+        }
+    }
+    uint64_t data = pack_entry(entry, tt->age);
+    atomic_store_explicit(&replaced->key_xor_data, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&replaced->data, data, memory_order_relaxed);
+}
+
+size_t kgchess_tt_get_size(const kgchess_tt_t *tt) {
+    return tt->size;
+}
+
+int kgchess_tt_get_usage_permill(const kgchess_tt_t *tt) {
+    uint64_t buckets_count = tt->buckets_mask + 1;
+    uint64_t sampled_buckets = buckets_count < 250 ? buckets_count : 250;
+    int used = 0;
+    for (uint64_t i = 0; i < sampled_buckets; i++) {
+        for (int j = 0; j < ENTRIES_PER_BUCKET; j++) {
+            uint64_t data = atomic_load_explicit(&tt->buckets[i].entries[j].data, memory_order_relaxed);
+            if (data != 0 && get_data_age(data) == tt->age) {
+                used++;
+            }
+        }
+    }
+    return (int)(used * 1000 / (sampled_buckets * ENTRIES_PER_BUCKET));
+}
+
+bool kgchess_tt_is_using_huge_pages(const kgchess_tt_t *tt) {
+    return tt->is_using_huge_pages;
+}
+
+//-----------------------------------------------------------------------------
+// Private definitions
+//-----------------------------------------------------------------------------
+
+// Layout: move (16 bits) | score (16 bits) | eval (16 bits) | depth (8 bits) | bound (2 bits) | age (6 bits)
+static uint64_t pack_entry(kgchess_tt_entry_t entry, uint8_t age) {
+    uint64_t data = (uint64_t)entry.move;
+    data |= (uint64_t)(uint16_t)entry.score << 16;
+    data |= (uint64_t)(uint16_t)entry.eval << 32;
+    data |= (uint64_t)(uint8_t)entry.depth << 48;
+    data |= (uint64_t)(entry.bound & 3) << 56;
+    data |= (uint64_t)(age & AGE_MASK) << 58;
+    return data;
+}
+
+static kgchess_tt_entry_t unpack_entry(uint64_t data) {
+    kgchess_tt_entry_t entry;
+    entry.move = (uint16_t)data;
+    entry.score = (int16_t)(uint16_t)(data >> 16);
+    entry.eval = (int16_t)(uint16_t)(data >> 32);
+    entry.depth = (int8_t)(uint8_t)(data >> 48);
+    entry.bound = (kgchess_tt_bound_t)((data >> 56) & 3);
+    return entry;
+}
+
+static uint8_t get_data_age(uint64_t data) {
+    return (uint8_t)((data >> 58) & AGE_MASK);
+}
+
+static int get_data_depth(uint64_t data) {
+    return (int8_t)(uint8_t)(data >> 48);
+}
+
+static bool alloc_buckets(kgchess_tt_t *tt, size_t size) {
+#ifndef _WIN32
+    void *mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Explicit huge pages only work when the system has some reserved, otherwise fall back to regular pages.
+    if (size % HUGE_PAGE_SIZE == 0) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        tt->is_using_huge_pages = mem != MAP_FAILED;
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (mem != MAP_FAILED && size % HUGE_PAGE_SIZE == 0) {
+            tt->is_using_huge_pages = madvise(mem, size, MADV_HUGEPAGE) == 0;
+        }
+#endif
+    }
+    if (mem != MAP_FAILED) {
+        tt->buckets = mem;
+        tt->is_mmapped = true;
+        return true;
+    }
+#endif
+    tt->buckets = calloc(1, size);
+    tt->is_mmapped = false;
+    return tt->buckets != NULL;
+}
+
+static void free_buckets(kgchess_tt_t *tt) {
+#ifndef _WIN32
+    if (tt->is_mmapped) {
+        munmap(tt->buckets, tt->size);
+        return;
+    }
+#endif
+    free(tt->buckets);
+}
@@ -0,0 +1,73 @@
+/*
+ SPDX-License-Identifier: MIT
+ kgchess
+ https://github.com/kgabis/kgchess
+ Copyright (c) 2021 Krzysztof Gabis
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+
+#ifndef kgchess_tt_h
+#define kgchess_tt_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#if 0
+} // unconfuse xcode
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    KGCHESS_TT_BOUND_NONE = 0,
+    KGCHESS_TT_BOUND_UPPER,
+    KGCHESS_TT_BOUND_LOWER,
+    KGCHESS_TT_BOUND_EXACT,
+} kgchess_tt_bound_t;
+
+typedef struct kgchess_tt_entry {
+    uint16_t move; // packed move (or 0), e.g. kgchess_packed_move_t
+    int16_t score;
+    int16_t eval;
+    int8_t depth;
+    kgchess_tt_bound_t bound;
+} kgchess_tt_entry_t;
+
+// Fixed-size hash table keyed by kgchess_get_hash(). Probing and storing don't take locks and are safe to do
+// from many threads at once, torn entries are detected and ignored. Clearing, aging and destroying the table
+// must not run concurrently with probes and stores.
+typedef struct kgchess_tt kgchess_tt_t;
+
+kgchess_tt_t* kgchess_tt_make(size_t size_mb);
+void kgchess_tt_destroy(kgchess_tt_t *tt);
+void kgchess_tt_clear(kgchess_tt_t *tt);
+void kgchess_tt_new_search(kgchess_tt_t *tt);
+bool kgchess_tt_probe(const kgchess_tt_t *tt, uint64_t key, kgchess_tt_entry_t *out_entry);
+void kgchess_tt_store(kgchess_tt_t *tt, uint64_t key, kgchess_tt_entry_t entry);
+size_t kgchess_tt_get_size(const kgchess_tt_t *tt);
+int kgchess_tt_get_usage_permill(const kgchess_tt_t *tt);
+bool kgchess_tt_is_using_huge_pages(const kgchess_tt_t *tt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // kgchess_tt_h